@@ -0,0 +1,195 @@
+#include "pareto.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <string>
+
+#include "ensemble.h"
+#include "pendulum.h"
+
+static const PendulumParams PARAMS = { 0.3f, 0.3f, 1.0f, 1.0f, 9.81f };
+static const double MIN_TIMED_SECONDS = 0.01;
+
+// --- DOUBLE PRECISION REFERENCE ---
+// Same equations as Accelerations(), evaluated in double and integrated with
+// a tiny RK4 step, so its own error is far below anything measured here.
+
+struct RefState {
+    double t1, t2, w1, w2;
+};
+
+static RefState RefDerivative(const RefState& s) {
+    const double g = PARAMS.gravity, m1 = PARAMS.mass, m2 = PARAMS.mass2;
+    const double l1 = PARAMS.rodLength, l2 = PARAMS.rodLength2;
+
+    double den = 2*m1 + m2 - m2*cos(2*s.t1 - 2*s.t2);
+    double a1 = (-g*(2*m1 + m2)*sin(s.t1) - m2*g*sin(s.t1 - 2*s.t2)
+                 - 2*sin(s.t1 - s.t2)*m2*(s.w2*s.w2*l2 + s.w1*s.w1*l1*cos(s.t1 - s.t2))) / (l1*den);
+    double a2 = 2*sin(s.t1 - s.t2)*(s.w1*s.w1*l1*(m1 + m2) + g*(m1 + m2)*cos(s.t1)
+                 + s.w2*s.w2*l2*m2*cos(s.t1 - s.t2)) / (l2*den);
+    return RefState{ s.w1, s.w2, a1, a2 };
+}
+
+static RefState RefOffset(const RefState& s, const RefState& k, double h) {
+    return RefState{ s.t1 + k.t1*h, s.t2 + k.t2*h, s.w1 + k.w1*h, s.w2 + k.w2*h };
+}
+
+static void RefStep(RefState& s, double h) {
+    RefState k1 = RefDerivative(s);
+    RefState k2 = RefDerivative(RefOffset(s, k1, h / 2));
+    RefState k3 = RefDerivative(RefOffset(s, k2, h / 2));
+    RefState k4 = RefDerivative(RefOffset(s, k3, h));
+    s.t1 += h / 6 * (k1.t1 + 2*k2.t1 + 2*k3.t1 + k4.t1);
+    s.t2 += h / 6 * (k1.t2 + 2*k2.t2 + 2*k3.t2 + k4.t2);
+    s.w1 += h / 6 * (k1.w1 + 2*k2.w1 + 2*k3.w1 + k4.w1);
+    s.w2 += h / 6 * (k1.w2 + 2*k2.w2 + 2*k3.w2 + k4.w2);
+}
+
+static double RefEnergy(const RefState& s) {
+    const double g = PARAMS.gravity, m1 = PARAMS.mass, m2 = PARAMS.mass2;
+    const double v1 = PARAMS.rodLength * s.w1, v2 = PARAMS.rodLength2 * s.w2;
+    return 0.5*m1*v1*v1 + 0.5*m2*(v1*v1 + v2*v2 + 2*v1*v2*cos(s.t1 - s.t2))
+         - (m1 + m2)*g*PARAMS.rodLength*cos(s.t1) - m2*g*PARAMS.rodLength2*cos(s.t2);
+}
+
+// --- DONE WITH REFERENCE ---
+
+// difference of two angles, the short way round
+static double AngleError(double a, double b) {
+    return std::fabs(std::remainder(a - b, 2 * M_PI));
+}
+
+static double Median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    size_t n = values.size();
+    return n % 2 ? values[n / 2] : 0.5 * (values[n / 2 - 1] + values[n / 2]);
+}
+
+struct Point {
+    Integrator integrator;
+    float h;
+    double horizon;
+    double seconds;       // wall time to reach the horizon, all states
+    double phaseError;    // median |delta theta| over states, radians
+    double energyDrift;   // median |E - E0| / energy scale
+    bool phaseFrontier;
+    bool energyFrontier;
+};
+
+// marks points no other point beats on both cost and error
+static void MarkFrontier(std::vector<Point*>& points, double Point::*error, bool Point::*flag) {
+    std::sort(points.begin(), points.end(), [](const Point* a, const Point* b) { return a->seconds < b->seconds; });
+    double best = INFINITY;
+    for (Point* p : points) {
+        p->*flag = p->*error < best;
+        best = std::min(best, p->*error);
+    }
+}
+
+int RunPareto(const ParetoOptions& options) {
+    // moderate-energy starting states: long horizons stay comparable before
+    // chaos amplifies round-off into order-one differences
+    std::vector<PendulumState> starts;
+    for (int i = 0; i < options.states; i++) {
+        float f = options.states > 1 ? float(i) / (options.states - 1) : 0.5f;
+        starts.push_back(PendulumState{ 0.4f + 0.8f * f, 1.1f - 0.7f * f, 0.0f, 0.0f });
+    }
+
+    // energy scale: lifting both bobs from hanging to horizontal
+    double energyScale = (PARAMS.mass + PARAMS.mass2) * PARAMS.gravity * PARAMS.rodLength
+                       + PARAMS.mass2 * PARAMS.gravity * PARAMS.rodLength2;
+
+    // reference states at each horizon
+    std::vector<std::vector<RefState>> reference(options.horizons.size());
+    std::vector<double> startEnergy;
+    for (const PendulumState& s0 : starts) {
+        RefState s{ s0.theta1, s0.theta2, s0.omega1, s0.omega2 };
+        startEnergy.push_back(RefEnergy(s));
+        double t = 0.0;
+        for (size_t hz = 0; hz < options.horizons.size(); hz++) {
+            long n = lround((options.horizons[hz] - t) / options.referenceStep);
+            for (long k = 0; k < n; k++) RefStep(s, options.referenceStep);
+            t = options.horizons[hz];
+            reference[hz].push_back(s);
+        }
+    }
+
+    std::vector<Point> points;
+    for (size_t hz = 0; hz < options.horizons.size(); hz++) {
+        double horizon = options.horizons[hz];
+
+        for (int i = 0; i < INTEGRATOR_COUNT; i++) {
+            for (float h : options.steps) {
+                Ensemble e(starts.size());
+                AdvanceOptions advance;
+                advance.integrator = Integrator(i);
+                advance.kernel = Kernel::Scalar;
+                int n = int(lround(horizon / h));
+
+                // short runs are repeated until the timing is meaningful
+                double seconds = 0.0;
+                int runs = 0;
+                do {
+                    for (size_t m = 0; m < starts.size(); m++) e.Set(m, starts[m]);
+                    auto begin = std::chrono::steady_clock::now();
+                    Advance(e, PARAMS, h, n, advance);
+                    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+                    seconds += elapsed.count();
+                    runs++;
+                } while (seconds < MIN_TIMED_SECONDS);
+
+                std::vector<double> phase, energy;
+                for (size_t m = 0; m < starts.size(); m++) {
+                    const RefState& r = reference[hz][m];
+                    PendulumState s = e.Get(m);
+                    phase.push_back(std::hypot(AngleError(s.theta1, r.t1), AngleError(s.theta2, r.t2)));
+                    energy.push_back(std::fabs(Energy(s, PARAMS) - startEnergy[m]) / energyScale);
+                }
+
+                points.push_back(Point{ Integrator(i), h, horizon, seconds / runs,
+                                        Median(phase), Median(energy), false, false });
+            }
+        }
+    }
+
+    for (double horizon : options.horizons) {
+        std::vector<Point*> group;
+        for (Point& p : points) {
+            if (p.horizon == horizon) group.push_back(&p);
+        }
+        MarkFrontier(group, &Point::phaseError, &Point::phaseFrontier);
+        MarkFrontier(group, &Point::energyDrift, &Point::energyFrontier);
+
+        printf("\nhorizon %.1f s (%d states)  * = on the Pareto frontier\n", horizon, options.states);
+        printf("%-14s %10s %12s %13s %13s\n", "integrator", "h", "wall ms", "phase err", "energy drift");
+        for (Point* p : group) {
+            printf("%-14s %10.6f %12.3f %12.3e%s %12.3e%s\n", IntegratorName(p->integrator), p->h,
+                   p->seconds * 1e3, p->phaseError, p->phaseFrontier ? "*" : " ",
+                   p->energyDrift, p->energyFrontier ? "*" : " ");
+        }
+    }
+
+    FILE* out = fopen(options.jsonPath, "w");
+    if (!out) {
+        fprintf(stderr, "could not write %s\n", options.jsonPath);
+        return 1;
+    }
+    fprintf(out, "{\n  \"states\": %d,\n  \"reference_step\": %g,\n  \"points\": [\n",
+            options.states, options.referenceStep);
+    for (size_t i = 0; i < points.size(); i++) {
+        const Point& p = points[i];
+        fprintf(out, "    {\"integrator\": \"%s\", \"h\": %g, \"horizon\": %g, \"wall_seconds\": %.9f, "
+                     "\"phase_error\": %.6e, \"energy_drift\": %.6e, \"phase_frontier\": %s, "
+                     "\"energy_frontier\": %s}%s\n",
+                IntegratorName(p.integrator), p.h, p.horizon, p.seconds, p.phaseError, p.energyDrift,
+                p.phaseFrontier ? "true" : "false", p.energyFrontier ? "true" : "false",
+                i + 1 < points.size() ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+    if (fclose(out) != 0) return 1;
+
+    printf("\nwrote %s\n", options.jsonPath);
+    return 0;
+}
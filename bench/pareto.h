@@ -0,0 +1,19 @@
+#ifndef PARETO_H
+#define PARETO_H
+
+#include <vector>
+
+// Accuracy-vs-cost sweep: every integrator at every step size is run
+// against a double-precision RK4 reference from the same starting states,
+// and the non-dominated (wall time, error) points are reported.
+struct ParetoOptions {
+    std::vector<double> horizons = { 1.0, 10.0 };   // simulated seconds
+    std::vector<float> steps = { 0.02f, 0.01f, 0.005f, 0.0025f, 0.00125f, 0.000625f };
+    int states = 8;                                 // starting states averaged over
+    double referenceStep = 1e-5;
+    const char* jsonPath = "pendbench_pareto.json";
+};
+
+int RunPareto(const ParetoOptions& options);
+
+#endif
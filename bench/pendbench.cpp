@@ -0,0 +1,383 @@
+// pendbench: throughput of the pendulum kernels across ensemble sizes.
+//
+//   pendbench [--min-size N] [--max-size N] [--samples N] [--threads N]
+//             [--integrator NAME] [--no-pin] [--json PATH]
+//             [--baseline PATH [--threshold F] [--alpha F] [--strict]]
+//   pendbench --pareto [--horizons S,S,...] [--states N] [--json PATH]
+//
+// Every (kernel, integrator, size) case is calibrated to a minimum sample
+// time, warmed up once, then timed --samples times. Results are reported as
+// ns per member-step with a 95% confidence interval, plus GFLOP/s from a
+// hand count of the equations of motion. Where Linux perf counters are
+// permitted, IPC and per member-step misses are reported alongside.
+// Rendering prep (long-exposure splatting) is measured the same way, per
+// splatted point.
+//
+// With --baseline the results are compared against a stored run and the
+// exit status is 1 if any case regressed (see regression.h), or with
+// --strict if any case is missing from either side. The committed baseline
+// was recorded with --max-size 1e4 on a single-core host, so it has no
+// threaded cases; gate threading against a baseline from the CI machine.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "densityMap.h"
+#include "ensemble.h"
+#include "pendulum.h"
+#include "pareto.h"
+#include "perfCounters.h"
+#include "regression.h"
+
+// Arithmetic in one Accelerations() call, with each sin/cos counted as one
+// operation, plus the state update each integrator does around it.
+static const double FLOPS_PER_EVAL = 61.0;
+static const double UPDATE_FLOPS[INTEGRATOR_COUNT] = { 8.0, 8.0, 16.0, 44.0 };
+
+// one bilinear splat in DensityMap::Splat
+static const double SPLAT_FLOPS = 24.0;
+
+static const double MIN_SAMPLE_SECONDS = 0.02;
+
+struct Options {
+    size_t minSize = 1;
+    size_t maxSize = 1000000;
+    int samples = 10;
+    int threads = int(std::max(1u, std::thread::hardware_concurrency()));
+    bool pin = true;
+    bool allIntegrators = true;
+    Integrator integrator = Integrator::SemiImplicitEuler;
+    const char* jsonPath = "pendbench.json";
+    const char* baselinePath = nullptr;
+    RegressionOptions regression;
+};
+
+// Physics cases count member-steps; render cases count splatted points
+struct Case {
+    std::string name;
+    const char* kernel;
+    const char* integrator;
+    size_t members;
+    int threads;
+    int steps;                     // repetitions per sample
+    std::vector<double> samples;   // ns per member-step
+    double mean;
+    double ci95;
+    double gflops;
+    bool counted[PerfCounters::COUNT];
+    double perMemberStep[PerfCounters::COUNT];   // over all timed samples
+    double ipc;                                  // < 0 when not measured
+};
+
+static const PendulumParams PARAMS = { 0.3f, 0.3f, 1.0f, 1.0f, 9.81f };
+static const float DT = 0.005f;
+
+// two-sided 95% Student t for 1..30 degrees of freedom
+static double StudentT95(int df) {
+    static const double T[] = { 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                                2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                                2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042 };
+    if (df < 1) return 0.0;
+    return df <= 30 ? T[df - 1] : 1.96;
+}
+
+static void Scatter(Ensemble& e, unsigned seed) {
+    // deterministic spread of chaotic starting states
+    unsigned x = seed;
+    auto next = [&x]() { x = x * 1664525u + 1013904223u; return (x >> 8) * (1.0f / 16777216.0f); };
+    for (size_t i = 0; i < e.capacity; i++) {
+        e.Set(i, PendulumState{ (next() * 2 - 1) * 3.1f, (next() * 2 - 1) * 3.1f, next() - 0.5f, next() - 0.5f });
+    }
+}
+
+// calibrates, warms up and times run(steps), which must process
+// c.members items per step, and fills in the statistics
+static void Measure(Case& c, const std::function<void(int)>& run, double flopsPerItem, int samples,
+                    PerfCounters& counters) {
+    auto timeRun = [&run](int steps) {
+        auto start = std::chrono::steady_clock::now();
+        run(steps);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count();
+    };
+
+    // calibrate: double the step count until one sample is long enough;
+    // this also serves as the warm-up
+    int steps = 1;
+    while (timeRun(steps) < MIN_SAMPLE_SECONDS && steps < (1 << 24)) {
+        steps *= 2;
+    }
+    timeRun(steps);
+    c.steps = steps;
+
+    counters.Start();
+    for (int i = 0; i < samples; i++) {
+        double seconds = timeRun(steps);
+        c.samples.push_back(seconds * 1e9 / (double(c.members) * steps));
+    }
+    counters.Stop();
+
+    double items = double(c.members) * steps * samples;
+    for (int i = 0; i < PerfCounters::COUNT; i++) {
+        c.counted[i] = counters.measured[i];
+        c.perMemberStep[i] = counters.values[i] / items;
+    }
+    bool haveIpc = c.counted[PerfCounters::CYCLES] && c.counted[PerfCounters::INSTRUCTIONS] &&
+                   counters.values[PerfCounters::CYCLES] > 0;
+    c.ipc = haveIpc ? double(counters.values[PerfCounters::INSTRUCTIONS]) / counters.values[PerfCounters::CYCLES] : -1.0;
+
+    double sum = 0.0;
+    for (double s : c.samples) sum += s;
+    c.mean = sum / samples;
+
+    double var = 0.0;
+    for (double s : c.samples) var += (s - c.mean) * (s - c.mean);
+    double sd = samples > 1 ? std::sqrt(var / (samples - 1)) : 0.0;
+    c.ci95 = StudentT95(samples - 1) * sd / std::sqrt(double(samples));
+    c.gflops = flopsPerItem / c.mean;   // flop per ns == GFLOP/s
+}
+
+static Case RunPhysicsCase(const char* kernelName, const AdvanceOptions& options, size_t members, int samples,
+                           PerfCounters& counters) {
+    Case c;
+    c.kernel = kernelName;
+    c.integrator = IntegratorName(options.integrator);
+    c.members = members;
+    c.threads = options.threads;
+    c.name = std::string(kernelName) + "/" + c.integrator + "/" + std::to_string(members);
+
+    Ensemble e(members);
+    Scatter(e, 12345u);
+
+    double flops = FLOPS_PER_EVAL * IntegratorStages(options.integrator) + UPDATE_FLOPS[int(options.integrator)];
+    Measure(c, [&](int steps) { Advance(e, PARAMS, DT, steps, options); }, flops, samples, counters);
+    return c;
+}
+
+// splatting one batch of bob positions into the long-exposure histogram
+static Case RunSplatCase(size_t points, int samples, PerfCounters& counters) {
+    Case c;
+    c.kernel = "render";
+    c.integrator = "splat";
+    c.members = points;
+    c.threads = 1;
+    c.name = "render/splat/" + std::to_string(points);
+
+    // positions along a real trajectory, like the app produces
+    std::vector<float> xy;
+    PendulumState s{ 2.0f, 2.5f, 0.0f, 0.0f };
+    for (size_t i = 0; i < points; i++) {
+        StepPendulum(s, PARAMS, DT, Integrator::SemiImplicitEuler);
+        xy.push_back(PARAMS.rodLength * std::sin(s.theta1) + PARAMS.rodLength2 * std::sin(s.theta1 + s.theta2));
+        xy.push_back(-PARAMS.rodLength * std::cos(s.theta1) - PARAMS.rodLength2 * std::cos(s.theta1 + s.theta2));
+    }
+
+    DensityMap map(512, 512);
+    Measure(c, [&](int steps) {
+        for (int i = 0; i < steps; i++) map.Splat(xy.data(), points);
+    }, SPLAT_FLOPS, samples, counters);
+    return c;
+}
+
+static void PrintCounters(const Case& c) {
+    printf("    ");
+    if (c.ipc >= 0) printf("IPC %.2f", c.ipc);
+    else printf("IPC n/a");
+
+    // misses and vector ops per member-step
+    for (int k = PerfCounters::L1D_MISSES; k < PerfCounters::COUNT; k++) {
+        printf("  %s ", PerfCounters::Name(PerfCounters::Counter(k)));
+        if (c.counted[k]) printf("%.4f", c.perMemberStep[k]);
+        else printf("n/a");
+    }
+    printf("\n");
+}
+
+static bool WriteJson(const char* path, const std::vector<Case>& cases, const Options& options) {
+    FILE* out = fopen(path, "w");
+    if (!out) return false;
+
+    fprintf(out, "{\n  \"dt\": %g,\n  \"hardware_threads\": %u,\n  \"pinned\": %s,\n  \"benchmarks\": [\n",
+            DT, std::thread::hardware_concurrency(), options.pin ? "true" : "false");
+    for (size_t i = 0; i < cases.size(); i++) {
+        const Case& c = cases[i];
+        fprintf(out, "    {\"name\": \"%s\", \"kernel\": \"%s\", \"integrator\": \"%s\", \"members\": %zu, "
+                     "\"threads\": %d, \"steps\": %d, \"ns_per_member_step\": %.6f, \"ci95\": %.6f, "
+                     "\"gflops\": %.4f, ",
+                c.name.c_str(), c.kernel, c.integrator, c.members,
+                c.threads, c.steps, c.mean, c.ci95, c.gflops);
+
+        // counters are per member-step; null where the counter could not be opened or never ran
+        if (c.ipc >= 0) fprintf(out, "\"ipc\": %.4f, ", c.ipc);
+        else fprintf(out, "\"ipc\": null, ");
+        fprintf(out, "\"counters\": {");
+        for (int k = 0; k < PerfCounters::COUNT; k++) {
+            fprintf(out, "%s\"%s\": ", k ? ", " : "", PerfCounters::Name(PerfCounters::Counter(k)));
+            if (c.counted[k]) fprintf(out, "%.6f", c.perMemberStep[k]);
+            else fprintf(out, "null");
+        }
+        fprintf(out, "}, \"samples\": [");
+        for (size_t s = 0; s < c.samples.size(); s++) {
+            fprintf(out, "%s%.6f", s ? ", " : "", c.samples[s]);
+        }
+        fprintf(out, "]}%s\n", i + 1 < cases.size() ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+    return fclose(out) == 0;
+}
+
+static void Usage() {
+    fprintf(stderr, "usage: pendbench [--min-size N] [--max-size N] [--samples N] [--threads N]\n"
+                    "                 [--integrator euler|semi-implicit|midpoint|rk4] [--no-pin] [--json PATH]\n"
+                    "                 [--baseline PATH [--threshold F] [--alpha F] [--strict]]\n"
+                    "       pendbench --pareto [--horizons S,S,...] [--states N] [--json PATH]\n");
+}
+
+static bool ParseArgs(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+        if (strcmp(arg, "--no-pin") == 0) { options.pin = false; continue; }
+        if (strcmp(arg, "--strict") == 0) { options.regression.strict = true; continue; }
+        if (!value) return false;
+
+        if (strcmp(arg, "--min-size") == 0) options.minSize = size_t(atof(value));
+        else if (strcmp(arg, "--max-size") == 0) options.maxSize = size_t(atof(value));
+        else if (strcmp(arg, "--samples") == 0) options.samples = atoi(value);
+        else if (strcmp(arg, "--threads") == 0) options.threads = atoi(value);
+        else if (strcmp(arg, "--json") == 0) options.jsonPath = value;
+        else if (strcmp(arg, "--baseline") == 0) options.baselinePath = value;
+        else if (strcmp(arg, "--threshold") == 0) options.regression.threshold = atof(value);
+        else if (strcmp(arg, "--alpha") == 0) options.regression.alpha = atof(value);
+        else if (strcmp(arg, "--integrator") == 0) {
+            if (!ParseIntegrator(value, options.integrator)) return false;
+            options.allIntegrators = false;
+        }
+        else return false;
+        i++;
+    }
+    return options.minSize >= 1 && options.maxSize >= options.minSize && options.samples >= 2 && options.threads >= 1;
+}
+
+static bool ParseParetoArgs(int argc, char** argv, ParetoOptions& options) {
+    for (int i = 2; i < argc; i += 2) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!value) return false;
+
+        if (strcmp(arg, "--states") == 0) options.states = atoi(value);
+        else if (strcmp(arg, "--json") == 0) options.jsonPath = value;
+        else if (strcmp(arg, "--horizons") == 0) {
+            options.horizons.clear();
+            for (const char* p = value; *p; ) {
+                char* end;
+                double horizon = strtod(p, &end);
+                if (end == p || horizon <= 0.0) return false;
+                options.horizons.push_back(horizon);
+                p = *end == ',' ? end + 1 : end;
+            }
+            std::sort(options.horizons.begin(), options.horizons.end());
+        }
+        else return false;
+    }
+    return options.states >= 1 && !options.horizons.empty();
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && strcmp(argv[1], "--pareto") == 0) {
+        ParetoOptions pareto;
+        if (!ParseParetoArgs(argc, argv, pareto)) {
+            Usage();
+            return 2;
+        }
+        return RunPareto(pareto);
+    }
+
+    Options options;
+    if (!ParseArgs(argc, argv, options)) {
+        Usage();
+        return 2;
+    }
+
+    if (options.pin && !PinThread(0)) {
+        fprintf(stderr, "note: could not pin threads, results may be noisier\n");
+    }
+
+    PerfCounters counters;
+    if (!counters.Any()) {
+        fprintf(stderr, "note: hardware counters unavailable (%s); check kernel.perf_event_paranoid\n",
+                counters.error ? counters.error : "unknown");
+    }
+
+    std::vector<Case> cases;
+    printf("%-34s %8s %12s %10s %9s\n", "case", "steps", "ns/step/mbr", "+-95%", "GFLOP/s");
+
+    for (int i = 0; i < INTEGRATOR_COUNT; i++) {
+        Integrator integrator = Integrator(i);
+        if (!options.allIntegrators && integrator != options.integrator) continue;
+
+        for (size_t members = options.minSize; members <= options.maxSize; members *= 10) {
+            struct { const char* name; Kernel kernel; int threads; } kernels[] = {
+                { "scalar", Kernel::Scalar, 1 },
+                { "simd", Kernel::Simd, 1 },
+                // threading needs more than one thread and a few blocks to split
+                { "threaded", Kernel::Simd, members >= Ensemble::BLOCK * 2 ? options.threads : 1 },
+            };
+
+            for (auto& k : kernels) {
+                if (strcmp(k.name, "threaded") == 0 && k.threads == 1) continue;
+
+                AdvanceOptions advance;
+                advance.integrator = integrator;
+                advance.kernel = k.kernel;
+                advance.threads = k.threads;
+                advance.pinThreads = options.pin;
+
+                Case c = RunPhysicsCase(k.name, advance, members, options.samples, counters);
+                printf("%-34s %8d %12.3f %10.3f %9.3f\n", c.name.c_str(), c.steps, c.mean, c.ci95, c.gflops);
+                if (counters.Any()) PrintCounters(c);
+                fflush(stdout);
+                cases.push_back(c);
+            }
+
+            if (members > options.maxSize / 10) break;
+        }
+    }
+
+    // rendering prep: a typical frame's worth of splats and a large batch
+    for (size_t points : { size_t(1000), size_t(100000) }) {
+        if (points > std::max<size_t>(options.maxSize, 1000)) break;
+        Case c = RunSplatCase(points, options.samples, counters);
+        printf("%-34s %8d %12.3f %10.3f %9.3f\n", c.name.c_str(), c.steps, c.mean, c.ci95, c.gflops);
+        if (counters.Any()) PrintCounters(c);
+        cases.push_back(c);
+    }
+
+    if (!WriteJson(options.jsonPath, cases, options)) {
+        fprintf(stderr, "could not write %s\n", options.jsonPath);
+        return 1;
+    }
+    printf("wrote %s\n", options.jsonPath);
+
+    if (options.baselinePath) {
+        std::vector<BaselineCase> baseline;
+        if (!LoadBaseline(options.baselinePath, baseline)) {
+            fprintf(stderr, "could not read baseline %s\n", options.baselinePath);
+            return 1;
+        }
+
+        std::vector<BaselineCase> current;
+        for (const Case& c : cases) current.push_back(BaselineCase{ c.name, c.samples });
+        return CompareToBaseline(current, baseline, options.regression) ? 0 : 1;
+    }
+    return 0;
+}
@@ -0,0 +1,115 @@
+#include "perfCounters.h"
+
+#include <cerrno>
+#include <cstring>
+
+#ifdef __linux__
+#include <fstream>
+#include <string>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static const char* NAMES[PerfCounters::COUNT] = {
+    "cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses", "fp_vector_ops"
+};
+
+const char* PerfCounters::Name(Counter counter) {
+    return NAMES[counter];
+}
+
+bool PerfCounters::Any() const {
+    for (int i = 0; i < COUNT; i++) {
+        if (available[i]) return true;
+    }
+    return false;
+}
+
+#ifdef __linux__
+
+static bool IsIntel() {
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line)) {
+        if (line.rfind("vendor_id", 0) == 0) return line.find("GenuineIntel") != std::string::npos;
+    }
+    return false;
+}
+
+static int Open(uint32_t type, uint64_t config) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+PerfCounters::PerfCounters() : error(nullptr) {
+    const uint64_t cacheMiss = PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+
+    fds[CYCLES] = Open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    if (fds[CYCLES] < 0) error = strerror(errno);
+    fds[INSTRUCTIONS] = Open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    fds[L1D_MISSES] = Open(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | cacheMiss);
+    fds[LLC_MISSES] = Open(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | cacheMiss);
+    fds[BRANCH_MISSES] = Open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+
+    // FP_ARITH_INST_RETIRED, 128- and 256-bit packed single umasks
+    fds[FP_VECTOR] = IsIntel() ? Open(PERF_TYPE_RAW, 0x28C7) : -1;
+
+    for (int i = 0; i < COUNT; i++) {
+        available[i] = fds[i] >= 0;
+        measured[i] = false;
+        values[i] = 0;
+    }
+}
+
+PerfCounters::~PerfCounters() {
+    for (int i = 0; i < COUNT; i++) {
+        if (available[i]) close(fds[i]);
+    }
+}
+
+void PerfCounters::Start() {
+    for (int i = 0; i < COUNT; i++) {
+        if (!available[i]) continue;
+        ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+void PerfCounters::Stop() {
+    for (int i = 0; i < COUNT; i++) {
+        if (!available[i]) continue;
+        ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+        // value, time enabled, time running
+        uint64_t data[3] = {};
+        measured[i] = read(fds[i], data, sizeof(data)) == ssize_t(sizeof(data)) && data[2] > 0;
+        values[i] = measured[i] ? uint64_t(double(data[0]) * double(data[1]) / double(data[2])) : 0;
+    }
+}
+
+#else
+
+PerfCounters::PerfCounters() : error("perf_event_open is Linux only") {
+    for (int i = 0; i < COUNT; i++) {
+        fds[i] = -1;
+        available[i] = false;
+        measured[i] = false;
+        values[i] = 0;
+    }
+}
+
+PerfCounters::~PerfCounters() {}
+void PerfCounters::Start() {}
+void PerfCounters::Stop() {}
+
+#endif
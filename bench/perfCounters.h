@@ -0,0 +1,44 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <cstdint>
+
+// Hardware counters around a measured region via Linux perf_event_open.
+// Each counter is opened on its own so a partial set still works, and
+// inherit is set so threads spawned inside the region are counted too
+// (the kernel refuses group reads of inherited counters). When the PMU has
+// to multiplex them, each count is scaled from the time it was running to
+// the whole region; one that never got to run is not measured.
+// Where perf is missing or not permitted (most containers) every counter
+// reports unavailable and error says why.
+class PerfCounters {
+public:
+    enum Counter {
+        CYCLES,
+        INSTRUCTIONS,
+        L1D_MISSES,
+        LLC_MISSES,
+        BRANCH_MISSES,
+        FP_VECTOR,      // packed single-precision FP ops, Intel only
+        COUNT
+    };
+
+    int fds[COUNT];
+    bool available[COUNT];
+    bool measured[COUNT];           // ran during the last Start..Stop
+    uint64_t values[COUNT];
+    const char* error;
+
+    PerfCounters();
+    ~PerfCounters();
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    bool Any() const;
+    void Start();
+    void Stop();
+
+    static const char* Name(Counter counter);
+};
+
+#endif
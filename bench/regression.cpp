@@ -0,0 +1,139 @@
+#include "regression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static std::string ReadFile(const char* path) {
+    std::string text;
+    FILE* in = fopen(path, "rb");
+    if (!in) return text;
+
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), in)) > 0) text.append(buffer, n);
+    fclose(in);
+    return text;
+}
+
+// Only understands the JSON pendbench itself writes: within each benchmark
+// object "name" comes before "samples", and names contain no escapes.
+bool LoadBaseline(const char* path, std::vector<BaselineCase>& cases) {
+    std::string text = ReadFile(path);
+    if (text.empty()) return false;
+
+    const char* NAME_KEY = "\"name\": \"";
+    const char* SAMPLES_KEY = "\"samples\": [";
+    size_t pos = 0;
+    while ((pos = text.find(NAME_KEY, pos)) != std::string::npos) {
+        pos += strlen(NAME_KEY);
+        size_t end = text.find('"', pos);
+        if (end == std::string::npos) return false;
+
+        BaselineCase c;
+        c.name = text.substr(pos, end - pos);
+
+        pos = text.find(SAMPLES_KEY, end);
+        if (pos == std::string::npos) return false;
+        const char* p = text.c_str() + pos + strlen(SAMPLES_KEY);
+        while (*p && *p != ']') {
+            char* next;
+            double value = strtod(p, &next);
+            if (next == p) return false;
+            c.samples.push_back(value);
+            p = next;
+            while (*p == ',' || *p == ' ') p++;
+        }
+        pos = p - text.c_str();
+        cases.push_back(c);
+    }
+    return !cases.empty();
+}
+
+static double Median(std::vector<double> v) {
+    std::sort(v.begin(), v.end());
+    size_t n = v.size();
+    return n % 2 ? v[n / 2] : 0.5 * (v[n / 2 - 1] + v[n / 2]);
+}
+
+double MannWhitneyGreater(const std::vector<double>& a, const std::vector<double>& b) {
+    struct Ranked {
+        double value;
+        bool fromA;
+    };
+    std::vector<Ranked> all;
+    for (double v : a) all.push_back({ v, true });
+    for (double v : b) all.push_back({ v, false });
+    std::sort(all.begin(), all.end(), [](const Ranked& x, const Ranked& y) { return x.value < y.value; });
+
+    // rank sum of a with ties given their average rank
+    double n1 = double(a.size()), n2 = double(b.size()), n = n1 + n2;
+    double rankSumA = 0.0, tieTerm = 0.0;
+    for (size_t i = 0; i < all.size();) {
+        size_t j = i;
+        while (j < all.size() && all[j].value == all[i].value) j++;
+        double rank = 0.5 * double(i + 1 + j);
+        for (size_t k = i; k < j; k++) {
+            if (all[k].fromA) rankSumA += rank;
+        }
+        double t = double(j - i);
+        tieTerm += t * t * t - t;
+        i = j;
+    }
+
+    // normal approximation with tie and continuity corrections; close
+    // enough at the 10+ samples per side pendbench takes
+    double u = rankSumA - n1 * (n1 + 1.0) / 2.0;
+    double mean = n1 * n2 / 2.0;
+    double var = n1 * n2 / 12.0 * ((n + 1.0) - tieTerm / (n * (n - 1.0)));
+    if (var <= 0.0) return 0.5;
+    double z = (u - mean - 0.5) / std::sqrt(var);
+    return 0.5 * std::erfc(z / std::sqrt(2.0));
+}
+
+static const BaselineCase* Find(const std::vector<BaselineCase>& cases, const std::string& name) {
+    for (const BaselineCase& c : cases) {
+        if (c.name == name) return &c;
+    }
+    return nullptr;
+}
+
+bool CompareToBaseline(const std::vector<BaselineCase>& current, const std::vector<BaselineCase>& baseline,
+                       const RegressionOptions& options) {
+    printf("\n%-34s %12s %12s %8s %10s  %s\n", "case", "base median", "median", "change", "p", "verdict");
+
+    int regressions = 0, compared = 0, ungated = 0;
+    for (const BaselineCase& c : current) {
+        const BaselineCase* base = Find(baseline, c.name);
+        if (!base || base->samples.size() < 2 || c.samples.size() < 2) {
+            printf("%-34s NOT GATED: not in baseline\n", c.name.c_str());
+            ungated++;
+            continue;
+        }
+
+        double baseMedian = Median(base->samples);
+        double median = Median(c.samples);
+        double change = median / baseMedian - 1.0;
+        double p = MannWhitneyGreater(c.samples, base->samples);
+        bool regressed = p < options.alpha && change > options.threshold;
+
+        printf("%-34s %12.3f %12.3f %+7.1f%% %10.2g  %s\n", c.name.c_str(), baseMedian, median, change * 100.0, p,
+               regressed ? "REGRESSED" : "ok");
+        regressions += regressed;
+        compared++;
+    }
+    for (const BaselineCase& b : baseline) {
+        if (Find(current, b.name)) continue;
+        printf("%-34s NOT GATED: in baseline, not run\n", b.name.c_str());
+        ungated++;
+    }
+
+    printf("%d of %d cases regressed (threshold %.0f%%, alpha %g)\n", regressions, compared,
+           options.threshold * 100.0, options.alpha);
+    if (ungated) {
+        fprintf(stderr, "warning: %d cases not gated; re-record the baseline with --json on this machine\n", ungated);
+    }
+    return regressions == 0 && !(options.strict && ungated);
+}
@@ -0,0 +1,37 @@
+#ifndef REGRESSION_H
+#define REGRESSION_H
+
+#include <string>
+#include <vector>
+
+// Performance regression gate: each case's timing samples are compared
+// against the same case in a stored pendbench JSON with a one-sided
+// Mann-Whitney U test, which needs no normality assumption and shrugs off
+// the odd descheduled sample. A case regresses only if the shift is both
+// significant and larger than the threshold, so noise alone never fails
+// the gate. Baselines are machine specific; re-record one with --json.
+// Cases only one side has (threaded cases against a baseline from a
+// single-core host, say) aren't gated, and are listed as such.
+struct RegressionOptions {
+    double threshold = 0.10;   // relative slowdown of the median tolerated
+    double alpha = 0.01;       // significance level
+    bool strict = false;       // a case missing from either side fails the gate
+};
+
+struct BaselineCase {
+    std::string name;
+    std::vector<double> samples;   // ns per member-step
+};
+
+// reads name and samples of every benchmark in a pendbench JSON file
+bool LoadBaseline(const char* path, std::vector<BaselineCase>& cases);
+
+// one-sided p-value that a tends to be larger than b
+double MannWhitneyGreater(const std::vector<double>& a, const std::vector<double>& b);
+
+// prints a verdict per case, returns false if any case regressed (or, if
+// strict, couldn't be compared)
+bool CompareToBaseline(const std::vector<BaselineCase>& current, const std::vector<BaselineCase>& baseline,
+                       const RegressionOptions& options);
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef BATCH_CLASS_H
+#define BATCH_CLASS_H
+
+#include <cstddef>
+#include <cstdio>
+
+#include "ensemble.h"
+#include "scenario.h"
+
+// periodic checkpoints of a batch or scenario run (see checkpoint.h)
+struct CheckpointOptions {
+    const char* path = nullptr;
+    double every = 60.0;            // simulated seconds between checkpoints
+    const char* resume = nullptr;   // continue from this checkpoint
+};
+
+// Headless runs for machines without a display: the app hands its command
+// line here before touching GLFW, so nothing but the physics is set up.
+struct BatchOptions {
+    // the Controls panel defaults
+    PendulumParams params{ 0.3f, 0.3f, 0.1f, 0.1f, 9.81f };
+    PendulumState initial{ 0.0f, 0.0f, 0.0f, 0.0f };
+
+    float dt = 0.005f;
+    double duration = 10.0;         // simulated seconds
+    Integrator integrator = Integrator::SemiImplicitEuler;
+    Kernel kernel = Kernel::Simd;
+    int threads = 1;
+
+    // members spread theta1 evenly over [theta1 - spread/2, theta1 + spread/2]
+    size_t members = 1;
+    float spread = 0.0f;
+
+    // .pendrec records every output step; .csv and .ndjson export them as
+    // text; anything else gets the final states as CSV
+    const char* output = nullptr;
+    int every = 1;                  // steps between outputs
+    const char* share = nullptr;    // shm name to publish output steps to (see sharedRing.h)
+    const char* telemetry = nullptr;    // socket to serve output steps on (see telemetry.h)
+    bool quiet = false;
+
+    // resuming takes the state, parameters, dt and integrator from the
+    // checkpoint; duration, threads, kernel and output still come from here
+    CheckpointOptions checkpoints;
+};
+
+// true if the command line asks for a batch run
+bool IsBatchRun(int argc, char** argv);
+
+// false on an unknown flag or a bad value
+bool ParseBatchArgs(int argc, char** argv, BatchOptions& options);
+void BatchUsage(FILE* out);
+
+// process exit status: 0 on success, 1 if the output could not be written
+int RunBatch(const BatchOptions& options);
+
+// every run and member of a scenario, one batch of members at a time,
+// writing final states as CSV to the scenario's output if it has one
+int RunScenario(const Scenario& scenario, bool quiet, const CheckpointOptions& checkpoints = CheckpointOptions());
+
+// re-runs an app session from its journal (see journal.h), writing the
+// trajectory or final state to output like RunBatch; 1 also if the
+// replayed trajectory doesn't hash to what the app recorded
+int RunReplay(const char* journal, const char* output, bool quiet);
+
+// parse, run, and report usage errors with status 2
+int BatchMain(int argc, char** argv);
+
+#endif
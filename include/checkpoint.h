@@ -0,0 +1,81 @@
+#ifndef CHECKPOINT_CLASS_H
+#define CHECKPOINT_CLASS_H
+
+#include <cstdint>
+
+#include "densityMap.h"
+#include "ensemble.h"
+
+// Complete simulation state for restarting a pre-empted run. Every section
+// starts on a CHECKPOINT_PAGE boundary so restore can map it instead of
+// reading it:
+//
+//   page 0:   CheckpointHeader
+//   columns:  theta1, theta2, omega1, omega2, capacity floats each, exactly
+//             as Ensemble lays them out (padding members included)
+//   density:  width * height floats, if a DensityMap was saved
+//
+// Save writes the whole file with one writev and an fsync into a temporary
+// file, then renames it over the old checkpoint, so a crash mid-save leaves
+// the previous checkpoint intact.
+const uint32_t CHECKPOINT_VERSION = 1;
+// a multiple of every page size in use (4 KB x86, 16 KB Apple Silicon,
+// 64 KB some ARM servers), so files map on any host
+const uint64_t CHECKPOINT_PAGE = 65536;
+
+// everything but the bulk arrays, filled in by the caller
+struct CheckpointState {
+    uint64_t step = 0;              // steps completed
+    double time = 0.0;              // simulated seconds completed
+    float dt = 0.0f;
+    Integrator integrator = Integrator::SemiImplicitEuler;
+    PendulumParams params{};
+
+    // position in a scenario: the run, the first member of the batch in the
+    // ensemble, and the sampling seed (members are a function of it)
+    uint64_t run = 0;
+    uint64_t firstMember = 0;
+    uint64_t seed = 0;
+
+    uint64_t outputBytes = 0;       // output written up to this state
+};
+
+struct CheckpointHeader {
+    char magic[8];                  // "PENDCKP1"
+    uint32_t version;
+    uint32_t integrator;
+    uint64_t step;
+    double time;
+    float dt;
+    PendulumParams params;
+    uint64_t run;
+    uint64_t firstMember;
+    uint64_t seed;
+    uint64_t outputBytes;
+
+    uint64_t members;
+    uint64_t capacity;
+    uint64_t columnsOffset;
+    uint64_t columnsBytes;
+
+    uint32_t densityWidth;          // 0 without a density section
+    uint32_t densityHeight;
+    float densityPeak;
+    uint64_t densitySamples;
+    uint64_t densityOffset;
+    uint64_t densityBytes;
+};
+
+// density is optional
+bool SaveCheckpoint(const char* path, const Ensemble& e, const CheckpointState& state,
+                    const DensityMap* density = nullptr);
+
+// Maps the columns copy-on-write and hands them to e (see Ensemble::Adopt),
+// so the cost is page faults as members are touched, not a read of the
+// file. Columns that aren't page aligned on this host are read instead.
+// The density section is copied into density if both exist and the sizes
+// match. False if the file is missing, truncated, inconsistent or not a
+// checkpoint.
+bool LoadCheckpoint(const char* path, Ensemble& e, CheckpointState& state, DensityMap* density = nullptr);
+
+#endif
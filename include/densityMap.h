@@ -0,0 +1,26 @@
+#ifndef DENSITY_MAP_CLASS_H
+#define DENSITY_MAP_CLASS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Long-exposure histogram of bob positions. Positions are given in NDC
+// ([-1, 1] on both axes, +y up) and splatted bilinearly into a fixed grid,
+// so memory stays constant however long the run is.
+class DensityMap {
+public:
+    int width;
+    int height;
+    std::vector<float> bins;   // row 0 is the bottom of the screen
+    float peak;                // largest bin value, used for tone mapping
+    uint64_t samples;
+
+    DensityMap(int width, int height);
+
+    // xy holds count interleaved (x, y) pairs
+    void Splat(const float* xy, size_t count);
+    void Clear();
+};
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef ENSEMBLE_CLASS_H
+#define ENSEMBLE_CLASS_H
+
+#include <cstddef>
+#include "pendulum.h"
+#include "physicsStats.h"
+
+class WorkerPool;
+
+// Many independent pendulums sharing one set of parameters, stored as
+// structure-of-arrays columns in a single 64-byte aligned block. Capacity is
+// padded to whole SIMD blocks; padding members are valid resting pendulums.
+class Ensemble {
+public:
+    static const size_t BLOCK = 16;   // members per padded block
+
+    size_t size;
+    size_t capacity;
+    float* theta1;
+    float* theta2;
+    float* omega1;
+    float* omega2;
+    void* memory;
+    size_t mappedBytes;     // nonzero if memory is a file mapping (see Adopt)
+    WorkerPool* workers;    // Advance's threads, started on first use
+
+    Ensemble(size_t size);
+    ~Ensemble();
+    Ensemble(const Ensemble&) = delete;
+    Ensemble& operator=(const Ensemble&) = delete;
+
+    // Takes over four capacity-float columns at the start of a private file
+    // mapping, laid out as the constructor lays them out, in place of the
+    // current memory. The mapping is unmapped with the ensemble.
+    void Adopt(size_t size, size_t capacity, void* mapping, size_t mappingBytes);
+
+    PendulumState Get(size_t i) const;
+    void Set(size_t i, const PendulumState& s);
+    void Fill(const PendulumState& s);
+};
+
+enum class Kernel {
+    Scalar,   // StepPendulum per member, the reference
+    Simd,     // lane-blocked with polynomial sin/cos, written to auto-vectorize
+};
+
+const char* KernelName(Kernel kernel);
+
+struct AdvanceOptions {
+    Integrator integrator = Integrator::SemiImplicitEuler;
+    Kernel kernel = Kernel::Simd;
+    int threads = 1;
+    bool pinThreads = false;
+    PhysicsCounters* counters = nullptr;   // optional throughput accounting
+};
+
+// Advances every member by steps * dt. Members are independent, so each
+// thread takes a contiguous slice and runs all steps on it while it is hot.
+// The threads stay with the ensemble between calls, so advancing a few steps
+// at a time doesn't start and join threads every call.
+void Advance(Ensemble& e, const PendulumParams& p, float dt, int steps, const AdvanceOptions& options);
+
+// same, for members [begin, end) on the calling thread; begin must be a
+// multiple of Ensemble::BLOCK for the SIMD kernel
+void AdvanceRange(Ensemble& e, const PendulumParams& p, float dt, int steps,
+                  Integrator integrator, Kernel kernel, size_t begin, size_t end);
+
+// pins the calling thread to one CPU; false where unsupported or denied
+bool PinThread(int cpu);
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef EXPORTER_CLASS_H
+#define EXPORTER_CLASS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "ensemble.h"
+
+// Streams states as text for tools that can't read recordings (see
+// recorder.h). Push copies one step into a single-producer single-consumer
+// ring without locking; a writer thread formats numbers with to_chars and
+// writes in large blocks. What happens when the ring is full is up to the
+// policy, so the caller never waits on the disk unless it asked to.
+class Exporter {
+public:
+    enum class Format {
+        Csv,        // header row, then step,time,member,theta1,theta2,omega1,omega2
+        Ndjson,     // one object per member per step
+    };
+
+    enum class Backpressure {
+        Block,      // wait for the writer: nothing lost
+        Drop,       // skip the step and count it
+        Decimate,   // keep every nth step, n doubling each time the ring fills
+    };
+
+    static const size_t QUEUE_BYTES = size_t(16) << 20;
+    static const size_t BUFFER_BYTES = size_t(1) << 20;
+    static const uint32_t MAX_DECIMATION = 1024;
+
+    std::atomic<uint64_t> offered{0};       // steps pushed
+    std::atomic<uint64_t> exported{0};      // steps written by the writer thread
+    std::atomic<uint64_t> dropped{0};       // by Drop, or by Decimate when full
+    std::atomic<uint64_t> decimated{0};     // skipped by the decimation stride
+    std::atomic<uint64_t> stalls{0};        // pushes that had to wait (Block)
+    std::atomic<uint64_t> fileBytes{0};
+    std::atomic<uint32_t> decimation{1};
+    std::atomic<bool> failed{false};
+
+    size_t members;
+    float dt;
+    Format format;
+    Backpressure policy;
+
+    Exporter();
+    ~Exporter();
+    Exporter(const Exporter&) = delete;
+    Exporter& operator=(const Exporter&) = delete;
+
+    // queueSteps 0 sizes the ring to about QUEUE_BYTES
+    bool Open(const char* path, size_t members, float dt, Format format, Backpressure policy, size_t queueSteps = 0);
+    bool IsOpen() const { return file != nullptr; }
+
+    // the next step of every member, as four columns; call from one thread.
+    // Steps are numbered from 0 at Open, and time is the end of the step
+    void Push(const float* theta1, const float* theta2, const float* omega1, const float* omega2);
+    void Push(const Ensemble& e);
+    void Push(const PendulumState& s);
+
+    // drains the ring, then waits for the writer; false if a write failed
+    bool Close();
+
+private:
+    FILE* file;
+    size_t slots;
+    std::vector<uint64_t> stepOf;           // slots
+    std::vector<float> ring;                // slots * members * 4, columns as pushed
+    std::vector<char> buffer;
+    size_t used;
+    std::chrono::steady_clock::time_point flushed;
+    std::thread writer;
+    std::atomic<bool> closing{false};
+
+    // head is written only by Push, tail only by the writer
+    alignas(64) std::atomic<uint64_t> head{0};
+    alignas(64) std::atomic<uint64_t> tail{0};
+
+    void WriterLoop();
+    void FormatSlot(size_t slot);
+    void Flush();
+};
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef FBO_CLASS_H
+#define FBO_CLASS_H
+
+#include <glad/glad.h>
+#include "texture.h"
+
+class FBO {
+public:
+    GLuint ID;
+
+    FBO();
+
+    // attaches the texture as colour attachment 0
+    void AttachTexture(Texture& texture);
+
+    void Bind();
+    void Unbind();
+    void Delete();
+};
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef FRAME_CAPTURE_CLASS_H
+#define FRAME_CAPTURE_CLASS_H
+
+#include <glad/glad.h>
+#include "videoWriter.h"
+
+// Reads the framebuffer back through a ring of pixel buffer objects.
+// glReadPixels into a PBO only queues a copy, so each frame starts a read
+// and maps the oldest one, whose fence has normally passed by then; the CPU
+// waits on the GPU only when every PBO is still in flight. A read can be
+// handed over more than once, to hold a frame in a fixed-rate video.
+class FrameCapture {
+public:
+    static const int PBO_COUNT = 3;
+
+    GLuint IDs[PBO_COUNT];
+    GLsync fences[PBO_COUNT];
+    int copies[PBO_COUNT];      // times each read goes to the writer
+    int width;
+    int height;
+    int next;       // PBO the next read goes to
+    int pending;    // reads in flight, oldest at next - pending
+
+    FrameCapture();
+
+    // sizes the PBOs for width x height RGBA, dropping reads in flight
+    void Resize(int width, int height);
+
+    // Starts reading the bottom-left width x height of the read framebuffer,
+    // then hands every finished read to the writer, oldest first, copies
+    // times each. wait makes both the GPU and the writer lossless, at the
+    // cost of stalling on them.
+    void Read(VideoWriter& writer, bool wait, int copies = 1);
+
+    // hands the reads still in flight to the writer
+    void Flush(VideoWriter& writer);
+
+    void Delete();
+
+private:
+    void Deliver(VideoWriter& writer, bool wait);
+};
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef GPU_TIMER_CLASS_H
+#define GPU_TIMER_CLASS_H
+
+#include <glad/glad.h>
+
+// GL_TIME_ELAPSED query pair. Each frame writes one query and reads the
+// other one back, so results are a frame late but never stall the CPU.
+class GpuTimer {
+public:
+    GLuint IDs[2];
+    bool pending[2];
+    int current;
+    double lastMs;   // most recent completed measurement
+
+    GpuTimer();
+
+    void Begin();
+    void End();
+    void Delete();
+};
+
+#endif
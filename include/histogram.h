@@ -0,0 +1,42 @@
+#ifndef HISTOGRAM_CLASS_H
+#define HISTOGRAM_CLASS_H
+
+#include <cstdint>
+#include <vector>
+
+// HDR-style log-linear histogram of non-negative integers. Each power of two
+// is split into SUB_BUCKETS / 2 linear buckets, so any recorded value is
+// known to within 1/64 of itself. Memory is fixed by highest at
+// construction; larger values are clamped into the top bucket.
+class Histogram {
+public:
+    static const int SUB_BITS = 7;
+    static const int SUB_BUCKETS = 1 << SUB_BITS;
+
+    const char* name;
+    const char* unit;          // of the recorded integers, e.g. "us"
+    uint64_t highest;
+    std::vector<uint64_t> counts;
+    uint64_t total;
+    uint64_t min;
+    uint64_t max;
+    double sum;
+
+    Histogram(const char* name, const char* unit, uint64_t highest);
+
+    void Record(uint64_t value);
+    void Reset();
+
+    // p in [0, 1]; the midpoint of the bucket holding that rank
+    uint64_t Percentile(double p) const;
+    double Mean() const;
+
+    int BucketIndex(uint64_t value) const;
+    uint64_t BucketLow(int index) const;
+    uint64_t BucketWidth(int index) const;
+};
+
+// one row per non-empty bucket: name,unit,low,high,count,cumulative
+bool WriteHistogramsCsv(const char* path, const Histogram* const* histograms, int count);
+
+#endif
@@ -0,0 +1,137 @@
+#ifndef JOURNAL_CLASS_H
+#define JOURNAL_CLASS_H
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "pendulum.h"
+
+// A journal of everything an interactive session did to the simulation,
+// keyed by physics step, so the exact trajectory can be replayed headless
+// without recording it:
+//
+//   JournalHeader        the inputs when journaling started
+//   events               varint steps since the previous event, a
+//                        JournalEvent byte, and a float for value events
+//   End, JournalFooter   steps taken and a hash of every state; missing if
+//                        the app died, in which case replay stops at the
+//                        last event and can't be verified
+//
+// The app steps a single pendulum with the semi-implicit Euler scheme.
+const uint32_t JOURNAL_VERSION = 1;
+
+enum class JournalEvent : uint8_t {
+    // take a float
+    Theta1, Theta2, Omega1, Omega2,
+    Rod1, Rod2, Mass1, Mass2, Gravity,
+    Dt, Damping,
+    // don't
+    Pause, Resume,
+    Reset, Start,           // buttons; their effects are journaled separately
+    End,
+};
+
+const int JOURNAL_VALUE_EVENTS = int(JournalEvent::Damping) + 1;
+const char* JournalEventName(JournalEvent kind);
+
+// what the UI can change between physics steps
+struct JournalInputs {
+    PendulumState state;
+    PendulumParams params;
+    float dt;
+    float damping;          // shown in the UI but not used by the physics
+    bool paused;
+};
+
+struct JournalHeader {
+    char magic[8];          // "PENDJNL1"
+    uint32_t version;
+    uint32_t paused;
+    PendulumState state;
+    PendulumParams params;
+    float dt;
+    float damping;
+};
+
+struct JournalFooter {
+    uint64_t steps;
+    uint64_t hash;          // FNV-1a of every state after every step
+    char magic[8];          // "PENDJEND"
+};
+
+// FNV-1a over the bytes of one state, continuing from hash
+uint64_t HashState(uint64_t hash, const PendulumState& s);
+const uint64_t JOURNAL_HASH_SEED = 14695981039346656037ull;
+
+class Journal {
+public:
+    uint64_t events;
+    uint64_t steps;
+    uint64_t hash;
+
+    Journal();
+    ~Journal();
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    bool Open(const char* path, const JournalInputs& inputs);
+    bool IsOpen() const { return file != nullptr; }
+
+    // Once per frame, after the UI and before physics: journals whatever
+    // differs from the last known inputs, at the current step.
+    void Sync(const JournalInputs& inputs);
+
+    // a button press, for whoever reads the journal
+    void Mark(JournalEvent kind);
+
+    // after each physics step, with the new state
+    void Step(const PendulumState& s);
+
+    // writes the footer; false if anything failed to write
+    bool Close();
+
+private:
+    FILE* file;
+    JournalInputs last;
+    uint64_t eventStep;     // step of the previous event
+    bool failed;
+
+    void Write(JournalEvent kind, const float* value);
+};
+
+// Reads a journal and re-runs it one step at a time.
+class JournalReplay {
+public:
+    JournalHeader header;
+    JournalInputs inputs;   // as of the current step
+    uint64_t step;
+    uint64_t steps;         // total to replay
+    uint64_t hash;
+    bool ended;             // the footer was there
+    JournalFooter footer;
+
+    JournalReplay();
+
+    bool Open(const char* path);
+
+    // applies the events due at this step and takes one physics step;
+    // false once every step has been replayed
+    bool Step();
+
+    // true once all steps are replayed and the hash matches the footer
+    bool Verified() const { return ended && step == footer.steps && hash == footer.hash; }
+
+private:
+    struct Event {
+        uint64_t step;
+        JournalEvent kind;
+        float value;
+    };
+    std::vector<Event> events;
+    size_t next;
+
+    void Apply(const Event& e);
+};
+
+#endif
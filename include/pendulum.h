@@ -0,0 +1,66 @@
+#ifndef PENDULUM_CLASS_H
+#define PENDULUM_CLASS_H
+
+struct PendulumParams {
+    float rodLength;
+    float rodLength2;
+    float mass;
+    float mass2;
+    float gravity;
+};
+
+// theta2 is measured from the vertical, like theta1
+struct PendulumState {
+    float theta1;
+    float theta2;
+    float omega1;
+    float omega2;
+};
+
+enum class Integrator {
+    Euler,
+    SemiImplicitEuler,   // the original UpdatePendulum scheme
+    Midpoint,
+    RK4,
+};
+
+const int INTEGRATOR_COUNT = 4;
+const char* IntegratorName(Integrator integrator);
+
+// parses the names returned by IntegratorName; returns false if unknown
+bool ParseIntegrator(const char* name, Integrator& integrator);
+
+// derivative evaluations per step, for cost estimates
+int IntegratorStages(Integrator integrator);
+
+// angular accelerations of both arms from the equations of motion
+void Accelerations(const PendulumState& s, const PendulumParams& p, float& alpha1, float& alpha2);
+
+// total mechanical energy, zero with both arms horizontal at the pivot
+float Energy(const PendulumState& s, const PendulumParams& p);
+
+// one semi-implicit Euler step, angles wrapped into (-2*PI, 2*PI)
+void UpdatePendulum(PendulumState& s, const PendulumParams& p, float dt);
+
+// one step of any integrator, angles wrapped the same way
+void StepPendulum(PendulumState& s, const PendulumParams& p, float dt, Integrator integrator);
+
+// Keeps the last two states so the renderer can sample anywhere in between
+class Pendulum {
+public:
+    PendulumState prev;
+    PendulumState curr;
+    float dt;   // size of the step from prev to curr
+
+    Pendulum(const PendulumState& initial);
+
+    void Step(const PendulumParams& p, float dt);
+
+    // jump to a new state without interpolating across the change
+    void Set(const PendulumState& s);
+
+    // cubic Hermite dense output at t = prev + alpha * dt, alpha in [0, 1]
+    PendulumState Sample(const PendulumParams& p, float alpha) const;
+};
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef PHYSICS_STATS_CLASS_H
+#define PHYSICS_STATS_CLASS_H
+
+#include <atomic>
+#include <cstdint>
+
+// Running totals fed by whichever threads step physics. Updates are relaxed
+// fetch_adds: nothing is ordered against them, and readers only need totals
+// that are right eventually.
+class PhysicsCounters {
+public:
+    std::atomic<uint64_t> memberSteps{0};
+    std::atomic<uint64_t> stepNanos{0};     // thread time spent stepping
+    std::atomic<uint64_t> simNanos{0};      // simulated time advanced
+    std::atomic<uint64_t> frames{0};
+    std::atomic<uint64_t> frameSteps{0};    // catch-up steps, summed over frames
+    std::atomic<uint32_t> lastFrameSteps{0};
+
+    void AddSteps(uint64_t members, uint64_t nanos) {
+        memberSteps.fetch_add(members, std::memory_order_relaxed);
+        stepNanos.fetch_add(nanos, std::memory_order_relaxed);
+    }
+
+    void AddSimTime(double seconds) {
+        simNanos.fetch_add(uint64_t(seconds * 1e9), std::memory_order_relaxed);
+    }
+
+    // steps the fixed-step accumulator took to catch up this frame
+    void AddFrame(uint32_t steps) {
+        frames.fetch_add(1, std::memory_order_relaxed);
+        frameSteps.fetch_add(steps, std::memory_order_relaxed);
+        lastFrameSteps.store(steps, std::memory_order_relaxed);
+    }
+};
+
+// Rates from PhysicsCounters, recomputed from deltas every INTERVAL seconds
+// so the numbers are readable rather than flickering per frame.
+class ThroughputMeter {
+public:
+    static constexpr double INTERVAL = 0.5;
+
+    double memberStepsPerSecond;
+    double nsPerStep;               // per member-step, per thread
+    double realtimeFactor;          // simulated seconds per wall second
+    double stepsPerFrame;           // mean catch-up steps per frame
+
+    ThroughputMeter();
+
+    // true when the rates were refreshed
+    bool Update(const PhysicsCounters& counters, double now);
+
+private:
+    double lastTime;
+    uint64_t lastMemberSteps, lastStepNanos, lastSimNanos, lastFrames, lastFrameSteps;
+};
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef PROFILER_CLASS_H
+#define PROFILER_CLASS_H
+
+#include <chrono>
+#include <cstdint>
+
+// Rolling per-frame timings for named CPU and GPU zones, shown as stacked
+// bars with percentiles in an ImGui window.
+class Profiler {
+public:
+    static const int HISTORY = 240;     // frames kept per zone
+    static const int MAX_ZONES = 12;
+
+    const char* names[MAX_ZONES];
+    bool gpu[MAX_ZONES];
+    float history[MAX_ZONES][HISTORY];  // ms, ring indexed by next
+    float current[MAX_ZONES];           // accumulated during this frame
+    std::chrono::steady_clock::time_point starts[MAX_ZONES];
+    uint64_t traceStarts[MAX_ZONES];    // CPU zones also go to the trace when enabled
+    int zoneCount;
+    int next;
+    int frames;                         // valid history entries
+
+    Profiler();
+
+    int AddZone(const char* name, bool gpu = false);
+
+    // CPU zones are timed between Begin and End; GPU zones are fed with Add
+    void Begin(int zone);
+    void End(int zone);
+    void Add(int zone, float ms);
+
+    // commit this frame's zone totals to the history
+    void EndFrame();
+
+    float Latest(int zone) const;
+    float Percentile(int zone, float p) const;
+
+    // sum of the latest GPU zones, for the quality governor
+    float LatestGpuTotal() const;
+
+    void Draw(const char* title, bool* open);
+};
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef QUALITY_GOVERNOR_CLASS_H
+#define QUALITY_GOVERNOR_CLASS_H
+
+// What the renderer should do at the governor's current level
+struct QualitySettings {
+    float trailScale;          // trail targets relative to framebuffer size
+    int circleSegments;        // bob tessellation
+    bool msaa;
+    int densityUploadInterval; // frames between long-exposure uploads
+};
+
+// Steps render quality down when the p99 frame cost exceeds the budget and
+// back up once there is plenty of headroom. Frame cost is max(CPU, GPU) work
+// time, excluding the wait inside glfwSwapBuffers.
+class QualityGovernor {
+public:
+    static const int MAX_LEVEL = 5;
+    static const int WINDOW = 120;      // frames considered for the percentile
+
+    float targetMs;
+    int level;                          // 0 = full quality
+    float samples[WINDOW];
+    int count;
+    int next;
+    int framesSinceChange;
+
+    QualityGovernor(float targetMs);
+
+    void Record(float cpuMs, float gpuMs);
+    void Reset();
+
+    float P99() const;
+    QualitySettings Settings() const;
+    static QualitySettings Full();
+
+    // human readable list of what is currently being given up
+    const char* Sacrificing() const;
+};
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef RECORDER_CLASS_H
+#define RECORDER_CLASS_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "ensemble.h"
+#include "trajectoryFormat.h"
+
+// Records every step of an ensemble (or one pendulum) to a chunked
+// trajectory file that stores each value as its difference from a
+// polynomial extrapolation of the member's history (see trajectoryFormat.h).
+// Record only copies the step into a single-producer single-consumer ring
+// without locking; a writer thread encodes and writes. If the disk falls
+// behind and the ring fills, Record waits rather than dropping steps, and
+// stalls counts how often that happened.
+class Recorder {
+public:
+    // the ring holds as many steps as fit in this much, from 4 to 1024, so
+    // it takes max(RING_BYTES, 4 steps): over the cap above ~1M members
+    static const size_t RING_BYTES = size_t(64) << 20;
+
+    std::atomic<uint64_t> steps{0};         // recorded by the caller
+    std::atomic<uint64_t> stalls{0};
+    std::atomic<uint64_t> fileBytes{0};     // written by the writer thread
+    std::atomic<bool> failed{false};        // a write failed; the file is incomplete
+
+    size_t members;
+    uint32_t chunkSteps;
+
+    Recorder();
+    ~Recorder();
+    Recorder(const Recorder&) = delete;
+    Recorder& operator=(const Recorder&) = delete;
+
+    // chunkSteps 0 picks a size that keeps chunks around 16 MB raw
+    bool Open(const char* path, size_t members, float dt, const PendulumParams& p, Integrator integrator,
+              uint32_t chunkSteps = 0);
+    bool IsOpen() const { return file != nullptr; }
+
+    // one step of every member, as four columns; call from one thread
+    void Record(const float* theta1, const float* theta2, const float* omega1, const float* omega2);
+    void Record(const Ensemble& e);
+    void Record(const PendulumState& s);
+
+    // writes the last partial chunk and the seek index, then waits for the
+    // writer; false if anything failed to write
+    bool Close();
+
+    // uncompressed size of what has been recorded, for the ratio
+    uint64_t RawBytes() const;
+
+private:
+    FILE* file;
+    std::vector<float> ring;                // slots * members * TRAJECTORY_COLUMNS
+    size_t slots;
+    std::thread writer;
+    std::atomic<bool> closing{false};
+    std::vector<ChunkIndexEntry> index;     // owned by the writer thread
+
+    // head is written only by Record, tail only by the writer
+    alignas(64) std::atomic<uint64_t> head{0};
+    alignas(64) std::atomic<uint64_t> tail{0};
+
+    void WriterLoop();
+    bool WriteChunk(ColumnEncoder* encoders, uint32_t chunkLength, uint64_t firstStep);
+    bool WriteIndex(uint64_t totalSteps);
+};
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef SCENARIO_CLASS_H
+#define SCENARIO_CLASS_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "ensemble.h"
+
+// A declarative description of what to simulate: run settings, the
+// parameters (each a value or a swept range), and how the ensemble's
+// initial conditions are sampled. One "key value" per line, # comments:
+//
+//   dt 0.002
+//   duration 30
+//   integrator rk4
+//   rod2 0.1:0.5:5          # sweep: from:to:count, one run per value
+//   sampling grid           # single, grid, cloud or sobol
+//   theta1 -180:180:512     # degrees; a grid axis
+//   theta2 -30              # fixed
+//   output final.csv
+//
+// Angles are in degrees, angular velocities in rad/s. Under grid, ranged
+// state variables are the axes. Under cloud, "value~sigma" is normal and a
+// range is uniform. Under sobol, ranges are the box the points fill. cloud
+// and sobol take "members N"; "seed N" varies the cloud.
+//
+// Nothing is expanded up front: Member(i) computes the i-th initial state
+// on demand, so a 10^9-member scenario costs the same memory as one, and
+// Fill loads one batch of members at a time into an ensemble.
+enum class Sampling {
+    Single,
+    Grid,
+    Cloud,
+    Sobol,
+};
+
+struct ScenarioValue {
+    float from;
+    float to;
+    uint32_t count;     // 1 for a fixed value; 0 for a sobol box without a count
+    float sigma;        // cloud only: normal around from
+};
+
+class Scenario {
+public:
+    static const int STATE_VARS = 4;
+    static const int PARAMS = 5;
+    static const int MAX_PATH = 256;
+    static const int SOBOL_BITS = 32;
+
+    // run settings
+    float dt;
+    double duration;
+    Integrator integrator;
+    Kernel kernel;
+    int threads;
+    size_t batch;           // members simulated at once
+
+    // rod1, rod2, mass1, mass2, gravity; any with count > 1 is swept
+    ScenarioValue params[PARAMS];
+    // theta1, theta2 (radians once parsed), omega1, omega2
+    ScenarioValue state[STATE_VARS];
+    Sampling sampling;
+    uint64_t members;       // cloud and sobol; derived for grid and single
+    uint64_t seed;
+
+    char output[MAX_PATH];
+
+    // the defaults match the app's startup state
+    Scenario();
+
+    // false with a message naming the line if the text is malformed
+    bool Parse(const char* text, size_t length, char* error, size_t errorSize);
+    bool Load(const char* path, char* error, size_t errorSize);
+
+    uint64_t Members() const { return members; }
+    uint64_t Runs() const;
+
+    PendulumParams Params(uint64_t run) const;
+    PendulumState Member(uint64_t i) const;
+
+    // members [first, first + count) into e; the rest of e rests at zero
+    void Fill(Ensemble& e, uint64_t first, size_t count) const;
+
+    static const char* ParamName(int param);
+    static const char* StateName(int var);
+
+private:
+    uint32_t sobol[STATE_VARS][SOBOL_BITS];   // direction numbers per ranged variable
+
+    bool Finish(char* error, size_t errorSize);
+};
+
+#endif
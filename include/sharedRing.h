@@ -0,0 +1,127 @@
+#ifndef SHARED_RING_CLASS_H
+#define SHARED_RING_CLASS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "ensemble.h"
+
+// Live state for other processes on the same host: a POSIX shared-memory
+// object holding a ring of snapshots, written by one producer and read in
+// place by any number of readers. Neither side makes a syscall or takes a
+// lock per snapshot; each slot is a seqlock, so a reader that was lapped
+// by the producer finds out afterwards instead of blocking it.
+//
+//   SharedRingHeader               one page
+//   slot 0 .. slots - 1:           SharedSlot, then theta1, theta2, omega1,
+//                                  omega2 columns of members floats each
+//
+// Snapshot n lives in slot n % slots. While it is written the slot's
+// sequence is 2n + 1, and 2n + 2 once it is complete.
+const uint32_t SHARED_RING_VERSION = 1;
+
+struct SharedRingHeader {
+    char magic[8];                          // "PENDSHM1"
+    uint32_t version;
+    uint32_t slots;                         // a power of two
+    uint64_t members;
+    uint64_t slotBytes;                     // SharedSlot plus columns, 64-byte multiple
+    float dt;                               // simulated seconds per step
+
+    alignas(64) std::atomic<uint64_t> published;   // snapshots completed
+    std::atomic<uint32_t> closed;                  // the producer has gone
+};
+
+struct alignas(64) SharedSlot {
+    std::atomic<uint64_t> sequence;
+    uint64_t step;
+    double time;
+    PendulumParams params;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "readers in other processes need lock-free atomics");
+
+// the producer side
+class SharedRing {
+public:
+    static const size_t MAX_NAME = 64;
+    // slots 0 picks as many as fit in about this much, 2 to 1024
+    static const size_t RING_BYTES = size_t(64) << 20;
+
+    SharedRingHeader* header;
+    size_t mappedBytes;
+
+    SharedRing();
+    ~SharedRing();
+    SharedRing(const SharedRing&) = delete;
+    SharedRing& operator=(const SharedRing&) = delete;
+
+    // name is a POSIX shm name like "/pendsim"; an existing object of that
+    // name is unlinked first, so readers still attached to it see it closed.
+    // A null name makes an anonymous ring for readers in this process (see
+    // SharedRingReader::Attach). slots is rounded up to a power of two.
+    bool Create(const char* name, size_t members, uint32_t slots, float dt);
+    bool IsOpen() const { return header != nullptr; }
+
+    // copies one snapshot into the next slot; e must have members members
+    void Publish(const Ensemble& e, uint64_t step, double time, const PendulumParams& p);
+    void Publish(const PendulumState& s, uint64_t step, double time, const PendulumParams& p);
+
+    // marks the ring closed and unlinks its name
+    void Close();
+
+private:
+    char name[MAX_NAME];
+    uint64_t next;                          // snapshot number to publish
+
+    SharedSlot* Slot(uint64_t n) const;
+    float* Begin(uint64_t step, double time, const PendulumParams& p);
+    void End();
+};
+
+// A snapshot read in place. The pointers are into the shared mapping and
+// may change under the reader if it is lapped: check Validate once done.
+struct SharedView {
+    uint64_t snapshot;
+    uint64_t step;
+    double time;
+    PendulumParams params;
+    size_t members;
+    const float* theta1;
+    const float* theta2;
+    const float* omega1;
+    const float* omega2;
+    const SharedSlot* slot;
+};
+
+// the consumer side; any number of these, in any process
+class SharedRingReader {
+public:
+    const SharedRingHeader* header;
+    size_t mappedBytes;                     // 0 if attached rather than mapped
+
+    SharedRingReader();
+    ~SharedRingReader();
+    SharedRingReader(const SharedRingReader&) = delete;
+    SharedRingReader& operator=(const SharedRingReader&) = delete;
+
+    bool Open(const char* name);
+    // reads ring in place without mapping it again; ring must outlive this
+    void Attach(const SharedRing& ring);
+    void Close();
+    bool IsOpen() const { return header != nullptr; }
+
+    // snapshots published so far; the newest is Published() - 1
+    uint64_t Published() const { return header->published.load(std::memory_order_acquire); }
+    bool Closed() const { return header->closed.load(std::memory_order_acquire) != 0; }
+
+    // false if snapshot n isn't complete yet or has been overwritten
+    bool Acquire(uint64_t n, SharedView& view) const;
+
+    // true if nothing overwrote the view since Acquire; anything read
+    // through it before this returns true can be trusted
+    bool Validate(const SharedView& view) const;
+};
+
+#endif
@@ -0,0 +1,154 @@
+#ifndef TELEMETRY_CLASS_H
+#define TELEMETRY_CLASS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/uio.h>
+
+#include "ensemble.h"
+#include "sharedRing.h"
+
+// Live state over a Unix-domain stream socket, for tools that can't map
+// shared memory. Linux only (epoll); elsewhere Start fails.
+//
+// On connect the server sends a TelemetryHello. The client then sends a
+// TelemetrySubscribe, and again whenever it wants different filters; until
+// the first one it gets nothing. Each selected step arrives as a
+// TelemetryFrame followed by one float column per selected field, in
+// TelemetryField bit order, of frame.members values each; Params is five
+// floats (rod1, rod2, mass1, mass2, gravity) rather than a column.
+// Everything is little-endian host layout; the socket never leaves the host.
+const uint32_t TELEMETRY_VERSION = 1;
+
+enum TelemetryField : uint32_t {
+    TELEMETRY_THETA1 = 1u << 0,
+    TELEMETRY_THETA2 = 1u << 1,
+    TELEMETRY_OMEGA1 = 1u << 2,
+    TELEMETRY_OMEGA2 = 1u << 3,
+    TELEMETRY_ENERGY = 1u << 4,     // per member, computed by the server
+    TELEMETRY_PARAMS = 1u << 5,
+    TELEMETRY_ALL = (1u << 6) - 1,
+};
+
+struct TelemetryHello {
+    char magic[8];                  // "PENDTLM1"
+    uint32_t version;
+    uint32_t members;
+    float dt;                       // simulated seconds per published step
+    uint32_t reserved;
+};
+
+// members first, first + stride, ... up to count of them (0: to the end)
+struct TelemetrySubscribe {
+    uint32_t fields;                // TelemetryField bits; 0 pauses the stream
+    uint32_t every;                 // steps that are multiples of this; 0 means 1
+    uint32_t first;
+    uint32_t count;
+    uint32_t stride;                // 0 means 1
+};
+
+struct TelemetryFrame {
+    uint32_t bytes;                 // the whole frame, this header included
+    uint32_t fields;
+    uint64_t step;
+    double time;
+    uint32_t members;
+    uint32_t dropped;               // frames lost to this subscriber since the last one
+};
+
+// Publish copies a step into a private SharedRing and returns; a server
+// thread does everything else. Subscribers are multiplexed with epoll and
+// each one's frames for a batch of steps go out in one gather write, with
+// contiguous subsets sent straight from the staged step. A subscriber that
+// stops reading collects a bounded backlog and then loses frames, which its
+// next frame reports; the physics thread never waits on a socket.
+class TelemetryServer {
+public:
+    // staged steps are capped at about this much, and so is each backlog
+    static const size_t STAGE_BYTES = size_t(16) << 20;
+    static const size_t BACKLOG_BYTES = size_t(8) << 20;
+
+    std::atomic<uint64_t> subscribers{0};   // connected now
+    std::atomic<uint64_t> requests{0};      // TelemetrySubscribe messages handled
+    std::atomic<uint64_t> framesSent{0};
+    std::atomic<uint64_t> framesDropped{0};
+    std::atomic<uint64_t> bytesSent{0};
+    std::atomic<uint64_t> stepsLost{0};     // lapped in the ring before staging
+
+    // called on the server thread when a subscriber connects or leaves
+    void (*onSubscribersChanged)() = nullptr;
+
+    TelemetryServer();
+    ~TelemetryServer();
+    TelemetryServer(const TelemetryServer&) = delete;
+    TelemetryServer& operator=(const TelemetryServer&) = delete;
+
+    // replaces any stale socket file at path
+    bool Start(const char* path, size_t members, float dt);
+    bool IsRunning() const { return thread.joinable(); }
+
+    void Publish(const Ensemble& e, uint64_t step, double time, const PendulumParams& p);
+    void Publish(const PendulumState& s, uint64_t step, double time, const PendulumParams& p);
+
+    // disconnects everyone and removes the socket file
+    void Stop();
+
+private:
+    struct Subscriber {
+        int fd;
+        TelemetrySubscribe filter;
+        uint32_t members;                   // after the subset
+        uint32_t dropped;
+        char inbox[sizeof(TelemetrySubscribe)];
+        size_t inboxBytes;
+        std::vector<char> backlog;          // unsent bytes, oldest first
+        size_t backlogSent;
+        bool writable;                      // watching for EPOLLOUT
+        std::vector<TelemetryFrame> headers;
+        std::vector<float> packed;          // strided subsets
+    };
+
+    // one step copied out of the ring, with energies if anyone wants them
+    struct Staged {
+        uint64_t step;
+        double time;
+        PendulumParams params;
+        float* columns;                     // theta1, theta2, omega1, omega2, energy
+    };
+
+    SharedRing ring;
+    SharedRingReader reader;
+    std::thread thread;
+    std::atomic<bool> stopping;
+    int listenFd;
+    int epollFd;
+    std::string path;
+    size_t members;
+    float dt;
+    uint64_t cursor;                        // next snapshot to stage
+    std::vector<Subscriber*> clients;
+    std::vector<float> stageMemory;
+    std::vector<Staged> staged;
+    size_t stageSteps;
+    std::vector<iovec> iov;                 // one subscriber's batch
+
+    void ServerLoop();
+    void Accept();
+    void Disconnect(Subscriber* s);
+    size_t Stage();
+
+    // false once the subscriber has gone
+    bool Receive(Subscriber* s);
+    bool Send(Subscriber* s, size_t count);
+    bool Flush(Subscriber* s);
+
+    void Queue(Subscriber* s, const iovec* parts, size_t count, size_t skip);
+    void WatchWritable(Subscriber* s, bool writable);
+};
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef TEXTURE_CLASS_H
+#define TEXTURE_CLASS_H
+
+#include <glad/glad.h>
+
+class Texture {
+public:
+    GLuint ID;
+    int width;
+    int height;
+    GLenum format;
+    GLenum type;
+
+    // allocates storage only; pass data to Update() afterwards
+    Texture(int width, int height, GLint internalFormat, GLenum format, GLenum type);
+
+    void Update(const void* data);
+    void Bind(GLuint unit = 0);
+    void Unbind();
+    void Delete();
+};
+
+#endif
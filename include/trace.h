@@ -0,0 +1,56 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+// Scoped-zone tracing that flushes to Chrome trace JSON (chrome://tracing or
+// ui.perfetto.dev). Every thread records into its own buffer without locks.
+//
+// Zones are only compiled in when PENDSIM_TRACE is 1; otherwise the macros
+// expand to nothing and the instrumentation can stay in release builds.
+// Zone and thread names must outlive the trace (string literals).
+
+#ifndef PENDSIM_TRACE
+#define PENDSIM_TRACE 0
+#endif
+
+#if PENDSIM_TRACE
+
+#include <cstdint>
+
+namespace trace {
+
+// nanoseconds since the first call in this process
+uint64_t Now();
+
+void Record(const char* name, uint64_t start, uint64_t end);
+void SetThreadName(const char* name);
+
+// writes every event recorded so far; safe while other threads keep recording.
+// Events dropped for lack of buffer space are counted in otherData and on stderr
+bool Flush(const char* path);
+
+class Zone {
+public:
+    const char* name;
+    uint64_t start;
+
+    Zone(const char* name) : name(name), start(Now()) {}
+    ~Zone() { Record(name, start, Now()); }
+};
+
+}
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_ZONE(name) trace::Zone TRACE_CONCAT(traceZone_, __COUNTER__)(name)
+#define TRACE_THREAD_NAME(name) trace::SetThreadName(name)
+#define TRACE_FLUSH(path) trace::Flush(path)
+
+#else
+
+#define TRACE_ZONE(name) do {} while (0)
+#define TRACE_THREAD_NAME(name) do {} while (0)
+#define TRACE_FLUSH(path) false
+
+#endif
+
+#endif
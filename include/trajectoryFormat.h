@@ -0,0 +1,111 @@
+#ifndef TRAJECTORY_FORMAT_H
+#define TRAJECTORY_FORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "pendulum.h"
+
+// On-disk layout of a trajectory recording, little-endian:
+//
+//   RecordingHeader
+//   chunk*:  ChunkHeader, then TRAJECTORY_COLUMNS encoded columns
+//   index:   ChunkIndexEntry per chunk, then IndexFooter
+//
+// A chunk holds a fixed number of consecutive steps (the last may be
+// short) for every member, and decodes without any other chunk. Columns
+// are theta1, theta2, omega1, omega2; within a column values are step
+// major, members in order. The index is written when a recording is closed;
+// readers rebuild it from the chunk headers if it is missing.
+const int TRAJECTORY_COLUMNS = 4;
+const uint32_t TRAJECTORY_VERSION = 1;
+
+struct RecordingHeader {
+    char magic[8];              // "PENDREC1"
+    uint32_t version;
+    uint32_t members;
+    uint32_t chunkSteps;        // steps per full chunk
+    uint32_t integrator;
+    float dt;
+    PendulumParams params;      // at the start of the recording
+    uint32_t reserved[4];       // pads to 64 bytes so every chunk is 8-byte aligned
+};
+
+struct ChunkHeader {
+    char magic[4];              // "CHNK"
+    uint32_t steps;
+    uint64_t firstStep;
+    uint64_t columnBytes[TRAJECTORY_COLUMNS];
+};
+
+struct ChunkIndexEntry {
+    uint64_t firstStep;
+    uint64_t offset;            // of the ChunkHeader from the start of the file
+};
+
+// last bytes of a closed recording
+struct IndexFooter {
+    uint64_t indexOffset;
+    uint64_t chunks;
+    uint64_t steps;
+    char magic[8];              // "PENDIDX1"
+};
+
+// Gorilla-style coding of float bit patterns, one series per member. Each
+// value's bit pattern is predicted by polynomial extrapolation of the
+// member's previous patterns (constant, linear, quadratic, then cubic as
+// the chunk provides history), and the zigzagged difference is stored with
+// as few bits as it needs, reusing the previous run's width when close:
+//
+//   0                                   value equals the prediction
+//   10 <bits in previous width>
+//   11 <5: width - 1> <width bits>
+//
+// Plain XOR with the previous value leaves ~20 of 32 bits on smooth
+// trajectories; the extrapolated delta needs ~16 at a 5 ms step and ~7 at
+// 1 ms. Everything is integer arithmetic so every build decodes every file
+// bit for bit.
+struct SeriesState {
+    uint32_t prev[4];           // most recent first
+    uint8_t width;              // 0 until a width has been sent
+};
+
+class ColumnEncoder {
+public:
+    std::vector<uint64_t> words;   // MSB-first bit stream
+    uint64_t acc;
+    int bits;
+    std::vector<SeriesState> series;
+
+    // starts a new chunk for members series
+    void Begin(size_t members);
+
+    // one step of every member; step counts from the start of the chunk
+    void Encode(const float* values, int step);
+
+    // pads to a whole word; returns the encoded size in bytes
+    size_t Finish();
+
+private:
+    void Put(uint64_t value, int n);
+};
+
+class ColumnDecoder {
+public:
+    const uint64_t* words;
+    size_t wordCount;
+    size_t next;
+    uint64_t current;
+    int available;
+    bool overrun;                  // read past the end: corrupt data
+    std::vector<SeriesState> series;
+
+    void Begin(const void* data, size_t bytes, size_t members);
+    void Decode(float* values, int step);
+
+private:
+    uint32_t Get(int n);
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef TRAJECTORY_READER_CLASS_H
+#define TRAJECTORY_READER_CLASS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "trajectoryFormat.h"
+
+// Random access into a recording (see trajectoryFormat.h) through a
+// read-only memory map. Opening touches only the header and the index
+// footer, so it costs the same for any file size. A read decodes just the
+// chunk holding the requested step and keeps it until a step outside it is
+// asked for; resident memory is that one chunk plus whatever pages the
+// kernel chooses to cache, which madvise hints keep in check. Nothing in the
+// file is trusted: Open rejects an index that doesn't fit the file, and a
+// chunk whose header doesn't fit its slot fails to read.
+class TrajectoryReader {
+public:
+    enum class Access {
+        Sequential,   // playback: read ahead, drop chunks left behind
+        Random,       // scrubbing: no read-ahead
+    };
+
+    RecordingHeader header;
+    uint64_t steps;
+    std::vector<ChunkIndexEntry> index;
+    bool indexed;                       // false if rebuilt from chunk headers
+
+    TrajectoryReader();
+    ~TrajectoryReader();
+    TrajectoryReader(const TrajectoryReader&) = delete;
+    TrajectoryReader& operator=(const TrajectoryReader&) = delete;
+
+    // false if the file is missing, not a recording, or its index is corrupt
+    bool Open(const char* path);
+    void Close();
+    bool IsOpen() const { return data != nullptr; }
+
+    void Advise(Access access);
+
+    // one member at one step; false if out of range or the chunk is corrupt
+    bool Read(uint64_t step, size_t member, PendulumState& s);
+
+    // every member at one step, into four columns of header.members
+    bool ReadStep(uint64_t step, float* theta1, float* theta2, float* omega1, float* omega2);
+
+    double Time(uint64_t step) const { return step * double(header.dt); }
+
+private:
+    const unsigned char* data;
+    size_t size;
+    uint64_t chunksEnd;                 // where chunk data stops: the index, or the last whole chunk
+    Access access;
+
+    // the decoded chunk: columns of steps * members, step major
+    size_t cachedChunk;
+    std::vector<float> decoded[TRAJECTORY_COLUMNS];
+
+    bool BuildIndex();
+    size_t FindChunk(uint64_t step) const;
+    bool Load(size_t chunk);
+    void AdviseRange(uint64_t begin, uint64_t end, int advice);
+    uint64_t ChunkEnd(size_t chunk) const;
+};
+
+#endif
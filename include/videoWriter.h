@@ -0,0 +1,70 @@
+#ifndef VIDEO_WRITER_CLASS_H
+#define VIDEO_WRITER_CLASS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+// RGBA8 to planar YUV 4:2:0, BT.601 limited range, each chroma sample the
+// average of a 2x2 block. Rows of rgba are stride bytes apart; pass the last
+// row and a negative stride for bottom-up images like glReadPixels returns.
+// width and height must be even.
+void RgbaToYuv420(const uint8_t* rgba, ptrdiff_t stride, int width, int height, uint8_t* y, uint8_t* u, uint8_t* v);
+
+// Streams frames to a YUV4MPEG2 (.y4m) file, which ffmpeg and most players
+// read directly. Push copies one RGBA frame into a single-producer
+// single-consumer ring; a writer thread converts it to YUV 4:2:0 and writes
+// it, so the render loop only pays for a memcpy.
+class VideoWriter {
+public:
+    static const size_t QUEUE_FRAMES = 8;
+
+    std::atomic<uint64_t> offered{0};       // frames pushed
+    std::atomic<uint64_t> written{0};       // frames written by the writer thread
+    std::atomic<uint64_t> dropped{0};       // pushed while the ring was full
+    std::atomic<uint64_t> stalls{0};        // pushes that had to wait
+    std::atomic<uint64_t> fileBytes{0};
+    std::atomic<bool> failed{false};
+
+    int width;
+    int height;
+    int fps;
+
+    VideoWriter();
+    ~VideoWriter();
+    VideoWriter(const VideoWriter&) = delete;
+    VideoWriter& operator=(const VideoWriter&) = delete;
+
+    // width and height must be even
+    bool Open(const char* path, int width, int height, int fps, size_t queueFrames = QUEUE_FRAMES);
+    bool IsOpen() const { return file != nullptr; }
+
+    // the next frame, width * height RGBA pixels with rows stride bytes
+    // apart; call from one thread. With the ring full, waits for the writer
+    // if wait is set, otherwise drops the frame and returns false
+    bool Push(const uint8_t* rgba, ptrdiff_t stride, bool wait);
+
+    // drains the ring, then waits for the writer; false if a write failed
+    bool Close();
+
+private:
+    FILE* file;
+    size_t slots;
+    size_t frameBytes;                      // width * height * 4
+    std::vector<uint8_t> ring;              // slots * frameBytes, top row first
+    std::vector<uint8_t> planes;            // one converted frame: Y, U, V
+    std::thread writer;
+    std::atomic<bool> closing{false};
+
+    // head is written only by Push, tail only by the writer
+    alignas(64) std::atomic<uint64_t> head{0};
+    alignas(64) std::atomic<uint64_t> tail{0};
+
+    void WriterLoop();
+    void WriteFrame(const uint8_t* rgba);
+};
+
+#endif
@@ -0,0 +1,11 @@
+#version 330 core
+in vec2 uv;
+out vec4 FragColor;
+
+uniform sampler2D previous;
+uniform float decay;
+
+void main()
+{
+    FragColor = texture(previous, uv) * decay;
+}
@@ -0,0 +1,17 @@
+#version 330 core
+in vec2 uv;
+out vec4 FragColor;
+
+uniform sampler2D density;
+uniform float exposure;
+uniform float peak;
+
+void main()
+{
+    // logarithmic tone mapping so sparse regions stay visible next to hot spots
+    float d = texture(density, uv).r;
+    float v = log(1.0 + exposure * d) / log(1.0 + exposure * max(peak, 1e-6));
+    vec3 color = mix(vec3(0.07, 0.13, 0.17), vec3(1.0, 0.62, 0.2), clamp(v, 0.0, 1.0));
+    color = mix(color, vec3(1.0), clamp(v * v * v, 0.0, 1.0));
+    FragColor = vec4(color, 1.0);
+}
@@ -0,0 +1,11 @@
+#version 330 core
+in vec2 uv;
+out vec4 FragColor;
+
+uniform sampler2D trail;
+
+void main()
+{
+    float v = texture(trail, uv).r;
+    FragColor = vec4(vec3(0.35, 0.75, 1.0) * v, 1.0);
+}
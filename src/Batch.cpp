@@ -0,0 +1,485 @@
+#include <batch.h>
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include <unistd.h>
+
+#include "checkpoint.h"
+#include "exporter.h"
+#include "journal.h"
+#include "recorder.h"
+#include "sharedRing.h"
+#include "telemetry.h"
+#include "trace.h"
+
+static const float DEGREES = float(M_PI) / 180.0f;
+
+bool IsBatchRun(int argc, char** argv) {
+    return argc > 1 && strcmp(argv[1], "--batch") == 0;
+}
+
+void BatchUsage(FILE* out) {
+    fprintf(out, "usage: pendsim --batch [--duration S] [--dt S] [--integrator euler|semi-implicit|midpoint|rk4]\n"
+                 "                       [--kernel scalar|simd] [--threads N] [--members N] [--spread DEG]\n"
+                 "                       [--angle1 DEG] [--angle2 DEG] [--omega1 RAD/S] [--omega2 RAD/S]\n"
+                 "                       [--rod1 M] [--rod2 M] [--mass1 KG] [--mass2 KG] [--gravity M/S2]\n"
+                 "                       [--output PATH.pendrec|.csv|.ndjson|PATH] [--every N] [--quiet]\n"
+                 "                       [--share /SHM-NAME] [--telemetry SOCKET-PATH]\n"
+                 "                       [--checkpoint PATH [--checkpoint-every S]] [--resume PATH]\n"
+                 "       pendsim --batch --scenario PATH [--threads N] [--output PATH] [--quiet]\n"
+                 "                       [--checkpoint PATH [--checkpoint-every S]] [--resume PATH]\n"
+                 "       pendsim --batch --replay JOURNAL [--output PATH.pendrec|.csv|.ndjson|PATH] [--quiet]\n");
+}
+
+static bool EndsWith(const char* s, const char* suffix) {
+    size_t n = strlen(s), m = strlen(suffix);
+    return n >= m && strcmp(s + n - m, suffix) == 0;
+}
+
+static bool IsStreamingOutput(const char* path) {
+    return path && (EndsWith(path, ".pendrec") || EndsWith(path, ".csv") || EndsWith(path, ".ndjson"));
+}
+
+// a whole number of members, which may be written 1e6; negative, fractional
+// or too many for an ensemble's columns to be addressed is refused
+static bool ParseMembers(const char* value, size_t& members) {
+    const char* end = value + strlen(value);
+    if (*value == '+') value++;
+    double v;
+    auto result = std::from_chars(value, end, v);
+    const double most = double(SIZE_MAX / (4 * sizeof(float)) - Ensemble::BLOCK);
+    if (result.ec != std::errc() || result.ptr != end || !(v >= 1.0 && v <= most) || v != std::floor(v)) return false;
+    members = size_t(v);
+    return true;
+}
+
+// false if arg isn't a checkpoint flag or its value is bad
+static bool ParseCheckpointArg(const char* arg, const char* value, CheckpointOptions& options) {
+    if (strcmp(arg, "--checkpoint") == 0) options.path = value;
+    else if (strcmp(arg, "--resume") == 0) options.resume = value;
+    else if (strcmp(arg, "--checkpoint-every") == 0) options.every = atof(value);
+    else return false;
+    return options.every > 0.0;
+}
+
+// steps between checkpoints, or 0 for none
+static uint64_t CheckpointInterval(const CheckpointOptions& options, float dt) {
+    if (!options.path) return 0;
+    return std::max<uint64_t>(1, uint64_t(std::llround(options.every / dt)));
+}
+
+bool ParseBatchArgs(int argc, char** argv, BatchOptions& options) {
+    for (int i = 2; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+        if (strcmp(arg, "--quiet") == 0) { options.quiet = true; continue; }
+        if (!value) return false;
+
+        if (strcmp(arg, "--duration") == 0) options.duration = atof(value);
+        else if (strcmp(arg, "--dt") == 0) options.dt = float(atof(value));
+        else if (strcmp(arg, "--threads") == 0) options.threads = atoi(value);
+        else if (strcmp(arg, "--spread") == 0) options.spread = float(atof(value)) * DEGREES;
+        else if (strcmp(arg, "--angle1") == 0) options.initial.theta1 = float(atof(value)) * DEGREES;
+        else if (strcmp(arg, "--angle2") == 0) options.initial.theta2 = float(atof(value)) * DEGREES;
+        else if (strcmp(arg, "--omega1") == 0) options.initial.omega1 = float(atof(value));
+        else if (strcmp(arg, "--omega2") == 0) options.initial.omega2 = float(atof(value));
+        else if (strcmp(arg, "--rod1") == 0) options.params.rodLength = float(atof(value));
+        else if (strcmp(arg, "--rod2") == 0) options.params.rodLength2 = float(atof(value));
+        else if (strcmp(arg, "--mass1") == 0) options.params.mass = float(atof(value));
+        else if (strcmp(arg, "--mass2") == 0) options.params.mass2 = float(atof(value));
+        else if (strcmp(arg, "--gravity") == 0) options.params.gravity = float(atof(value));
+        else if (strcmp(arg, "--output") == 0) options.output = value;
+        else if (strcmp(arg, "--every") == 0) options.every = atoi(value);
+        else if (strcmp(arg, "--share") == 0) options.share = value;
+        else if (strcmp(arg, "--telemetry") == 0) options.telemetry = value;
+        else if (ParseCheckpointArg(arg, value, options.checkpoints)) {}
+        else if (strcmp(arg, "--members") == 0) {
+            if (!ParseMembers(value, options.members)) return false;
+        }
+        else if (strcmp(arg, "--integrator") == 0) {
+            if (!ParseIntegrator(value, options.integrator)) return false;
+        }
+        else if (strcmp(arg, "--kernel") == 0) {
+            if (strcmp(value, KernelName(Kernel::Scalar)) == 0) options.kernel = Kernel::Scalar;
+            else if (strcmp(value, KernelName(Kernel::Simd)) == 0) options.kernel = Kernel::Simd;
+            else return false;
+        }
+        else return false;
+        i++;
+    }
+    // a recording or text stream can't be rewound to a checkpoint
+    bool checkpointed = options.checkpoints.path || options.checkpoints.resume;
+    if (checkpointed && IsStreamingOutput(options.output)) return false;
+
+    const PendulumParams& p = options.params;
+    return options.dt > 0.0f && options.duration >= 0.0 && options.threads >= 1 && options.members >= 1 &&
+           options.every >= 1 && options.checkpoints.every > 0.0 && p.rodLength > 0.0f && p.rodLength2 > 0.0f && p.mass > 0.0f && p.mass2 > 0.0f;
+}
+
+static bool WriteFinalStates(const char* path, const Ensemble& e, const PendulumParams& p) {
+    FILE* out = fopen(path, "w");
+    if (!out) return false;
+    fprintf(out, "member,theta1,theta2,omega1,omega2,energy\n");
+    for (size_t m = 0; m < e.size; m++) {
+        PendulumState s = e.Get(m);
+        fprintf(out, "%zu,%.9g,%.9g,%.9g,%.9g,%.9g\n", m, s.theta1, s.theta2, s.omega1, s.omega2, Energy(s, p));
+    }
+    return fclose(out) == 0;
+}
+
+int RunBatch(const BatchOptions& options) {
+    TRACE_ZONE("Batch run");
+    auto start = std::chrono::steady_clock::now();
+
+    const CheckpointOptions& checkpoints = options.checkpoints;
+    CheckpointState state;
+    state.dt = options.dt;
+    state.integrator = options.integrator;
+    state.params = options.params;
+
+    Ensemble e(checkpoints.resume ? 1 : options.members);
+    if (checkpoints.resume) {
+        if (!LoadCheckpoint(checkpoints.resume, e, state)) {
+            fprintf(stderr, "could not resume from %s\n", checkpoints.resume);
+            return 1;
+        }
+    } else {
+        PendulumState s = options.initial;
+        for (size_t m = 0; m < options.members; m++) {
+            float offset = options.members > 1 ? float(m) / float(options.members - 1) - 0.5f : 0.0f;
+            s.theta1 = options.initial.theta1 + offset * options.spread;
+            e.Set(m, s);
+        }
+    }
+    const PendulumParams& params = state.params;
+    float dt = state.dt;
+
+    double startEnergy = 0.0;
+    for (size_t m = 0; m < e.size; m++) startEnergy += Energy(e.Get(m), params);
+
+    // outputs are taken every `every` steps, so that is their step
+    bool record = options.output && EndsWith(options.output, ".pendrec");
+    bool csv = options.output && EndsWith(options.output, ".csv");
+    bool ndjson = options.output && EndsWith(options.output, ".ndjson");
+    float outputDt = dt * options.every;
+    Recorder recorder;
+    Exporter exporter;
+    if (record && !recorder.Open(options.output, e.size, outputDt, params, state.integrator)) {
+        fprintf(stderr, "could not open %s\n", options.output);
+        return 1;
+    }
+    if ((csv || ndjson) && !exporter.Open(options.output, e.size, outputDt,
+                                          csv ? Exporter::Format::Csv : Exporter::Format::Ndjson,
+                                          Exporter::Backpressure::Block)) {
+        fprintf(stderr, "could not open %s\n", options.output);
+        return 1;
+    }
+    SharedRing ring;
+    if (options.share && !ring.Create(options.share, e.size, 0, outputDt)) {
+        fprintf(stderr, "could not create shared memory %s\n", options.share);
+        return 1;
+    }
+    TelemetryServer telemetry;
+    if (options.telemetry && !telemetry.Start(options.telemetry, e.size, outputDt)) {
+        fprintf(stderr, "could not listen on %s\n", options.telemetry);
+        return 1;
+    }
+    bool streaming = record || csv || ndjson || ring.IsOpen() || telemetry.IsRunning();
+
+    AdvanceOptions advance;
+    advance.integrator = state.integrator;
+    advance.kernel = options.kernel;
+    advance.threads = options.threads;
+
+    uint64_t steps = uint64_t(std::llround(options.duration / dt));
+    uint64_t interval = CheckpointInterval(checkpoints, dt);
+    auto physicsStart = std::chrono::steady_clock::now();
+    for (uint64_t done = state.step; done < steps; ) {
+        // without streaming output, one call keeps every thread busy throughout
+        uint64_t n = streaming ? std::min<uint64_t>(options.every, steps - done) : steps - done;
+        if (interval) n = std::min(n, interval - done % interval);
+        n = std::min<uint64_t>(n, uint64_t(1) << 30);
+        Advance(e, params, dt, int(n), advance);
+        done += n;
+        if (record) recorder.Record(e);
+        if (csv || ndjson) exporter.Push(e);
+        if (ring.IsOpen()) ring.Publish(e, done, done * double(dt), params);
+        telemetry.Publish(e, done, done * double(dt), params);
+
+        if (interval && done % interval == 0 && done < steps) {
+            state.step = done;
+            state.time = done * double(dt);
+            if (!SaveCheckpoint(checkpoints.path, e, state)) fprintf(stderr, "checkpoint to %s failed\n", checkpoints.path);
+        }
+    }
+    double physicsSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - physicsStart).count();
+
+    bool ok = true;
+    if (record && !recorder.Close()) ok = false;
+    if ((csv || ndjson) && !exporter.Close()) ok = false;
+    if (options.output && !streaming && !WriteFinalStates(options.output, e, params)) ok = false;
+    if (!ok) fprintf(stderr, "writing %s failed\n", options.output);
+
+    if (!options.quiet) {
+        double endEnergy = 0.0;
+        for (size_t m = 0; m < e.size; m++) endEnergy += Energy(e.Get(m), params);
+        double total = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        fprintf(stderr, "%llu steps x %zu members (%s, %s, %d threads): %.3f s physics, %.3f s total, %.3g member-steps/s\n",
+                (unsigned long long)steps, e.size, IntegratorName(state.integrator), KernelName(options.kernel),
+                options.threads, physicsSeconds, total, double(steps) * e.size / std::max(physicsSeconds, 1e-9));
+        fprintf(stderr, "mean energy %.6g -> %.6g J\n", startEnergy / e.size, endEnergy / e.size);
+    }
+    return ok ? 0 : 1;
+}
+
+static bool FinalStatesHeader(FILE* out, const Scenario& scenario) {
+    fprintf(out, "run,member");
+    for (int i = 0; i < Scenario::PARAMS; i++) {
+        if (scenario.params[i].count > 1) fprintf(out, ",%s", Scenario::ParamName(i));
+    }
+    for (int i = 0; i < Scenario::STATE_VARS; i++) fprintf(out, ",%s_0", Scenario::StateName(i));
+    return fprintf(out, ",theta1,theta2,omega1,omega2,energy\n") > 0;
+}
+
+int RunScenario(const Scenario& scenario, bool quiet, const CheckpointOptions& checkpoints) {
+    TRACE_ZONE("Scenario run");
+    auto start = std::chrono::steady_clock::now();
+
+    // one ensemble for the whole scenario; members are generated per batch
+    uint64_t members = scenario.Members();
+    size_t batch = size_t(std::min<uint64_t>(members, scenario.batch));
+    Ensemble e(batch);
+
+    // a checkpoint holds the batch in flight and how far the output got
+    CheckpointState resume;
+    bool resuming = checkpoints.resume != nullptr;
+    if (resuming) {
+        bool ok = LoadCheckpoint(checkpoints.resume, e, resume);
+        if (!ok || e.size != batch || resume.seed != scenario.seed || resume.dt != scenario.dt ||
+            resume.run >= scenario.Runs() || resume.firstMember >= members) {
+            fprintf(stderr, "%s is not a checkpoint of this scenario\n", checkpoints.resume);
+            return 1;
+        }
+    }
+
+    FILE* out = nullptr;
+    if (scenario.output[0]) {
+        if (resuming && truncate(scenario.output, off_t(resume.outputBytes)) != 0) {
+            fprintf(stderr, "could not rewind %s\n", scenario.output);
+            return 1;
+        }
+        out = fopen(scenario.output, resuming ? "a" : "w");
+        if (!out) {
+            fprintf(stderr, "could not open %s\n", scenario.output);
+            return 1;
+        }
+        setvbuf(out, nullptr, _IOFBF, size_t(1) << 20);
+        if (!resuming) FinalStatesHeader(out, scenario);
+    }
+
+    AdvanceOptions advance;
+    advance.integrator = scenario.integrator;
+    advance.kernel = scenario.kernel;
+    advance.threads = scenario.threads;
+
+    uint64_t steps = uint64_t(std::llround(scenario.duration / scenario.dt));
+    uint64_t interval = CheckpointInterval(checkpoints, scenario.dt);
+    // steps simulated since the last checkpoint, across batches and runs, so
+    // scenarios shorter than the interval still checkpoint between batches
+    uint64_t pending = 0;
+    auto checkpoint = [&](uint64_t run, uint64_t first, uint64_t step) {
+        CheckpointState state;
+        state.step = step;
+        state.time = step * double(scenario.dt);
+        state.dt = scenario.dt;
+        state.integrator = scenario.integrator;
+        state.params = scenario.Params(run);
+        state.run = run;
+        state.firstMember = first;
+        state.seed = scenario.seed;
+        if (out) {
+            fflush(out);
+            state.outputBytes = uint64_t(ftell(out));
+        }
+        if (!SaveCheckpoint(checkpoints.path, e, state)) {
+            fprintf(stderr, "checkpoint to %s failed\n", checkpoints.path);
+        }
+        pending = 0;
+    };
+
+    for (uint64_t run = resuming ? resume.run : 0; run < scenario.Runs(); run++) {
+        PendulumParams p = scenario.Params(run);
+        uint64_t firstBatch = resuming && run == resume.run ? resume.firstMember : 0;
+        for (uint64_t first = firstBatch; first < members; first += e.size) {
+            size_t count = size_t(std::min<uint64_t>(e.size, members - first));
+            uint64_t done = 0;
+            // a checkpoint between batches (step 0) holds no batch in flight
+            if (resuming && resume.step > 0) done = resume.step;
+            else scenario.Fill(e, first, count);
+            resuming = false;
+
+            while (done < steps) {
+                uint64_t n = std::min<uint64_t>(steps - done, uint64_t(1) << 30);
+                if (interval) n = std::min(n, interval - pending);
+                Advance(e, p, scenario.dt, int(n), advance);
+                done += n;
+                pending += n;
+                if (interval && pending == interval && done < steps) checkpoint(run, first, done);
+            }
+
+            if (out) {
+                float swept[Scenario::PARAMS] = { p.rodLength, p.rodLength2, p.mass, p.mass2, p.gravity };
+                for (size_t m = 0; m < count; m++) {
+                    PendulumState s0 = scenario.Member(first + m), s = e.Get(m);
+                    fprintf(out, "%llu,%llu", (unsigned long long)run, (unsigned long long)(first + m));
+                    for (int i = 0; i < Scenario::PARAMS; i++) {
+                        if (scenario.params[i].count > 1) fprintf(out, ",%.9g", swept[i]);
+                    }
+                    fprintf(out, ",%.9g,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g\n", s0.theta1, s0.theta2, s0.omega1, s0.omega2,
+                            s.theta1, s.theta2, s.omega1, s.omega2, Energy(s, p));
+                }
+            }
+
+            // due at the end of a batch: checkpoint at the start of the next one
+            if (interval && pending == interval) {
+                if (first + e.size < members) checkpoint(run, first + e.size, 0);
+                else if (run + 1 < scenario.Runs()) checkpoint(run + 1, 0, 0);
+            }
+        }
+    }
+
+    bool ok = !out || fclose(out) == 0;
+    if (!ok) fprintf(stderr, "writing %s failed\n", scenario.output);
+    if (!quiet) {
+        double total = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        fprintf(stderr, "%llu runs x %llu members x %llu steps (%s, %d threads): %.3f s\n",
+                (unsigned long long)scenario.Runs(), (unsigned long long)members, (unsigned long long)steps,
+                IntegratorName(scenario.integrator), scenario.threads, total);
+    }
+    return ok ? 0 : 1;
+}
+
+// pendsim --batch --scenario PATH [--threads N] [--output PATH] [--quiet] [checkpoint flags]
+static int ScenarioMain(int argc, char** argv) {
+    Scenario scenario;
+    char error[256];
+    if (!scenario.Load(argv[3], error, sizeof(error))) {
+        fprintf(stderr, "%s: %s\n", argv[3], error);
+        return 2;
+    }
+
+    bool quiet = false;
+    CheckpointOptions checkpoints;
+    for (int i = 4; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (strcmp(arg, "--quiet") == 0) { quiet = true; continue; }
+
+        bool ok = value != nullptr;
+        if (ok && strcmp(arg, "--threads") == 0) {
+            scenario.threads = atoi(value);
+            ok = scenario.threads >= 1;
+        } else if (ok && strcmp(arg, "--output") == 0) {
+            ok = strlen(value) < size_t(Scenario::MAX_PATH);
+            if (ok) strcpy(scenario.output, value);
+        } else {
+            ok = ok && ParseCheckpointArg(arg, value, checkpoints);
+        }
+        if (!ok) {
+            BatchUsage(stderr);
+            return 2;
+        }
+        i++;
+    }
+    return RunScenario(scenario, quiet, checkpoints);
+}
+
+int RunReplay(const char* path, const char* output, bool quiet) {
+    TRACE_ZONE("Journal replay");
+    auto start = std::chrono::steady_clock::now();
+    JournalReplay replay;
+    if (!replay.Open(path)) {
+        fprintf(stderr, "could not read journal %s\n", path);
+        return 1;
+    }
+
+    // one member; the recording keeps the parameters the session started with
+    Ensemble e(1);
+    e.Set(0, replay.inputs.state);
+    bool record = output && EndsWith(output, ".pendrec");
+    bool csv = output && EndsWith(output, ".csv");
+    bool ndjson = output && EndsWith(output, ".ndjson");
+    Recorder recorder;
+    Exporter exporter;
+    if (record && !recorder.Open(output, 1, replay.inputs.dt, replay.inputs.params, Integrator::SemiImplicitEuler)) {
+        fprintf(stderr, "could not open %s\n", output);
+        return 1;
+    }
+    if ((csv || ndjson) && !exporter.Open(output, 1, replay.inputs.dt,
+                                          csv ? Exporter::Format::Csv : Exporter::Format::Ndjson,
+                                          Exporter::Backpressure::Block)) {
+        fprintf(stderr, "could not open %s\n", output);
+        return 1;
+    }
+
+    while (replay.Step()) {
+        if (record) recorder.Record(replay.inputs.state);
+        if (csv || ndjson) exporter.Push(replay.inputs.state);
+    }
+    e.Set(0, replay.inputs.state);
+
+    bool ok = true;
+    if (record && !recorder.Close()) ok = false;
+    if ((csv || ndjson) && !exporter.Close()) ok = false;
+    if (output && !record && !csv && !ndjson && !WriteFinalStates(output, e, replay.inputs.params)) ok = false;
+    if (!ok) fprintf(stderr, "writing %s failed\n", output);
+
+    if (!replay.ended) {
+        fprintf(stderr, "%s has no end record (the session didn't exit cleanly): replayed to the last event, unverified\n", path);
+    } else if (!replay.Verified()) {
+        fprintf(stderr, "replay of %s diverged from the recorded session\n", path);
+        ok = false;
+    }
+    if (!quiet) {
+        double total = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        fprintf(stderr, "%llu steps: %.3f s%s\n", (unsigned long long)replay.step, total,
+                replay.Verified() ? ", trajectory matches the session" : "");
+    }
+    return ok ? 0 : 1;
+}
+
+// pendsim --batch --replay JOURNAL [--output PATH] [--quiet]
+static int ReplayMain(int argc, char** argv) {
+    const char* output = nullptr;
+    bool quiet = false;
+    for (int i = 4; i < argc; i++) {
+        if (strcmp(argv[i], "--quiet") == 0) {
+            quiet = true;
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else {
+            BatchUsage(stderr);
+            return 2;
+        }
+    }
+    return RunReplay(argv[3], output, quiet);
+}
+
+int BatchMain(int argc, char** argv) {
+    if (argc > 3 && strcmp(argv[2], "--scenario") == 0) return ScenarioMain(argc, argv);
+    if (argc > 3 && strcmp(argv[2], "--replay") == 0) return ReplayMain(argc, argv);
+
+    BatchOptions options;
+    if (!ParseBatchArgs(argc, argv, options)) {
+        BatchUsage(stderr);
+        return 2;
+    }
+    return RunBatch(options);
+}
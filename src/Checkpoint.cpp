@@ -0,0 +1,175 @@
+#include <checkpoint.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+static_assert(sizeof(CheckpointHeader) <= CHECKPOINT_PAGE, "header must fit its page");
+
+static uint64_t PageRound(uint64_t bytes) {
+    return (bytes + CHECKPOINT_PAGE - 1) / CHECKPOINT_PAGE * CHECKPOINT_PAGE;
+}
+
+// writev may stop short (large files, signals); carry on where it stopped
+static bool WriteAll(int fd, iovec* iov, int count) {
+    while (count > 0) {
+        ssize_t written = writev(fd, iov, count);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        size_t left = size_t(written);
+        while (count > 0 && left >= iov->iov_len) {
+            left -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + left;
+            iov->iov_len -= left;
+        }
+    }
+    return true;
+}
+
+// the rename is durable only once the directory itself is synced
+static void SyncDirectory(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    std::string dir = slash == std::string::npos ? "." : path.substr(0, std::max<size_t>(slash, 1));
+    int fd = open(dir.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    fsync(fd);
+    close(fd);
+}
+
+bool SaveCheckpoint(const char* path, const Ensemble& e, const CheckpointState& state, const DensityMap* density) {
+    TRACE_ZONE("Save checkpoint");
+    static const char zeros[CHECKPOINT_PAGE] = {};
+    std::vector<char> page(CHECKPOINT_PAGE, 0);
+
+    CheckpointHeader header = {};
+    memcpy(header.magic, "PENDCKP1", 8);
+    header.version = CHECKPOINT_VERSION;
+    header.integrator = uint32_t(state.integrator);
+    header.step = state.step;
+    header.time = state.time;
+    header.dt = state.dt;
+    header.params = state.params;
+    header.run = state.run;
+    header.firstMember = state.firstMember;
+    header.seed = state.seed;
+    header.outputBytes = state.outputBytes;
+    header.members = e.size;
+    header.capacity = e.capacity;
+    header.columnsOffset = CHECKPOINT_PAGE;
+    header.columnsBytes = 4 * e.capacity * sizeof(float);
+    uint64_t columnsEnd = header.columnsOffset + PageRound(header.columnsBytes);
+    if (density) {
+        header.densityWidth = uint32_t(density->width);
+        header.densityHeight = uint32_t(density->height);
+        header.densityPeak = density->peak;
+        header.densitySamples = density->samples;
+        header.densityOffset = columnsEnd;
+        header.densityBytes = density->bins.size() * sizeof(float);
+    }
+    memcpy(page.data(), &header, sizeof(header));
+
+    // the columns are one contiguous block in every Ensemble
+    iovec iov[5];
+    int count = 0;
+    iov[count++] = { page.data(), CHECKPOINT_PAGE };
+    iov[count++] = { e.theta1, header.columnsBytes };
+    iov[count++] = { const_cast<char*>(zeros), PageRound(header.columnsBytes) - header.columnsBytes };
+    if (density) {
+        iov[count++] = { const_cast<float*>(density->bins.data()), header.densityBytes };
+        iov[count++] = { const_cast<char*>(zeros), PageRound(header.densityBytes) - header.densityBytes };
+    }
+
+    std::string temp = std::string(path) + ".tmp";
+    int fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+    bool ok = WriteAll(fd, iov, count) && fsync(fd) == 0;
+    ok &= close(fd) == 0;
+    if (ok) ok = rename(temp.c_str(), path) == 0;
+    if (ok) SyncDirectory(path);
+    else unlink(temp.c_str());
+    return ok;
+}
+
+bool LoadCheckpoint(const char* path, Ensemble& e, CheckpointState& state, DensityMap* density) {
+    TRACE_ZONE("Load checkpoint");
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    CheckpointHeader header;
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0 && pread(fd, &header, sizeof(header), 0) == ssize_t(sizeof(header));
+    ok = ok && memcmp(header.magic, "PENDCKP1", 8) == 0 && header.version == CHECKPOINT_VERSION &&
+         header.integrator < uint32_t(INTEGRATOR_COUNT);
+    ok = ok && header.members > 0 && header.capacity >= header.members && header.capacity % Ensemble::BLOCK == 0;
+    uint64_t size = ok ? uint64_t(st.st_size) : 0;
+    ok = ok && header.capacity <= size && header.columnsBytes == 4 * header.capacity * sizeof(float);
+    ok = ok && header.columnsOffset >= sizeof(header) && header.columnsOffset <= size &&
+         header.columnsBytes <= size - header.columnsOffset;
+    // the density section is exactly width * height floats, or absent
+    ok = ok && header.densityBytes == uint64_t(header.densityWidth) * header.densityHeight * sizeof(float);
+    ok = ok && (header.densityBytes == 0 || (header.densityOffset <= size && header.densityBytes <= size - header.densityOffset));
+    if (!ok) {
+        close(fd);
+        return false;
+    }
+
+    // private and writable: the run carries on in the mapped pages, and the
+    // file stays as it was until the next save replaces it. mmap offsets
+    // must be page aligned, which a file from a host with smaller pages (or
+    // a host with pages over CHECKPOINT_PAGE) may not be: read those
+    void* columns;
+    if (header.columnsOffset % uint64_t(sysconf(_SC_PAGESIZE)) == 0) {
+        columns = mmap(nullptr, header.columnsBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, off_t(header.columnsOffset));
+    } else {
+        columns = mmap(nullptr, header.columnsBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (columns != MAP_FAILED &&
+            pread(fd, columns, header.columnsBytes, off_t(header.columnsOffset)) != ssize_t(header.columnsBytes)) {
+            munmap(columns, header.columnsBytes);
+            columns = MAP_FAILED;
+        }
+    }
+    if (columns == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+
+    if (density && header.densityBytes && uint32_t(density->width) == header.densityWidth &&
+        uint32_t(density->height) == header.densityHeight && header.densityBytes <= density->bins.size() * sizeof(float)) {
+        ok = pread(fd, density->bins.data(), header.densityBytes, off_t(header.densityOffset)) == ssize_t(header.densityBytes);
+        density->peak = header.densityPeak;
+        density->samples = header.densitySamples;
+    }
+    close(fd);
+    if (!ok) {
+        munmap(columns, header.columnsBytes);
+        return false;
+    }
+
+    e.Adopt(size_t(header.members), size_t(header.capacity), columns, size_t(header.columnsBytes));
+    state.step = header.step;
+    state.time = header.time;
+    state.dt = header.dt;
+    state.integrator = Integrator(header.integrator);
+    state.params = header.params;
+    state.run = header.run;
+    state.firstMember = header.firstMember;
+    state.seed = header.seed;
+    state.outputBytes = header.outputBytes;
+    return true;
+}
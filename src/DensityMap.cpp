@@ -0,0 +1,46 @@
+#include <densityMap.h>
+
+#include <algorithm>
+#include <cmath>
+
+DensityMap::DensityMap(int width, int height)
+    : width(width), height(height), bins(size_t(width) * height, 0.0f), peak(0.0f), samples(0) {}
+
+void DensityMap::Splat(const float* xy, size_t count) {
+    float localPeak = peak;
+
+    for (size_t i = 0; i < count; ++i) {
+        // NDC -> texel space, centred on texel centres
+        float gx = (xy[2 * i] * 0.5f + 0.5f) * width - 0.5f;
+        float gy = (xy[2 * i + 1] * 0.5f + 0.5f) * height - 0.5f;
+
+        float fx = std::floor(gx);
+        float fy = std::floor(gy);
+        int x0 = int(fx);
+        int y0 = int(fy);
+
+        // skip anything that would touch outside the grid
+        if (x0 < 0 || y0 < 0 || x0 + 1 >= width || y0 + 1 >= height) continue;
+
+        float tx = gx - fx;
+        float ty = gy - fy;
+
+        float* row0 = &bins[size_t(y0) * width + x0];
+        float* row1 = row0 + width;
+        row0[0] += (1.0f - tx) * (1.0f - ty);
+        row0[1] += tx * (1.0f - ty);
+        row1[0] += (1.0f - tx) * ty;
+        row1[1] += tx * ty;
+
+        localPeak = std::max({localPeak, row0[0], row0[1], row1[0], row1[1]});
+    }
+
+    peak = localPeak;
+    samples += count;
+}
+
+void DensityMap::Clear() {
+    std::fill(bins.begin(), bins.end(), 0.0f);
+    peak = 0.0f;
+    samples = 0;
+}
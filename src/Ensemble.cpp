@@ -0,0 +1,371 @@
+#include <ensemble.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include <sys/mman.h>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "trace.h"
+
+// std::max takes it by reference, so it needs a definition
+const size_t Ensemble::BLOCK;
+
+// Threads that sleep between Advance calls. Run hands every worker the same
+// job and returns once all of them have finished it; a worker keeps its index,
+// so it keeps its slice and, when pinned, its CPU.
+class WorkerPool {
+public:
+    const int threads;
+    const bool pinned;
+
+    WorkerPool(int threads, bool pinned) : threads(threads), pinned(pinned), job(nullptr), generation(0), running(0), stopping(false) {
+        for (int t = 0; t < threads; t++) workers.emplace_back(&WorkerPool::Loop, this, t);
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        start.notify_all();
+        for (std::thread& worker : workers) worker.join();
+    }
+
+    void Run(const std::function<void(int)>& job) {
+        std::unique_lock<std::mutex> lock(mutex);
+        this->job = &job;
+        running = threads;
+        generation++;
+        start.notify_all();
+        done.wait(lock, [this]() { return running == 0; });
+        this->job = nullptr;
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable start;
+    std::condition_variable done;
+    const std::function<void(int)>* job;
+    uint64_t generation;        // bumped by every Run
+    int running;                // workers yet to finish this generation
+    bool stopping;
+
+    void Loop(int t) {
+        TRACE_THREAD_NAME("physics worker");
+        if (pinned) PinThread(t);
+
+        uint64_t seen = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            start.wait(lock, [&]() { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+
+            lock.unlock();
+            (*job)(t);
+            lock.lock();
+            if (--running == 0) done.notify_one();
+        }
+    }
+};
+
+Ensemble::Ensemble(size_t size) : size(size), mappedBytes(0), workers(nullptr) {
+    capacity = std::max(BLOCK, (size + BLOCK - 1) / BLOCK * BLOCK);
+
+    // one allocation for all four columns, each a multiple of 64 bytes
+    memory = std::aligned_alloc(64, 4 * capacity * sizeof(float));
+    if (!memory) throw std::bad_alloc();
+
+    theta1 = static_cast<float*>(memory);
+    theta2 = theta1 + capacity;
+    omega1 = theta2 + capacity;
+    omega2 = omega1 + capacity;
+    Fill(PendulumState{ 0.0f, 0.0f, 0.0f, 0.0f });
+}
+
+static void Release(void* memory, size_t mappedBytes) {
+    if (mappedBytes) munmap(memory, mappedBytes);
+    else std::free(memory);
+}
+
+Ensemble::~Ensemble() {
+    delete workers;
+    Release(memory, mappedBytes);
+}
+
+void Ensemble::Adopt(size_t size, size_t capacity, void* mapping, size_t mappingBytes) {
+    Release(memory, mappedBytes);
+    this->size = size;
+    this->capacity = capacity;
+    memory = mapping;
+    mappedBytes = mappingBytes;
+
+    theta1 = static_cast<float*>(memory);
+    theta2 = theta1 + capacity;
+    omega1 = theta2 + capacity;
+    omega2 = omega1 + capacity;
+}
+
+PendulumState Ensemble::Get(size_t i) const {
+    return PendulumState{ theta1[i], theta2[i], omega1[i], omega2[i] };
+}
+
+void Ensemble::Set(size_t i, const PendulumState& s) {
+    theta1[i] = s.theta1;
+    theta2[i] = s.theta2;
+    omega1[i] = s.omega1;
+    omega2[i] = s.omega2;
+}
+
+void Ensemble::Fill(const PendulumState& s) {
+    std::fill(theta1, theta1 + capacity, s.theta1);
+    std::fill(theta2, theta2 + capacity, s.theta2);
+    std::fill(omega1, omega1 + capacity, s.omega1);
+    std::fill(omega2, omega2 + capacity, s.omega2);
+}
+
+const char* KernelName(Kernel kernel) {
+    return kernel == Kernel::Scalar ? "scalar" : "simd";
+}
+
+// --- SIMD KERNEL ---
+// Every loop below runs over a fixed number of lanes with no branches or
+// calls, which GCC and clang turn into vector code at -O3.
+
+static const int LANES = 8;
+static const float TWO_PI = 6.28318530718f;
+static const float INV_TWO_PI = 0.159154943092f;
+static const float INV_PI = 0.318309886184f;
+static const float PI_HI = 3.140625f;           // PI split for exact range reduction
+static const float PI_LO = 9.67653589793e-4f;
+static const float HALF_PI = 1.57079632679f;
+
+// Adding and removing 1.5 * 2^23 rounds to the nearest integer without a
+// float->int conversion or a compare, neither of which vectorize under
+// strict FP semantics. Do not build this file with -ffast-math.
+static const float ROUND_MAGIC = 12582912.0f;
+
+static inline float RoundNearest(float x) {
+    return (x + ROUND_MAGIC) - ROUND_MAGIC;
+}
+
+// |error| < 3e-7 for |x| < 30, well past what the equations produce
+static inline float FastSin(float x) {
+    // x = k*PI + r with r in [-PI/2, PI/2], and sin(x) = (-1)^k sin(r)
+    float k = RoundNearest(x * INV_PI);
+    float r = (x - k * PI_HI) - k * PI_LO;
+    float sign = 1.0f - 2.0f * std::fabs(k - 2.0f * RoundNearest(0.5f * k));
+
+    float r2 = r * r;
+    return sign * r * (1.0f + r2 * (-1.0f / 6 + r2 * (1.0f / 120 + r2 * (-1.0f / 5040 +
+           r2 * (1.0f / 362880 + r2 * (-1.0f / 39916800))))));
+}
+
+static inline float FastCos(float x) {
+    return FastSin(x + HALF_PI);
+}
+
+// wraps into [-PI, PI]; the scalar kernel's fmod keeps (-2*PI, 2*PI)
+static inline float WrapAngle(float x) {
+    return x - RoundNearest(x * INV_TWO_PI) * TWO_PI;
+}
+
+struct Lanes {
+    float t1[LANES];
+    float t2[LANES];
+    float w1[LANES];
+    float w2[LANES];
+};
+
+// same equations as Accelerations(), sharing the trig terms
+static inline void DerivativeLanes(const Lanes& s, const PendulumParams& p, Lanes& d) {
+    const float g = p.gravity, m1 = p.mass, m2 = p.mass2, l1 = p.rodLength, l2 = p.rodLength2;
+
+    for (int l = 0; l < LANES; l++) {
+        float t1 = s.t1[l], t2 = s.t2[l], w1 = s.w1[l], w2 = s.w2[l];
+        float sinT1 = FastSin(t1);
+        float cosT1 = FastCos(t1);
+        float sinA = FastSin(t1 - 2*t2);
+        float sinD = FastSin(t1 - t2);
+        float cosD = FastCos(t1 - t2);
+        float cos2D = 1.0f - 2.0f * sinD * sinD;
+
+        float den = 2*m1 + m2 - m2*cos2D;
+        float num1 = -g * (2*m1 + m2) * sinT1;
+        float num2 = -m2 * g * sinA;
+        float num3 = -2*sinD * m2 * (w2*w2*l2 + w1*w1*l1*cosD);
+        float num4 = 2*sinD * (w1*w1*l1*(m1 + m2) + g*(m1 + m2)*cosT1 + w2*w2*l2*m2*cosD);
+
+        d.t1[l] = w1;
+        d.t2[l] = w2;
+        d.w1[l] = (num1 + num2 + num3) / (l1 * den);
+        d.w2[l] = num4 / (l2 * den);
+    }
+}
+
+// out = s + k * scale
+static inline void OffsetLanes(const Lanes& s, const Lanes& k, float scale, Lanes& out) {
+    for (int l = 0; l < LANES; l++) {
+        out.t1[l] = s.t1[l] + k.t1[l] * scale;
+        out.t2[l] = s.t2[l] + k.t2[l] * scale;
+        out.w1[l] = s.w1[l] + k.w1[l] * scale;
+        out.w2[l] = s.w2[l] + k.w2[l] * scale;
+    }
+}
+
+static inline void StepLanes(Lanes& s, const PendulumParams& p, float dt, Integrator integrator) {
+    Lanes k1, k2, k3, k4, tmp;
+
+    switch (integrator) {
+        case Integrator::SemiImplicitEuler:
+            DerivativeLanes(s, p, k1);
+            for (int l = 0; l < LANES; l++) {
+                s.w1[l] += k1.w1[l] * dt;
+                s.w2[l] += k1.w2[l] * dt;
+                s.t1[l] += s.w1[l] * dt;
+                s.t2[l] += s.w2[l] * dt;
+            }
+            break;
+
+        case Integrator::Euler:
+            DerivativeLanes(s, p, k1);
+            OffsetLanes(s, k1, dt, s);
+            break;
+
+        case Integrator::Midpoint:
+            DerivativeLanes(s, p, k1);
+            OffsetLanes(s, k1, 0.5f * dt, tmp);
+            DerivativeLanes(tmp, p, k2);
+            OffsetLanes(s, k2, dt, s);
+            break;
+
+        case Integrator::RK4:
+            DerivativeLanes(s, p, k1);
+            OffsetLanes(s, k1, 0.5f * dt, tmp);
+            DerivativeLanes(tmp, p, k2);
+            OffsetLanes(s, k2, 0.5f * dt, tmp);
+            DerivativeLanes(tmp, p, k3);
+            OffsetLanes(s, k3, dt, tmp);
+            DerivativeLanes(tmp, p, k4);
+            for (int l = 0; l < LANES; l++) {
+                s.t1[l] += dt / 6.0f * (k1.t1[l] + 2*k2.t1[l] + 2*k3.t1[l] + k4.t1[l]);
+                s.t2[l] += dt / 6.0f * (k1.t2[l] + 2*k2.t2[l] + 2*k3.t2[l] + k4.t2[l]);
+                s.w1[l] += dt / 6.0f * (k1.w1[l] + 2*k2.w1[l] + 2*k3.w1[l] + k4.w1[l]);
+                s.w2[l] += dt / 6.0f * (k1.w2[l] + 2*k2.w2[l] + 2*k3.w2[l] + k4.w2[l]);
+            }
+            break;
+    }
+
+    for (int l = 0; l < LANES; l++) {
+        s.t1[l] = WrapAngle(s.t1[l]);
+        s.t2[l] = WrapAngle(s.t2[l]);
+    }
+}
+
+static void AdvanceSimd(Ensemble& e, const PendulumParams& p, float dt, int steps,
+                        Integrator integrator, size_t begin, size_t end) {
+    // keep one block of lanes in registers/L1 for all steps
+    for (size_t i = begin; i < end; i += LANES) {
+        Lanes s;
+        std::copy(e.theta1 + i, e.theta1 + i + LANES, s.t1);
+        std::copy(e.theta2 + i, e.theta2 + i + LANES, s.t2);
+        std::copy(e.omega1 + i, e.omega1 + i + LANES, s.w1);
+        std::copy(e.omega2 + i, e.omega2 + i + LANES, s.w2);
+
+        for (int n = 0; n < steps; n++) {
+            StepLanes(s, p, dt, integrator);
+        }
+
+        std::copy(s.t1, s.t1 + LANES, e.theta1 + i);
+        std::copy(s.t2, s.t2 + LANES, e.theta2 + i);
+        std::copy(s.w1, s.w1 + LANES, e.omega1 + i);
+        std::copy(s.w2, s.w2 + LANES, e.omega2 + i);
+    }
+}
+
+// --- DONE WITH SIMD KERNEL ---
+
+void AdvanceRange(Ensemble& e, const PendulumParams& p, float dt, int steps,
+                  Integrator integrator, Kernel kernel, size_t begin, size_t end) {
+    if (kernel == Kernel::Simd) {
+        // padding lanes are real pendulums, so round up to whole blocks
+        end = std::min(e.capacity, (end + LANES - 1) / LANES * LANES);
+        AdvanceSimd(e, p, dt, steps, integrator, begin, end);
+        return;
+    }
+
+    for (size_t i = begin; i < std::min(end, e.size); i++) {
+        PendulumState s = e.Get(i);
+        for (int n = 0; n < steps; n++) {
+            StepPendulum(s, p, dt, integrator);
+        }
+        e.Set(i, s);
+    }
+}
+
+// AdvanceRange plus throughput accounting when counters are given
+static void AdvanceCounted(Ensemble& e, const PendulumParams& p, float dt, int steps,
+                           const AdvanceOptions& options, size_t begin, size_t end) {
+    if (!options.counters) {
+        AdvanceRange(e, p, dt, steps, options.integrator, options.kernel, begin, end);
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    AdvanceRange(e, p, dt, steps, options.integrator, options.kernel, begin, end);
+    auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    options.counters->AddSteps(uint64_t(end - begin) * steps, uint64_t(nanos.count()));
+}
+
+void Advance(Ensemble& e, const PendulumParams& p, float dt, int steps, const AdvanceOptions& options) {
+    size_t blocks = e.capacity / Ensemble::BLOCK;
+    int threads = int(std::max<size_t>(1, std::min<size_t>(options.threads, blocks)));
+
+    if (threads == 1) {
+        AdvanceCounted(e, p, dt, steps, options, 0, e.size);
+    } else {
+        if (!e.workers || e.workers->threads != threads || e.workers->pinned != options.pinThreads) {
+            delete e.workers;
+            e.workers = nullptr;
+            e.workers = new WorkerPool(threads, options.pinThreads);
+        }
+        // contiguous slices of whole blocks, one per thread
+        e.workers->Run([&](int t) {
+            TRACE_ZONE("Advance slice");
+            size_t begin = blocks * t / threads * Ensemble::BLOCK;
+            size_t end = blocks * (t + 1) / threads * Ensemble::BLOCK;
+            AdvanceCounted(e, p, dt, steps, options, begin, std::min(end, e.size));
+        });
+    }
+
+    if (options.counters) options.counters->AddSimTime(double(dt) * steps);
+}
+
+bool PinThread(int cpu) {
+#ifdef __linux__
+    int count = int(std::thread::hardware_concurrency());
+    if (count <= 0) return false;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu % count, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
@@ -0,0 +1,238 @@
+#include <exporter.h>
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#include "trace.h"
+
+// longest line either format writes for one member, with room to spare
+static const size_t MAX_LINE = 512;
+
+// empty polls before the writer sleeps
+static const int IDLE_YIELDS = 64;
+
+// a partial buffer waits at most this long for the disk while idle; a
+// producer pushing one step per frame would otherwise mean a write per frame
+static const std::chrono::seconds FLUSH_INTERVAL(1);
+
+Exporter::Exporter()
+    : members(0), dt(0.0f), format(Format::Csv), policy(Backpressure::Block), file(nullptr), slots(0), used(0) {}
+
+Exporter::~Exporter() {
+    Close();
+}
+
+bool Exporter::Open(const char* path, size_t members, float dt, Format format, Backpressure policy,
+                    size_t queueSteps) {
+    Close();
+    if (members == 0) return false;
+
+    file = fopen(path, "wb");
+    if (!file) return false;
+    // the writer does its own buffering in BUFFER_BYTES blocks
+    setvbuf(file, nullptr, _IONBF, 0);
+
+    this->members = members;
+    this->dt = dt;
+    this->format = format;
+    this->policy = policy;
+
+    size_t stepBytes = members * 4 * sizeof(float) + sizeof(uint64_t);
+    slots = queueSteps ? std::max<size_t>(2, queueSteps)
+                       : std::min<size_t>(65536, std::max<size_t>(4, QUEUE_BYTES / stepBytes));
+    stepOf.assign(slots, 0);
+    ring.assign(slots * members * 4, 0.0f);
+    buffer.resize(BUFFER_BYTES + MAX_LINE);
+    used = 0;
+    flushed = std::chrono::steady_clock::now();
+
+    head = 0;
+    tail = 0;
+    closing = false;
+    offered = 0;
+    exported = 0;
+    dropped = 0;
+    decimated = 0;
+    stalls = 0;
+    fileBytes = 0;
+    decimation = 1;
+    failed = false;
+
+    if (format == Format::Csv) {
+        const char* header = "step,time,member,theta1,theta2,omega1,omega2\n";
+        used = strlen(header);
+        memcpy(buffer.data(), header, used);
+    }
+
+    writer = std::thread(&Exporter::WriterLoop, this);
+    return true;
+}
+
+void Exporter::Push(const float* theta1, const float* theta2, const float* omega1, const float* omega2) {
+    if (!file) return;
+
+    uint64_t step = offered.load(std::memory_order_relaxed);
+    offered.store(step + 1, std::memory_order_relaxed);
+
+    uint32_t stride = decimation.load(std::memory_order_relaxed);
+    if (step % stride != 0) {
+        decimated.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    uint64_t h = head.load(std::memory_order_relaxed);
+    uint64_t filled = h - tail.load(std::memory_order_acquire);
+    if (filled == slots) {
+        if (policy == Backpressure::Block) {
+            stalls.fetch_add(1, std::memory_order_relaxed);
+            while (h - tail.load(std::memory_order_acquire) == slots) std::this_thread::yield();
+        } else {
+            if (policy == Backpressure::Decimate) decimation.store(std::min(stride * 2, MAX_DECIMATION), std::memory_order_relaxed);
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    } else if (policy == Backpressure::Decimate && stride > 1 && filled < slots / 4) {
+        // the writer has caught up: take steps more often again
+        decimation.store(stride / 2, std::memory_order_relaxed);
+    }
+
+    // the slot is ours until head moves past it
+    size_t slot = size_t(h % slots);
+    stepOf[slot] = step;
+    float* dst = &ring[slot * members * 4];
+    size_t bytes = members * sizeof(float);
+    memcpy(dst, theta1, bytes);
+    memcpy(dst + members, theta2, bytes);
+    memcpy(dst + 2 * members, omega1, bytes);
+    memcpy(dst + 3 * members, omega2, bytes);
+    head.store(h + 1, std::memory_order_release);
+}
+
+void Exporter::Push(const Ensemble& e) {
+    Push(e.theta1, e.theta2, e.omega1, e.omega2);
+}
+
+void Exporter::Push(const PendulumState& s) {
+    Push(&s.theta1, &s.theta2, &s.omega1, &s.omega2);
+}
+
+// to_chars gives the shortest text that reads back to the same float
+static char* Append(char* p, float v) {
+    return std::to_chars(p, p + 32, v).ptr;
+}
+
+static char* Append(char* p, double v) {
+    return std::to_chars(p, p + 32, v).ptr;
+}
+
+static char* Append(char* p, uint64_t v) {
+    return std::to_chars(p, p + 24, v).ptr;
+}
+
+static char* Append(char* p, const char* s) {
+    size_t n = strlen(s);
+    memcpy(p, s, n);
+    return p + n;
+}
+
+void Exporter::FormatSlot(size_t slot) {
+    uint64_t step = stepOf[slot];
+    double time = double(step + 1) * dt;     // a pushed state is the end of its step
+    const float* columns = &ring[slot * members * 4];
+
+    for (size_t m = 0; m < members; m++) {
+        char* p = buffer.data() + used;
+        float theta1 = columns[m], theta2 = columns[members + m];
+        float omega1 = columns[2 * members + m], omega2 = columns[3 * members + m];
+
+        if (format == Format::Csv) {
+            p = Append(p, step); *p++ = ',';
+            p = Append(p, time); *p++ = ',';
+            p = Append(p, uint64_t(m)); *p++ = ',';
+            p = Append(p, theta1); *p++ = ',';
+            p = Append(p, theta2); *p++ = ',';
+            p = Append(p, omega1); *p++ = ',';
+            p = Append(p, omega2);
+        } else {
+            // JSON has no NaN or infinity; a blown-up state becomes null
+            auto number = [](char* p, float v) { return std::isfinite(v) ? Append(p, v) : Append(p, "null"); };
+            p = Append(p, "{\"step\":"); p = Append(p, step);
+            p = Append(p, ",\"time\":"); p = Append(p, time);
+            p = Append(p, ",\"member\":"); p = Append(p, uint64_t(m));
+            p = Append(p, ",\"theta1\":"); p = number(p, theta1);
+            p = Append(p, ",\"theta2\":"); p = number(p, theta2);
+            p = Append(p, ",\"omega1\":"); p = number(p, omega1);
+            p = Append(p, ",\"omega2\":"); p = number(p, omega2);
+            *p++ = '}';
+        }
+        *p++ = '\n';
+        used = size_t(p - buffer.data());
+        if (used >= BUFFER_BYTES) Flush();
+    }
+}
+
+void Exporter::Flush() {
+    flushed = std::chrono::steady_clock::now();
+    if (used == 0) return;
+    TRACE_ZONE("Export write");
+    // after a failure keep draining so a blocked producer is released
+    if (!failed) {
+        if (fwrite(buffer.data(), 1, used, file) == used) fileBytes.fetch_add(used, std::memory_order_relaxed);
+        else failed = true;
+    }
+    used = 0;
+}
+
+void Exporter::WriterLoop() {
+    TRACE_THREAD_NAME("exporter");
+
+    int idle = 0;
+    for (;;) {
+        uint64_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire)) {
+            if (closing.load(std::memory_order_acquire)) {
+                if (t == head.load(std::memory_order_acquire)) break;
+                continue;
+            }
+            // the producer is usually mid-step: give it the core before
+            // deciding it has gone quiet and sleeping
+            if (++idle < IDLE_YIELDS) {
+                std::this_thread::yield();
+                continue;
+            }
+            if (used > 0 && std::chrono::steady_clock::now() - flushed >= FLUSH_INTERVAL) Flush();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        idle = 0;
+
+        {
+            TRACE_ZONE("Export format");
+            FormatSlot(size_t(t % slots));
+        }
+        tail.store(t + 1, std::memory_order_release);
+        exported.fetch_add(1, std::memory_order_relaxed);
+    }
+    Flush();
+}
+
+bool Exporter::Close() {
+    if (!file) return true;
+
+    closing.store(true, std::memory_order_release);
+    writer.join();
+
+    bool closed = fclose(file) == 0;
+    bool ok = closed && !failed;
+    file = nullptr;
+    ring.clear();
+    ring.shrink_to_fit();
+    stepOf.clear();
+    stepOf.shrink_to_fit();
+    buffer.clear();
+    buffer.shrink_to_fit();
+    return ok;
+}
@@ -0,0 +1,28 @@
+#include <fbo.h>
+
+FBO::FBO() {
+    // Generate the Framebuffer Object
+    glGenFramebuffers(1, &ID);
+}
+
+void FBO::AttachTexture(Texture& texture) {
+    // Render into the texture through colour attachment 0
+    glBindFramebuffer(GL_FRAMEBUFFER, ID);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture.ID, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void FBO::Bind() {
+    // Bind the framebuffer
+    glBindFramebuffer(GL_FRAMEBUFFER, ID);
+}
+
+void FBO::Unbind() {
+    // Go back to the default framebuffer
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void FBO::Delete() {
+    // Delete the framebuffer
+    glDeleteFramebuffers(1, &ID);
+}
@@ -0,0 +1,78 @@
+#include <frameCapture.h>
+
+#include "trace.h"
+
+// long enough for any frame; a lost context shouldn't hang the app
+static const GLuint64 FENCE_TIMEOUT_NS = 1000000000ull;
+
+FrameCapture::FrameCapture() : fences{}, copies{}, width(0), height(0), next(0), pending(0) {
+    glGenBuffers(PBO_COUNT, IDs);
+}
+
+void FrameCapture::Resize(int width, int height) {
+    for (int i = 0; i < PBO_COUNT; i++) {
+        if (fences[i]) glDeleteSync(fences[i]);
+        fences[i] = nullptr;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, IDs[i]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, GLsizeiptr(width) * height * 4, nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    this->width = width;
+    this->height = height;
+    next = 0;
+    pending = 0;
+}
+
+// maps the oldest read and copies it into the writer's ring
+void FrameCapture::Deliver(VideoWriter& writer, bool wait) {
+    TRACE_ZONE("Capture map");
+    int oldest = (next - pending + PBO_COUNT) % PBO_COUNT;
+    glClientWaitSync(fences[oldest], GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT_NS);
+    glDeleteSync(fences[oldest]);
+    fences[oldest] = nullptr;
+    pending--;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, IDs[oldest]);
+    GLsizeiptr bytes = GLsizeiptr(width) * height * 4;
+    const uint8_t* pixels = static_cast<const uint8_t*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT));
+    if (pixels) {
+        // GL rows run bottom-up
+        ptrdiff_t stride = ptrdiff_t(width) * 4;
+        for (int i = 0; i < copies[oldest]; i++) writer.Push(pixels + (height - 1) * stride, -stride, wait);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void FrameCapture::Read(VideoWriter& writer, bool wait, int copies) {
+    // every PBO in flight: the oldest has to finish before it's reused
+    if (pending == PBO_COUNT) Deliver(writer, wait);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, IDs[next]);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    fences[next] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    this->copies[next] = copies;
+    next = (next + 1) % PBO_COUNT;
+    pending++;
+
+    // pick up whatever the GPU has already finished, without waiting
+    while (pending > 1) {
+        int oldest = (next - pending + PBO_COUNT) % PBO_COUNT;
+        if (glClientWaitSync(fences[oldest], 0, 0) == GL_TIMEOUT_EXPIRED) break;
+        Deliver(writer, wait);
+    }
+}
+
+void FrameCapture::Flush(VideoWriter& writer) {
+    while (pending > 0) Deliver(writer, true);
+}
+
+void FrameCapture::Delete() {
+    for (int i = 0; i < PBO_COUNT; i++) {
+        if (fences[i]) glDeleteSync(fences[i]);
+        fences[i] = nullptr;
+    }
+    glDeleteBuffers(PBO_COUNT, IDs);
+}
@@ -0,0 +1,35 @@
+#include <gpuTimer.h>
+
+GpuTimer::GpuTimer() : pending{ false, false }, current(0), lastMs(0.0) {
+    // Generate both queries up front
+    glGenQueries(2, IDs);
+}
+
+void GpuTimer::Begin() {
+    glBeginQuery(GL_TIME_ELAPSED, IDs[current]);
+}
+
+void GpuTimer::End() {
+    glEndQuery(GL_TIME_ELAPSED);
+    pending[current] = true;
+
+    // Read last frame's query if the GPU has finished it
+    int other = 1 - current;
+    if (pending[other]) {
+        GLint available = 0;
+        glGetQueryObjectiv(IDs[other], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+            GLuint64 ns = 0;
+            glGetQueryObjectui64v(IDs[other], GL_QUERY_RESULT, &ns);
+            lastMs = ns * 1e-6;
+            pending[other] = false;
+        }
+    }
+
+    // Only switch once the other query is free again
+    if (!pending[other]) current = other;
+}
+
+void GpuTimer::Delete() {
+    glDeleteQueries(2, IDs);
+}
@@ -0,0 +1,93 @@
+#include <histogram.h>
+
+#include <algorithm>
+#include <cstdio>
+
+static const int HALF = Histogram::SUB_BUCKETS / 2;
+
+// magnitude: how many low bits are dropped to fit value in SUB_BUCKETS
+static int Magnitude(uint64_t value) {
+    int shift = 0;
+    while ((value >> shift) >= uint64_t(Histogram::SUB_BUCKETS)) shift++;
+    return shift;
+}
+
+Histogram::Histogram(const char* name, const char* unit, uint64_t highest)
+    : name(name), unit(unit), highest(highest) {
+    counts.assign(BucketIndex(highest) + 1, 0);
+    Reset();
+}
+
+// magnitude 0 covers [0, SUB_BUCKETS) exactly; every magnitude above adds
+// HALF buckets of width 2^magnitude
+int Histogram::BucketIndex(uint64_t value) const {
+    int shift = Magnitude(value);
+    return shift * HALF + int(value >> shift);
+}
+
+uint64_t Histogram::BucketLow(int index) const {
+    if (index < SUB_BUCKETS) return uint64_t(index);
+    int shift = index / HALF - 1;
+    return uint64_t(index - shift * HALF) << shift;
+}
+
+uint64_t Histogram::BucketWidth(int index) const {
+    return index < SUB_BUCKETS ? 1 : uint64_t(1) << (index / HALF - 1);
+}
+
+void Histogram::Record(uint64_t value) {
+    value = std::min(value, highest);
+    counts[BucketIndex(value)]++;
+    total++;
+    sum += double(value);
+    min = std::min(min, value);
+    max = std::max(max, value);
+}
+
+void Histogram::Reset() {
+    std::fill(counts.begin(), counts.end(), 0);
+    total = 0;
+    min = UINT64_MAX;
+    max = 0;
+    sum = 0.0;
+}
+
+uint64_t Histogram::Percentile(double p) const {
+    if (total == 0) return 0;
+    if (p >= 1.0) return max;
+
+    uint64_t rank = std::max<uint64_t>(1, uint64_t(p * double(total) + 0.5));
+    uint64_t seen = 0;
+    for (int i = 0; i < int(counts.size()); i++) {
+        seen += counts[i];
+        if (seen >= rank) {
+            uint64_t mid = BucketLow(i) + BucketWidth(i) / 2;
+            return std::min(std::max(mid, min), max);
+        }
+    }
+    return max;
+}
+
+double Histogram::Mean() const {
+    return total ? sum / double(total) : 0.0;
+}
+
+bool WriteHistogramsCsv(const char* path, const Histogram* const* histograms, int count) {
+    FILE* out = fopen(path, "w");
+    if (!out) return false;
+
+    fprintf(out, "histogram,unit,low,high,count,cumulative\n");
+    for (int h = 0; h < count; h++) {
+        const Histogram& hist = *histograms[h];
+        uint64_t seen = 0;
+        for (int i = 0; i < int(hist.counts.size()); i++) {
+            if (hist.counts[i] == 0) continue;
+            seen += hist.counts[i];
+            uint64_t low = hist.BucketLow(i);
+            fprintf(out, "%s,%s,%llu,%llu,%llu,%.6f\n", hist.name, hist.unit, (unsigned long long)low,
+                    (unsigned long long)(low + hist.BucketWidth(i) - 1), (unsigned long long)hist.counts[i],
+                    double(seen) / double(hist.total));
+        }
+    }
+    return fclose(out) == 0;
+}
@@ -0,0 +1,202 @@
+#include <journal.h>
+
+#include <cstring>
+
+#include "trace.h"
+
+const char* JournalEventName(JournalEvent kind) {
+    static const char* const names[] = {
+        "theta1", "theta2", "omega1", "omega2", "rod1", "rod2", "mass1", "mass2", "gravity", "dt", "damping",
+        "pause", "resume", "reset", "start", "end",
+    };
+    return unsigned(kind) <= unsigned(JournalEvent::End) ? names[unsigned(kind)] : "?";
+}
+
+uint64_t HashState(uint64_t hash, const PendulumState& s) {
+    unsigned char bytes[sizeof(PendulumState)];
+    memcpy(bytes, &s, sizeof(s));
+    for (unsigned char b : bytes) hash = (hash ^ b) * 1099511628211ull;
+    return hash;
+}
+
+// the value fields of JournalInputs, in JournalEvent order
+static float* Field(JournalInputs& in, JournalEvent kind) {
+    switch (kind) {
+        case JournalEvent::Theta1: return &in.state.theta1;
+        case JournalEvent::Theta2: return &in.state.theta2;
+        case JournalEvent::Omega1: return &in.state.omega1;
+        case JournalEvent::Omega2: return &in.state.omega2;
+        case JournalEvent::Rod1: return &in.params.rodLength;
+        case JournalEvent::Rod2: return &in.params.rodLength2;
+        case JournalEvent::Mass1: return &in.params.mass;
+        case JournalEvent::Mass2: return &in.params.mass2;
+        case JournalEvent::Gravity: return &in.params.gravity;
+        case JournalEvent::Dt: return &in.dt;
+        case JournalEvent::Damping: return &in.damping;
+        default: return nullptr;
+    }
+}
+
+Journal::Journal() : events(0), steps(0), hash(JOURNAL_HASH_SEED), file(nullptr), last{}, eventStep(0), failed(false) {}
+
+Journal::~Journal() {
+    Close();
+}
+
+bool Journal::Open(const char* path, const JournalInputs& inputs) {
+    Close();
+    file = fopen(path, "wb");
+    if (!file) return false;
+    setvbuf(file, nullptr, _IOFBF, 1 << 16);
+
+    JournalHeader header = {};
+    memcpy(header.magic, "PENDJNL1", 8);
+    header.version = JOURNAL_VERSION;
+    header.paused = inputs.paused;
+    header.state = inputs.state;
+    header.params = inputs.params;
+    header.dt = inputs.dt;
+    header.damping = inputs.damping;
+    failed = fwrite(&header, sizeof(header), 1, file) != 1;
+
+    last = inputs;
+    events = 0;
+    steps = 0;
+    eventStep = 0;
+    hash = JOURNAL_HASH_SEED;
+    return true;
+}
+
+void Journal::Write(JournalEvent kind, const float* value) {
+    // varint step delta, kind, then the value if there is one
+    unsigned char record[16];
+    size_t n = 0;
+    uint64_t delta = steps - eventStep;
+    do {
+        record[n++] = uint8_t(delta & 0x7f) | (delta >= 0x80 ? 0x80 : 0);
+        delta >>= 7;
+    } while (delta);
+    record[n++] = uint8_t(kind);
+    if (value) {
+        memcpy(record + n, value, sizeof(float));
+        n += sizeof(float);
+    }
+    failed |= fwrite(record, 1, n, file) != n;
+    eventStep = steps;
+    events++;
+}
+
+void Journal::Sync(const JournalInputs& inputs) {
+    if (!file) return;
+    JournalInputs now = inputs;
+    // bitwise, so -0 and NaN edits are journaled too
+    for (int k = 0; k < JOURNAL_VALUE_EVENTS; k++) {
+        JournalEvent kind = JournalEvent(k);
+        float* value = Field(now, kind);
+        if (memcmp(value, Field(last, kind), sizeof(float)) != 0) Write(kind, value);
+    }
+    if (now.paused != last.paused) Write(now.paused ? JournalEvent::Pause : JournalEvent::Resume, nullptr);
+    last = now;
+}
+
+void Journal::Mark(JournalEvent kind) {
+    if (file) Write(kind, nullptr);
+}
+
+void Journal::Step(const PendulumState& s) {
+    if (!file) return;
+    last.state = s;
+    hash = HashState(hash, s);
+    steps++;
+}
+
+bool Journal::Close() {
+    if (!file) return true;
+    Write(JournalEvent::End, nullptr);
+    JournalFooter footer = {};
+    footer.steps = steps;
+    footer.hash = hash;
+    memcpy(footer.magic, "PENDJEND", 8);
+    failed |= fwrite(&footer, sizeof(footer), 1, file) != 1;
+    failed |= fclose(file) != 0;
+    file = nullptr;
+    return !failed;
+}
+
+JournalReplay::JournalReplay() : header{}, inputs{}, step(0), steps(0), hash(JOURNAL_HASH_SEED), ended(false), footer{}, next(0) {}
+
+bool JournalReplay::Open(const char* path) {
+    TRACE_ZONE("Open journal");
+    FILE* in = fopen(path, "rb");
+    if (!in) return false;
+    std::vector<unsigned char> data;
+    unsigned char buffer[1 << 16];
+    size_t got;
+    while ((got = fread(buffer, 1, sizeof(buffer), in)) > 0) data.insert(data.end(), buffer, buffer + got);
+    fclose(in);
+
+    if (data.size() < sizeof(header)) return false;
+    memcpy(&header, data.data(), sizeof(header));
+    if (memcmp(header.magic, "PENDJNL1", 8) != 0 || header.version != JOURNAL_VERSION) return false;
+    inputs.state = header.state;
+    inputs.params = header.params;
+    inputs.dt = header.dt;
+    inputs.damping = header.damping;
+    inputs.paused = header.paused != 0;
+
+    // a journal cut short by a crash keeps every complete event
+    events.clear();
+    ended = false;
+    uint64_t at = 0;
+    size_t pos = sizeof(header);
+    while (pos < data.size()) {
+        uint64_t delta = 0;
+        bool complete = false;
+        for (int shift = 0; pos < data.size() && shift < 64; shift += 7) {
+            unsigned char b = data[pos++];
+            delta |= uint64_t(b & 0x7f) << shift;
+            if (!(b & 0x80)) {
+                complete = true;
+                break;
+            }
+        }
+        if (!complete || pos >= data.size()) break;
+        Event e = { at + delta, JournalEvent(data[pos++]), 0.0f };
+        at = e.step;
+        if (e.kind == JournalEvent::End) {
+            if (data.size() - pos < sizeof(footer)) break;
+            memcpy(&footer, data.data() + pos, sizeof(footer));
+            ended = memcmp(footer.magic, "PENDJEND", 8) == 0 && footer.steps == at;
+            break;
+        }
+        if (unsigned(e.kind) > unsigned(JournalEvent::End)) break;
+        if (int(e.kind) < JOURNAL_VALUE_EVENTS) {
+            if (data.size() - pos < sizeof(float)) break;
+            memcpy(&e.value, data.data() + pos, sizeof(float));
+            pos += sizeof(float);
+        }
+        events.push_back(e);
+    }
+
+    steps = ended ? footer.steps : (events.empty() ? 0 : events.back().step);
+    step = 0;
+    next = 0;
+    hash = JOURNAL_HASH_SEED;
+    return true;
+}
+
+void JournalReplay::Apply(const Event& e) {
+    if (float* value = Field(inputs, e.kind)) *value = e.value;
+    else if (e.kind == JournalEvent::Pause) inputs.paused = true;
+    else if (e.kind == JournalEvent::Resume) inputs.paused = false;
+}
+
+bool JournalReplay::Step() {
+    while (next < events.size() && events[next].step == step) Apply(events[next++]);
+    if (step >= steps) return false;
+    // exactly what Pendulum::Step does in the app
+    UpdatePendulum(inputs.state, inputs.params, inputs.dt);
+    hash = HashState(hash, inputs.state);
+    step++;
+    return true;
+}
@@ -0,0 +1,171 @@
+#include <pendulum.h>
+
+#include <cmath>
+#include <cstring>
+
+static const char* INTEGRATOR_NAMES[INTEGRATOR_COUNT] = { "euler", "semi-implicit", "midpoint", "rk4" };
+
+const char* IntegratorName(Integrator integrator) {
+    return INTEGRATOR_NAMES[int(integrator)];
+}
+
+bool ParseIntegrator(const char* name, Integrator& integrator) {
+    for (int i = 0; i < INTEGRATOR_COUNT; i++) {
+        if (strcmp(name, INTEGRATOR_NAMES[i]) == 0) {
+            integrator = Integrator(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+int IntegratorStages(Integrator integrator) {
+    switch (integrator) {
+        case Integrator::Midpoint: return 2;
+        case Integrator::RK4: return 4;
+        default: return 1;
+    }
+}
+
+void Accelerations(const PendulumState& s, const PendulumParams& p, float& alpha1, float& alpha2) {
+    // intermediate calculations
+    float num1 = -p.gravity * (2*p.mass + p.mass2) * sin(s.theta1);
+    float num2 = -p.mass2 * p.gravity * sin(s.theta1 - 2*s.theta2);
+    float num3 = -2*sin(s.theta1 - s.theta2) * p.mass2 *
+                (s.omega2*s.omega2*p.rodLength2 + s.omega1*s.omega1*p.rodLength*cos(s.theta1 - s.theta2));
+    float den1 = p.rodLength * (2*p.mass + p.mass2 - p.mass2*cos(2*s.theta1 - 2*s.theta2));
+
+    // angular accel for theta1
+    alpha1 = (num1 + num2 + num3) / den1;
+
+    float num4 = 2*sin(s.theta1 - s.theta2) *
+                (s.omega1*s.omega1*p.rodLength*(p.mass + p.mass2) +
+                p.gravity*(p.mass + p.mass2)*cos(s.theta1) +
+                s.omega2*s.omega2*p.rodLength2*p.mass2*cos(s.theta1 - s.theta2));
+    float den2 = p.rodLength2 * (2*p.mass + p.mass2 - p.mass2*cos(2*s.theta1 - 2*s.theta2));
+
+    // angular accel for theta2
+    alpha2 = num4 / den2;
+}
+
+float Energy(const PendulumState& s, const PendulumParams& p) {
+    float v1 = p.rodLength * s.omega1;
+    float v2 = p.rodLength2 * s.omega2;
+    float kinetic = 0.5f * p.mass * v1*v1
+                  + 0.5f * p.mass2 * (v1*v1 + v2*v2 + 2*v1*v2*cos(s.theta1 - s.theta2));
+    float potential = -(p.mass + p.mass2) * p.gravity * p.rodLength * cos(s.theta1)
+                    - p.mass2 * p.gravity * p.rodLength2 * cos(s.theta2);
+    return kinetic + potential;
+}
+
+void UpdatePendulum(PendulumState& s, const PendulumParams& p, float dt) {
+    float alpha1, alpha2;
+    Accelerations(s, p, alpha1, alpha2);
+
+    // update angular velocities
+    s.omega1 += alpha1 * dt;
+    s.omega2 += alpha2 * dt;
+
+    // update angles
+    s.theta1 += s.omega1 * dt;
+    s.theta2 += s.omega2 * dt;
+
+    // normalize angles to be between 0 and 2*PI
+    s.theta1 = fmod(s.theta1, 2 * M_PI);
+    s.theta2 = fmod(s.theta2, 2 * M_PI);
+}
+
+// d/dt of the whole state
+static PendulumState Derivative(const PendulumState& s, const PendulumParams& p) {
+    PendulumState d;
+    d.theta1 = s.omega1;
+    d.theta2 = s.omega2;
+    Accelerations(s, p, d.omega1, d.omega2);
+    return d;
+}
+
+// s + k * scale
+static PendulumState Offset(const PendulumState& s, const PendulumState& k, float scale) {
+    return PendulumState{ s.theta1 + k.theta1 * scale, s.theta2 + k.theta2 * scale,
+                          s.omega1 + k.omega1 * scale, s.omega2 + k.omega2 * scale };
+}
+
+void StepPendulum(PendulumState& s, const PendulumParams& p, float dt, Integrator integrator) {
+    switch (integrator) {
+        case Integrator::SemiImplicitEuler:
+            UpdatePendulum(s, p, dt);
+            return;
+
+        case Integrator::Euler:
+            s = Offset(s, Derivative(s, p), dt);
+            break;
+
+        case Integrator::Midpoint: {
+            PendulumState k1 = Derivative(s, p);
+            PendulumState k2 = Derivative(Offset(s, k1, 0.5f * dt), p);
+            s = Offset(s, k2, dt);
+            break;
+        }
+
+        case Integrator::RK4: {
+            PendulumState k1 = Derivative(s, p);
+            PendulumState k2 = Derivative(Offset(s, k1, 0.5f * dt), p);
+            PendulumState k3 = Derivative(Offset(s, k2, 0.5f * dt), p);
+            PendulumState k4 = Derivative(Offset(s, k3, dt), p);
+            s.theta1 += dt / 6.0f * (k1.theta1 + 2*k2.theta1 + 2*k3.theta1 + k4.theta1);
+            s.theta2 += dt / 6.0f * (k1.theta2 + 2*k2.theta2 + 2*k3.theta2 + k4.theta2);
+            s.omega1 += dt / 6.0f * (k1.omega1 + 2*k2.omega1 + 2*k3.omega1 + k4.omega1);
+            s.omega2 += dt / 6.0f * (k1.omega2 + 2*k2.omega2 + 2*k3.omega2 + k4.omega2);
+            break;
+        }
+    }
+
+    s.theta1 = fmod(s.theta1, 2 * M_PI);
+    s.theta2 = fmod(s.theta2, 2 * M_PI);
+}
+
+Pendulum::Pendulum(const PendulumState& initial) : prev(initial), curr(initial), dt(0.0f) {}
+
+void Pendulum::Step(const PendulumParams& p, float dt) {
+    prev = curr;
+    UpdatePendulum(curr, p, dt);
+    this->dt = dt;
+}
+
+void Pendulum::Set(const PendulumState& s) {
+    prev = s;
+    curr = s;
+}
+
+// difference b - a taken the short way round, so a wrap at +-2*PI doesn't
+// turn into a full turn of interpolation
+static float AngleDelta(float a, float b) {
+    float d = b - a;
+    return d - float(2 * M_PI) * std::round(d / float(2 * M_PI));
+}
+
+static float Hermite(float p0, float m0, float p1, float m1, float h, float t) {
+    float t2 = t * t;
+    float t3 = t2 * t;
+    return (2*t3 - 3*t2 + 1) * p0 + (t3 - 2*t2 + t) * h * m0
+         + (-2*t3 + 3*t2) * p1 + (t3 - t2) * h * m1;
+}
+
+PendulumState Pendulum::Sample(const PendulumParams& p, float alpha) const {
+    if (dt <= 0.0f) return curr;
+
+    // slopes: angles use the velocities, velocities use the accelerations
+    float a1Prev, a2Prev, a1Curr, a2Curr;
+    Accelerations(prev, p, a1Prev, a2Prev);
+    Accelerations(curr, p, a1Curr, a2Curr);
+
+    float end1 = prev.theta1 + AngleDelta(prev.theta1, curr.theta1);
+    float end2 = prev.theta2 + AngleDelta(prev.theta2, curr.theta2);
+
+    PendulumState s;
+    s.theta1 = Hermite(prev.theta1, prev.omega1, end1, curr.omega1, dt, alpha);
+    s.theta2 = Hermite(prev.theta2, prev.omega2, end2, curr.omega2, dt, alpha);
+    s.omega1 = Hermite(prev.omega1, a1Prev, curr.omega1, a1Curr, dt, alpha);
+    s.omega2 = Hermite(prev.omega2, a2Prev, curr.omega2, a2Curr, dt, alpha);
+    return s;
+}
@@ -0,0 +1,34 @@
+#include <physicsStats.h>
+
+ThroughputMeter::ThroughputMeter()
+    : memberStepsPerSecond(0.0), nsPerStep(0.0), realtimeFactor(0.0), stepsPerFrame(0.0),
+      lastTime(-1.0), lastMemberSteps(0), lastStepNanos(0), lastSimNanos(0), lastFrames(0), lastFrameSteps(0) {}
+
+bool ThroughputMeter::Update(const PhysicsCounters& counters, double now) {
+    if (lastTime >= 0.0 && now - lastTime < INTERVAL) return false;
+
+    uint64_t memberSteps = counters.memberSteps.load(std::memory_order_relaxed);
+    uint64_t stepNanos = counters.stepNanos.load(std::memory_order_relaxed);
+    uint64_t simNanos = counters.simNanos.load(std::memory_order_relaxed);
+    uint64_t frames = counters.frames.load(std::memory_order_relaxed);
+    uint64_t frameSteps = counters.frameSteps.load(std::memory_order_relaxed);
+
+    // the first call only takes the starting point
+    if (lastTime >= 0.0) {
+        double wall = now - lastTime;
+        uint64_t steps = memberSteps - lastMemberSteps;
+        memberStepsPerSecond = double(steps) / wall;
+        nsPerStep = steps ? double(stepNanos - lastStepNanos) / double(steps) : 0.0;
+        realtimeFactor = double(simNanos - lastSimNanos) * 1e-9 / wall;
+        uint64_t frameCount = frames - lastFrames;
+        stepsPerFrame = frameCount ? double(frameSteps - lastFrameSteps) / double(frameCount) : 0.0;
+    }
+
+    lastTime = now;
+    lastMemberSteps = memberSteps;
+    lastStepNanos = stepNanos;
+    lastSimNanos = simNanos;
+    lastFrames = frames;
+    lastFrameSteps = frameSteps;
+    return true;
+}
@@ -0,0 +1,151 @@
+#include <profiler.h>
+
+#include <algorithm>
+
+#include "imgui.h"
+#include "trace.h"
+
+static const ImU32 ZONE_COLORS[] = {
+    IM_COL32(230, 120,  60, 255),
+    IM_COL32( 80, 170, 230, 255),
+    IM_COL32(120, 200,  90, 255),
+    IM_COL32(200,  90, 200, 255),
+    IM_COL32(240, 200,  70, 255),
+    IM_COL32(110, 110, 230, 255),
+};
+
+Profiler::Profiler() : zoneCount(0), next(0), frames(0) {}
+
+int Profiler::AddZone(const char* name, bool isGpu) {
+    int zone = zoneCount++;
+    names[zone] = name;
+    gpu[zone] = isGpu;
+    current[zone] = 0.0f;
+    std::fill(history[zone], history[zone] + HISTORY, 0.0f);
+    return zone;
+}
+
+void Profiler::Begin(int zone) {
+    starts[zone] = std::chrono::steady_clock::now();
+#if PENDSIM_TRACE
+    traceStarts[zone] = trace::Now();
+#endif
+}
+
+void Profiler::End(int zone) {
+    std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - starts[zone];
+    current[zone] += elapsed.count();
+#if PENDSIM_TRACE
+    trace::Record(names[zone], traceStarts[zone], trace::Now());
+#endif
+}
+
+void Profiler::Add(int zone, float ms) {
+    current[zone] += ms;
+}
+
+void Profiler::EndFrame() {
+    for (int z = 0; z < zoneCount; z++) {
+        history[z][next] = current[z];
+        current[z] = 0.0f;
+    }
+    next = (next + 1) % HISTORY;
+    frames = std::min(frames + 1, HISTORY);
+}
+
+float Profiler::Latest(int zone) const {
+    return history[zone][(next + HISTORY - 1) % HISTORY];
+}
+
+float Profiler::Percentile(int zone, float p) const {
+    if (frames == 0) return 0.0f;
+
+    float sorted[HISTORY];
+    for (int i = 0; i < frames; i++) {
+        sorted[i] = history[zone][(next + HISTORY - 1 - i) % HISTORY];
+    }
+    int idx = std::min(frames - 1, int(frames * p));
+    std::nth_element(sorted, sorted + idx, sorted + frames);
+    return sorted[idx];
+}
+
+float Profiler::LatestGpuTotal() const {
+    float total = 0.0f;
+    for (int z = 0; z < zoneCount; z++) {
+        if (gpu[z]) total += Latest(z);
+    }
+    return total;
+}
+
+// one stacked bar per frame, oldest on the left
+static void DrawStackedBars(const Profiler& prof, bool gpu, float height) {
+    ImVec2 size(ImGui::GetContentRegionAvail().x, height);
+    ImVec2 origin = ImGui::GetCursorScreenPos();
+    ImDrawList* draw = ImGui::GetWindowDrawList();
+    draw->AddRectFilled(origin, ImVec2(origin.x + size.x, origin.y + size.y), IM_COL32(20, 20, 20, 200));
+
+    // scale to the tallest frame in view, at least one 60 Hz frame
+    float maxMs = 16.6f;
+    for (int i = 0; i < prof.frames; i++) {
+        int slot = (prof.next + Profiler::HISTORY - 1 - i) % Profiler::HISTORY;
+        float total = 0.0f;
+        for (int z = 0; z < prof.zoneCount; z++) {
+            if (prof.gpu[z] == gpu) total += prof.history[z][slot];
+        }
+        maxMs = std::max(maxMs, total);
+    }
+
+    float barWidth = size.x / Profiler::HISTORY;
+    for (int i = 0; i < prof.frames; i++) {
+        int slot = (prof.next + Profiler::HISTORY - 1 - i) % Profiler::HISTORY;
+        float x1 = origin.x + size.x - i * barWidth;
+        float x0 = x1 - barWidth;
+        float y = origin.y + size.y;
+        for (int z = 0; z < prof.zoneCount; z++) {
+            if (prof.gpu[z] != gpu) continue;
+            float h = prof.history[z][slot] / maxMs * size.y;
+            draw->AddRectFilled(ImVec2(x0, y - h), ImVec2(x1, y), ZONE_COLORS[z % IM_ARRAYSIZE(ZONE_COLORS)]);
+            y -= h;
+        }
+    }
+
+    // 60 Hz budget line
+    float budgetY = origin.y + size.y - 16.6f / maxMs * size.y;
+    draw->AddLine(ImVec2(origin.x, budgetY), ImVec2(origin.x + size.x, budgetY), IM_COL32(255, 255, 255, 90));
+
+    ImGui::Dummy(size);
+    ImGui::Text("%s, scale %.1f ms", gpu ? "GPU" : "CPU", maxMs);
+}
+
+void Profiler::Draw(const char* title, bool* open) {
+    if (ImGui::Begin(title, open, ImGuiWindowFlags_AlwaysAutoResize)) {
+        ImGui::Dummy(ImVec2(320, 0));
+        DrawStackedBars(*this, false, 80.0f);
+        DrawStackedBars(*this, true, 60.0f);
+
+        if (ImGui::BeginTable("zones", 5, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit)) {
+            ImGui::TableSetupColumn("zone");
+            ImGui::TableSetupColumn("last");
+            ImGui::TableSetupColumn("p50");
+            ImGui::TableSetupColumn("p95");
+            ImGui::TableSetupColumn("p99");
+            ImGui::TableHeadersRow();
+
+            for (int z = 0; z < zoneCount; z++) {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::TextColored(ImGui::ColorConvertU32ToFloat4(ZONE_COLORS[z % IM_ARRAYSIZE(ZONE_COLORS)]), "%s", names[z]);
+                ImGui::TableNextColumn(); ImGui::Text("%.3f", Latest(z));
+                ImGui::TableNextColumn(); ImGui::Text("%.3f", Percentile(z, 0.50f));
+                ImGui::TableNextColumn(); ImGui::Text("%.3f", Percentile(z, 0.95f));
+                ImGui::TableNextColumn(); ImGui::Text("%.3f", Percentile(z, 0.99f));
+            }
+            ImGui::EndTable();
+        }
+
+#if PENDSIM_TRACE
+        if (ImGui::Button("Write trace.json")) TRACE_FLUSH("trace.json");
+#endif
+    }
+    ImGui::End();
+}
@@ -0,0 +1,77 @@
+#include <qualityGovernor.h>
+
+#include <algorithm>
+
+// Levels trade quality in order of least visible first
+static const QualitySettings LEVELS[QualityGovernor::MAX_LEVEL + 1] = {
+    { 1.0f, 98, true,  1 },
+    { 0.5f, 98, true,  1 },
+    { 0.5f, 48, true,  2 },
+    { 0.5f, 48, false, 2 },
+    { 0.5f, 24, false, 4 },
+    { 0.25f, 16, false, 8 },
+};
+
+static const char* SACRIFICES[QualityGovernor::MAX_LEVEL + 1] = {
+    "nothing",
+    "half-res trails",
+    "half-res trails, 48-segment bobs",
+    "half-res trails, 48-segment bobs, no MSAA",
+    "half-res trails, 24-segment bobs, no MSAA, exposure every 4 frames",
+    "quarter-res trails, 16-segment bobs, no MSAA, exposure every 8 frames",
+};
+
+// wait this long after a change before judging it
+static const int SETTLE_FRAMES = 60;
+// recovering needs a full window comfortably inside the budget
+static const float RECOVER_FRACTION = 0.6f;
+
+QualityGovernor::QualityGovernor(float targetMs) : targetMs(targetMs), level(0) {
+    Reset();
+}
+
+void QualityGovernor::Reset() {
+    count = 0;
+    next = 0;
+    framesSinceChange = 0;
+}
+
+void QualityGovernor::Record(float cpuMs, float gpuMs) {
+    samples[next] = std::max(cpuMs, gpuMs);
+    next = (next + 1) % WINDOW;
+    count = std::min(count + 1, WINDOW);
+    framesSinceChange++;
+
+    if (framesSinceChange < SETTLE_FRAMES) return;
+
+    float p99 = P99();
+    if (p99 > targetMs && level < MAX_LEVEL) {
+        level++;
+        Reset();
+    } else if (count == WINDOW && p99 < targetMs * RECOVER_FRACTION && level > 0) {
+        level--;
+        Reset();
+    }
+}
+
+float QualityGovernor::P99() const {
+    if (count == 0) return 0.0f;
+
+    float sorted[WINDOW];
+    std::copy(samples, samples + count, sorted);
+    int idx = std::min(count - 1, int(count * 0.99f));
+    std::nth_element(sorted, sorted + idx, sorted + count);
+    return sorted[idx];
+}
+
+QualitySettings QualityGovernor::Settings() const {
+    return LEVELS[level];
+}
+
+QualitySettings QualityGovernor::Full() {
+    return LEVELS[0];
+}
+
+const char* QualityGovernor::Sacrificing() const {
+    return SACRIFICES[level];
+}
@@ -0,0 +1,186 @@
+#include <recorder.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "trace.h"
+
+// raw bytes of one chunk aimed for when the caller doesn't choose
+static const size_t TARGET_CHUNK_VALUES = size_t(1) << 22;
+
+// empty polls before the writer sleeps
+static const int IDLE_YIELDS = 64;
+
+Recorder::Recorder() : members(0), chunkSteps(0), file(nullptr), slots(0) {}
+
+Recorder::~Recorder() {
+    Close();
+}
+
+bool Recorder::Open(const char* path, size_t members, float dt, const PendulumParams& p, Integrator integrator,
+                    uint32_t chunkSteps) {
+    Close();
+    if (members == 0) return false;
+
+    file = fopen(path, "wb");
+    if (!file) return false;
+
+    this->members = members;
+    this->chunkSteps = chunkSteps ? chunkSteps
+                                  : uint32_t(std::min<size_t>(4096, std::max<size_t>(16, TARGET_CHUNK_VALUES / members)));
+
+    RecordingHeader header = {};
+    memcpy(header.magic, "PENDREC1", 8);
+    header.version = TRAJECTORY_VERSION;
+    header.members = uint32_t(members);
+    header.chunkSteps = this->chunkSteps;
+    header.integrator = uint32_t(integrator);
+    header.dt = dt;
+    header.params = p;
+    if (fwrite(&header, sizeof(header), 1, file) != 1) {
+        fclose(file);
+        file = nullptr;
+        return false;
+    }
+
+    size_t stepBytes = members * TRAJECTORY_COLUMNS * sizeof(float);
+    slots = std::min<size_t>(1024, std::max<size_t>(4, RING_BYTES / stepBytes));
+    ring.assign(slots * members * TRAJECTORY_COLUMNS, 0.0f);
+    head = 0;
+    tail = 0;
+    closing = false;
+    steps = 0;
+    stalls = 0;
+    fileBytes = sizeof(header);
+    failed = false;
+    index.clear();
+
+    writer = std::thread(&Recorder::WriterLoop, this);
+    return true;
+}
+
+void Recorder::Record(const float* theta1, const float* theta2, const float* omega1, const float* omega2) {
+    if (!file) return;
+
+    uint64_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) == slots) {
+        stalls.fetch_add(1, std::memory_order_relaxed);
+        while (h - tail.load(std::memory_order_acquire) == slots) std::this_thread::yield();
+    }
+
+    // the slot is ours until head moves past it
+    float* dst = &ring[size_t(h % slots) * members * TRAJECTORY_COLUMNS];
+    size_t bytes = members * sizeof(float);
+    memcpy(dst, theta1, bytes);
+    memcpy(dst + members, theta2, bytes);
+    memcpy(dst + 2 * members, omega1, bytes);
+    memcpy(dst + 3 * members, omega2, bytes);
+
+    head.store(h + 1, std::memory_order_release);
+    steps.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Recorder::Record(const Ensemble& e) {
+    Record(e.theta1, e.theta2, e.omega1, e.omega2);
+}
+
+void Recorder::Record(const PendulumState& s) {
+    Record(&s.theta1, &s.theta2, &s.omega1, &s.omega2);
+}
+
+bool Recorder::WriteChunk(ColumnEncoder* encoders, uint32_t chunkLength, uint64_t firstStep) {
+    ChunkHeader header = {};
+    memcpy(header.magic, "CHNK", 4);
+    header.steps = chunkLength;
+    header.firstStep = firstStep;
+    for (int c = 0; c < TRAJECTORY_COLUMNS; c++) header.columnBytes[c] = encoders[c].Finish();
+    index.push_back(ChunkIndexEntry{ firstStep, fileBytes.load(std::memory_order_relaxed) });
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    uint64_t written = sizeof(header);
+    for (int c = 0; c < TRAJECTORY_COLUMNS && ok; c++) {
+        ok = fwrite(encoders[c].words.data(), 1, header.columnBytes[c], file) == header.columnBytes[c];
+        written += header.columnBytes[c];
+    }
+    fileBytes.fetch_add(written, std::memory_order_relaxed);
+    return ok;
+}
+
+bool Recorder::WriteIndex(uint64_t totalSteps) {
+    IndexFooter footer = {};
+    footer.indexOffset = fileBytes.load(std::memory_order_relaxed);
+    footer.chunks = index.size();
+    footer.steps = totalSteps;
+    memcpy(footer.magic, "PENDIDX1", 8);
+
+    size_t indexBytes = index.size() * sizeof(ChunkIndexEntry);
+    bool ok = fwrite(index.data(), 1, indexBytes, file) == indexBytes && fwrite(&footer, sizeof(footer), 1, file) == 1;
+    fileBytes.fetch_add(indexBytes + sizeof(footer), std::memory_order_relaxed);
+    return ok;
+}
+
+void Recorder::WriterLoop() {
+    TRACE_THREAD_NAME("recorder");
+
+    ColumnEncoder encoders[TRAJECTORY_COLUMNS];
+    for (ColumnEncoder& encoder : encoders) encoder.Begin(members);
+    uint32_t step = 0;          // within the current chunk
+    uint64_t firstStep = 0;
+
+    int idle = 0;
+    for (;;) {
+        uint64_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire)) {
+            if (closing.load(std::memory_order_acquire)) {
+                if (t == head.load(std::memory_order_acquire)) break;
+                continue;
+            }
+            // the producer is usually mid-step: give it the core before
+            // deciding it has gone quiet and sleeping
+            if (++idle < IDLE_YIELDS) {
+                std::this_thread::yield();
+                continue;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        idle = 0;
+
+        {
+            TRACE_ZONE("Encode step");
+            const float* src = &ring[size_t(t % slots) * members * TRAJECTORY_COLUMNS];
+            for (int c = 0; c < TRAJECTORY_COLUMNS; c++) encoders[c].Encode(src + c * members, int(step));
+        }
+        tail.store(t + 1, std::memory_order_release);
+
+        if (++step == chunkSteps) {
+            TRACE_ZONE("Write chunk");
+            if (!WriteChunk(encoders, step, firstStep)) failed = true;
+            for (ColumnEncoder& encoder : encoders) encoder.Begin(members);
+            firstStep += step;
+            step = 0;
+        }
+    }
+
+    if (step > 0 && !WriteChunk(encoders, step, firstStep)) failed = true;
+    if (!WriteIndex(firstStep + step)) failed = true;
+}
+
+bool Recorder::Close() {
+    if (!file) return true;
+
+    closing.store(true, std::memory_order_release);
+    writer.join();
+
+    bool closed = fclose(file) == 0;
+    bool ok = closed && !failed;
+    file = nullptr;
+    ring.clear();
+    ring.shrink_to_fit();
+    return ok;
+}
+
+uint64_t Recorder::RawBytes() const {
+    return sizeof(RecordingHeader) + steps.load(std::memory_order_relaxed) * members * TRAJECTORY_COLUMNS * sizeof(float);
+}
@@ -0,0 +1,405 @@
+#include <scenario.h>
+
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char* PARAM_NAMES[Scenario::PARAMS] = { "rod1", "rod2", "mass1", "mass2", "gravity" };
+static const char* STATE_NAMES[Scenario::STATE_VARS] = { "theta1", "theta2", "omega1", "omega2" };
+static const char* SAMPLING_NAMES[] = { "single", "grid", "cloud", "sobol" };
+static const float DEGREES = float(M_PI) / 180.0f;
+
+// Joe and Kuo's direction numbers (new-joe-kuo-6.21201) for dimensions 2-4;
+// dimension 1 is the van der Corput sequence
+struct SobolPolynomial {
+    int s;
+    uint32_t a;
+    uint32_t m[3];
+};
+static const SobolPolynomial SOBOL_POLYNOMIALS[Scenario::STATE_VARS - 1] = {
+    { 1, 0, { 1, 0, 0 } },
+    { 2, 1, { 1, 3, 0 } },
+    { 3, 1, { 1, 3, 1 } },
+};
+
+const char* Scenario::ParamName(int param) {
+    return PARAM_NAMES[param];
+}
+
+const char* Scenario::StateName(int var) {
+    return STATE_NAMES[var];
+}
+
+static ScenarioValue Fixed(float v) {
+    return ScenarioValue{ v, v, 1, 0.0f };
+}
+
+Scenario::Scenario()
+    : dt(0.005f), duration(10.0), integrator(Integrator::SemiImplicitEuler), kernel(Kernel::Simd), threads(1),
+      batch(size_t(1) << 20), sampling(Sampling::Single), members(1), seed(1) {
+    params[0] = Fixed(0.3f);
+    params[1] = Fixed(0.3f);
+    params[2] = Fixed(0.1f);
+    params[3] = Fixed(0.1f);
+    params[4] = Fixed(9.81f);
+    for (ScenarioValue& v : state) v = Fixed(0.0f);
+    output[0] = '\0';
+    memset(sobol, 0, sizeof(sobol));
+}
+
+// --- parsing: pointers into the caller's text, nothing allocated ---
+
+struct Token {
+    const char* begin;
+    const char* end;
+
+    bool Is(const char* s) const { return size_t(end - begin) == strlen(s) && memcmp(begin, s, end - begin) == 0; }
+    int Length() const { return int(end - begin); }
+};
+
+static bool IsSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static bool ParseNumber(const char* begin, const char* end, double& value) {
+    if (begin < end && *begin == '+') begin++;
+    auto result = std::from_chars(begin, end, value);
+    return result.ec == std::errc() && result.ptr == end;
+}
+
+static bool ParseCount(Token t, uint64_t& value) {
+    // counts may be written 1e9
+    double v;
+    if (!ParseNumber(t.begin, t.end, v) || v < 0.0 || v > 1.8e19 || v != std::floor(v)) return false;
+    value = uint64_t(v);
+    return true;
+}
+
+// "v", "v~sigma", "from:to" or "from:to:count"
+static bool ParseValue(Token t, ScenarioValue& value, bool allowSigma) {
+    const char* tilde = static_cast<const char*>(memchr(t.begin, '~', t.Length()));
+    const char* colon = static_cast<const char*>(memchr(t.begin, ':', t.Length()));
+    double from, to, sigma;
+
+    if (tilde) {
+        if (!allowSigma || !ParseNumber(t.begin, tilde, from) || !ParseNumber(tilde + 1, t.end, sigma) || sigma < 0.0) {
+            return false;
+        }
+        value = ScenarioValue{ float(from), float(from), 1, float(sigma) };
+        return true;
+    }
+    if (!colon) {
+        if (!ParseNumber(t.begin, t.end, from)) return false;
+        value = Fixed(float(from));
+        return true;
+    }
+
+    const char* colon2 = static_cast<const char*>(memchr(colon + 1, ':', t.end - colon - 1));
+    uint64_t count = 0;
+    if (!ParseNumber(t.begin, colon, from) || !ParseNumber(colon + 1, colon2 ? colon2 : t.end, to)) return false;
+    if (colon2 && (!ParseCount(Token{ colon2 + 1, t.end }, count) || count == 0 || count > UINT32_MAX)) return false;
+    value = ScenarioValue{ float(from), float(to), uint32_t(count), 0.0f };
+    return true;
+}
+
+static void Fail(char* error, size_t errorSize, int line, const char* what, Token t) {
+    if (line > 0) snprintf(error, errorSize, "line %d: %s '%.*s'", line, what, t.Length(), t.begin);
+    else snprintf(error, errorSize, "%s", what);
+}
+
+bool Scenario::Parse(const char* text, size_t length, char* error, size_t errorSize) {
+    const char* p = text;
+    const char* end = text + length;
+    int line = 0;
+
+    while (p < end) {
+        line++;
+        const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+        if (!eol) eol = end;
+        const char* hash = static_cast<const char*>(memchr(p, '#', eol - p));
+        const char* stop = hash ? hash : eol;
+
+        // key, then the value up to trailing space
+        while (p < stop && IsSpace(*p)) p++;
+        Token key{ p, p };
+        while (key.end < stop && !IsSpace(*key.end)) key.end++;
+        Token value{ key.end, stop };
+        while (value.begin < value.end && IsSpace(*value.begin)) value.begin++;
+        while (value.end > value.begin && IsSpace(value.end[-1])) value.end--;
+        p = eol + 1;
+
+        if (key.begin == key.end) continue;
+        if (value.begin == value.end) {
+            Fail(error, errorSize, line, "missing value for", key);
+            return false;
+        }
+
+        bool ok = true;
+        double number;
+        uint64_t count;
+        char name[32];
+        int n = value.Length() < int(sizeof(name)) ? value.Length() : int(sizeof(name)) - 1;
+        memcpy(name, value.begin, n);
+        name[n] = '\0';
+
+        int param = -1, var = -1;
+        for (int i = 0; i < PARAMS; i++) if (key.Is(PARAM_NAMES[i])) param = i;
+        for (int i = 0; i < STATE_VARS; i++) if (key.Is(STATE_NAMES[i])) var = i;
+
+        if (param >= 0) {
+            ok = ParseValue(value, params[param], false);
+            // rods and masses, like --rod1 and friends, must stay positive
+            if (ok && param < 4) ok = params[param].from > 0.0f && params[param].to > 0.0f;
+        } else if (var >= 0) {
+            ok = ParseValue(value, state[var], true);
+            if (ok && var < 2) {
+                state[var].from *= DEGREES;
+                state[var].to *= DEGREES;
+                state[var].sigma *= DEGREES;
+            }
+        } else if (key.Is("dt")) {
+            ok = ParseNumber(value.begin, value.end, number) && number > 0.0;
+            if (ok) dt = float(number);
+        } else if (key.Is("duration")) {
+            ok = ParseNumber(value.begin, value.end, number) && number >= 0.0;
+            if (ok) duration = number;
+        } else if (key.Is("integrator")) {
+            ok = ParseIntegrator(name, integrator);
+        } else if (key.Is("kernel")) {
+            if (value.Is(KernelName(Kernel::Scalar))) kernel = Kernel::Scalar;
+            else if (value.Is(KernelName(Kernel::Simd))) kernel = Kernel::Simd;
+            else ok = false;
+        } else if (key.Is("threads")) {
+            ok = ParseCount(value, count) && count >= 1 && count <= 1024;
+            if (ok) threads = int(count);
+        } else if (key.Is("batch")) {
+            ok = ParseCount(value, count) && count >= 1;
+            if (ok) batch = size_t(count);
+        } else if (key.Is("members")) {
+            ok = ParseCount(value, count) && count >= 1;
+            if (ok) members = count;
+        } else if (key.Is("seed")) {
+            ok = ParseCount(value, seed);
+        } else if (key.Is("sampling")) {
+            ok = false;
+            for (int i = 0; i < 4; i++) {
+                if (value.Is(SAMPLING_NAMES[i])) {
+                    sampling = Sampling(i);
+                    ok = true;
+                }
+            }
+        } else if (key.Is("output")) {
+            ok = value.Length() < MAX_PATH;
+            if (ok) {
+                memcpy(output, value.begin, value.Length());
+                output[value.Length()] = '\0';
+            }
+        } else {
+            Fail(error, errorSize, line, "unknown key", key);
+            return false;
+        }
+
+        if (!ok) {
+            Fail(error, errorSize, line, "bad value", value);
+            return false;
+        }
+    }
+    return Finish(error, errorSize);
+}
+
+bool Scenario::Load(const char* path, char* error, size_t errorSize) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0) close(fd);
+        snprintf(error, errorSize, "could not open %s", path);
+        return false;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return Parse("", 0, error, errorSize);
+    }
+
+    void* text = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (text == MAP_FAILED) {
+        snprintf(error, errorSize, "could not map %s", path);
+        return false;
+    }
+    bool ok = Parse(static_cast<const char*>(text), size_t(st.st_size), error, errorSize);
+    munmap(text, size_t(st.st_size));
+    return ok;
+}
+
+// checks the combination and works out member counts and Sobol tables
+bool Scenario::Finish(char* error, size_t errorSize) {
+    Token none{ nullptr, nullptr };
+    int ranged = 0;
+    bool sigma = false;
+    for (const ScenarioValue& v : state) {
+        ranged += v.count != 1;
+        sigma |= v.sigma > 0.0f;
+    }
+    uint64_t runs = 1;
+    for (const ScenarioValue& v : params) {
+        if (v.count == 0) {
+            Fail(error, errorSize, 0, "swept parameters need a count (from:to:count)", none);
+            return false;
+        }
+        // Runs() multiplies the counts
+        if (runs > UINT64_MAX / v.count) {
+            Fail(error, errorSize, 0, "too many runs in the sweep", none);
+            return false;
+        }
+        runs *= v.count;
+    }
+
+    switch (sampling) {
+        case Sampling::Single:
+            if (ranged || sigma) {
+                Fail(error, errorSize, 0, "ranges and ~ need sampling grid, cloud or sobol", none);
+                return false;
+            }
+            members = 1;
+            break;
+        case Sampling::Grid:
+            if (sigma) {
+                Fail(error, errorSize, 0, "~ needs sampling cloud", none);
+                return false;
+            }
+            members = 1;
+            for (const ScenarioValue& v : state) {
+                if (v.count == 0 || members > UINT64_MAX / v.count) {
+                    Fail(error, errorSize, 0, "grid axes need a count (from:to:count)", none);
+                    return false;
+                }
+                members *= v.count;
+            }
+            break;
+        case Sampling::Cloud:
+            break;
+        case Sampling::Sobol:
+            if (sigma) {
+                Fail(error, errorSize, 0, "~ needs sampling cloud", none);
+                return false;
+            }
+            // the point index must fit the 32-bit direction numbers
+            if (members >= (uint64_t(1) << SOBOL_BITS)) {
+                Fail(error, errorSize, 0, "sobol is limited to 2^32 - 1 members", none);
+                return false;
+            }
+            break;
+    }
+
+    for (int k = 0; k < SOBOL_BITS; k++) sobol[0][k] = uint32_t(1) << (31 - k);
+    for (int d = 1; d < STATE_VARS; d++) {
+        const SobolPolynomial& poly = SOBOL_POLYNOMIALS[d - 1];
+        uint32_t* v = sobol[d];
+        for (int k = 0; k < SOBOL_BITS; k++) {
+            if (k < poly.s) {
+                v[k] = poly.m[k] << (31 - k);
+                continue;
+            }
+            v[k] = v[k - poly.s] ^ (v[k - poly.s] >> poly.s);
+            for (int j = 1; j < poly.s; j++) {
+                if ((poly.a >> (poly.s - 1 - j)) & 1) v[k] ^= v[k - j];
+            }
+        }
+    }
+    return true;
+}
+
+// --- expansion ---
+
+uint64_t Scenario::Runs() const {
+    uint64_t runs = 1;
+    for (const ScenarioValue& v : params) runs *= v.count;
+    return runs;
+}
+
+static float Lerp(const ScenarioValue& v, uint64_t k) {
+    if (v.count <= 1) return v.from;
+    return v.from + (v.to - v.from) * float(double(k) / double(v.count - 1));
+}
+
+PendulumParams Scenario::Params(uint64_t run) const {
+    // the first swept parameter varies fastest
+    float p[PARAMS];
+    for (int i = 0; i < PARAMS; i++) {
+        p[i] = Lerp(params[i], run % params[i].count);
+        run /= params[i].count;
+    }
+    return PendulumParams{ p[0], p[1], p[2], p[3], p[4] };
+}
+
+// counter-based: any member's numbers without generating the ones before it
+static uint64_t Mix(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+// in (0, 1)
+static double Uniform(uint64_t seed, uint64_t i, int stream) {
+    uint64_t h = Mix(Mix(seed) ^ Mix(i * 8 + uint64_t(stream)));
+    return (double(h >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+PendulumState Scenario::Member(uint64_t i) const {
+    float v[STATE_VARS];
+    uint64_t rest = i;
+    int dim = 0;
+
+    for (int d = 0; d < STATE_VARS; d++) {
+        const ScenarioValue& s = state[d];
+        switch (sampling) {
+            case Sampling::Single:
+                v[d] = s.from;
+                break;
+            case Sampling::Grid:
+                // theta1 varies fastest
+                v[d] = Lerp(s, rest % s.count);
+                rest /= s.count;
+                break;
+            case Sampling::Cloud:
+                if (s.sigma > 0.0f) {
+                    // Box-Muller
+                    double r = std::sqrt(-2.0 * std::log(Uniform(seed, i, 2 * d)));
+                    v[d] = s.from + s.sigma * float(r * std::cos(2.0 * M_PI * Uniform(seed, i, 2 * d + 1)));
+                } else if (s.count != 1) {
+                    v[d] = s.from + (s.to - s.from) * float(Uniform(seed, i, 2 * d));
+                } else {
+                    v[d] = s.from;
+                }
+                break;
+            case Sampling::Sobol:
+                if (s.count != 1) {
+                    // point i + 1: point 0 is the corner of the box
+                    uint32_t x = 0;
+                    uint64_t n = i + 1;
+                    for (int k = 0; n; k++, n >>= 1) {
+                        if (n & 1) x ^= sobol[dim][k];
+                    }
+                    dim++;
+                    v[d] = s.from + (s.to - s.from) * float(x * (1.0 / 4294967296.0));
+                } else {
+                    v[d] = s.from;
+                }
+                break;
+        }
+    }
+    return PendulumState{ v[0], v[1], v[2], v[3] };
+}
+
+void Scenario::Fill(Ensemble& e, uint64_t first, size_t count) const {
+    for (size_t m = 0; m < e.size; m++) {
+        e.Set(m, m < count ? Member(first + m) : PendulumState{ 0.0f, 0.0f, 0.0f, 0.0f });
+    }
+}
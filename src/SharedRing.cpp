@@ -0,0 +1,201 @@
+#include <sharedRing.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+static const size_t HEADER_BYTES = 4096;
+
+static_assert(sizeof(SharedRingHeader) <= HEADER_BYTES, "header must fit its page");
+static_assert(sizeof(SharedSlot) == 64, "columns start one cache line into a slot");
+
+static size_t SlotBytes(size_t members) {
+    size_t bytes = sizeof(SharedSlot) + 4 * members * sizeof(float);
+    return (bytes + 63) / 64 * 64;
+}
+
+SharedRing::SharedRing() : header(nullptr), mappedBytes(0), next(0) {
+    name[0] = '\0';
+}
+
+SharedRing::~SharedRing() {
+    Close();
+}
+
+bool SharedRing::Create(const char* shmName, size_t members, uint32_t slots, float dt) {
+    Close();
+    if (members == 0 || (shmName && strlen(shmName) >= MAX_NAME)) return false;
+    size_t slotBytes = SlotBytes(members);
+    if (slots == 0) slots = uint32_t(std::min<size_t>(std::max<size_t>(RING_BYTES / slotBytes, 2), 1024));
+    uint32_t rounded = 1;
+    while (rounded < slots) rounded <<= 1;
+    size_t bytes = HEADER_BYTES + rounded * slotBytes;
+
+    void* mapping = MAP_FAILED;
+    if (!shmName) {
+        mapping = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (mapping == MAP_FAILED) return false;
+    } else {
+        // a fresh object each time: readers of an old one keep their mapping
+        shm_unlink(shmName);
+        int fd = shm_open(shmName, O_CREAT | O_EXCL | O_RDWR, 0644);
+        if (fd < 0) return false;
+        if (ftruncate(fd, off_t(bytes)) == 0) {
+            mapping = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        close(fd);
+        if (mapping == MAP_FAILED) {
+            shm_unlink(shmName);
+            return false;
+        }
+    }
+
+    // new mappings are zero-filled, so every slot starts at sequence 0: not a snapshot
+    header = static_cast<SharedRingHeader*>(mapping);
+    mappedBytes = bytes;
+    header->version = SHARED_RING_VERSION;
+    header->slots = rounded;
+    header->members = members;
+    header->slotBytes = slotBytes;
+    header->dt = dt;
+    // readers check the magic last
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(header->magic, "PENDSHM1", 8);
+
+    strcpy(name, shmName ? shmName : "");
+    next = 0;
+    return true;
+}
+
+SharedSlot* SharedRing::Slot(uint64_t n) const {
+    char* slots = reinterpret_cast<char*>(header) + HEADER_BYTES;
+    return reinterpret_cast<SharedSlot*>(slots + (n & (header->slots - 1)) * header->slotBytes);
+}
+
+float* SharedRing::Begin(uint64_t step, double time, const PendulumParams& p) {
+    SharedSlot* slot = Slot(next);
+    slot->sequence.store(2 * next + 1, std::memory_order_relaxed);
+    // the odd sequence must be visible before any of the new data
+    std::atomic_thread_fence(std::memory_order_release);
+    slot->step = step;
+    slot->time = time;
+    slot->params = p;
+    return reinterpret_cast<float*>(slot + 1);
+}
+
+void SharedRing::End() {
+    Slot(next)->sequence.store(2 * next + 2, std::memory_order_release);
+    next++;
+    header->published.store(next, std::memory_order_release);
+}
+
+void SharedRing::Publish(const Ensemble& e, uint64_t step, double time, const PendulumParams& p) {
+    if (!header || e.size != header->members) return;
+    size_t n = e.size;
+    float* columns = Begin(step, time, p);
+    memcpy(columns, e.theta1, n * sizeof(float));
+    memcpy(columns + n, e.theta2, n * sizeof(float));
+    memcpy(columns + 2 * n, e.omega1, n * sizeof(float));
+    memcpy(columns + 3 * n, e.omega2, n * sizeof(float));
+    End();
+}
+
+void SharedRing::Publish(const PendulumState& s, uint64_t step, double time, const PendulumParams& p) {
+    if (!header || header->members != 1) return;
+    float* columns = Begin(step, time, p);
+    columns[0] = s.theta1;
+    columns[1] = s.theta2;
+    columns[2] = s.omega1;
+    columns[3] = s.omega2;
+    End();
+}
+
+void SharedRing::Close() {
+    if (!header) return;
+    header->closed.store(1, std::memory_order_release);
+    munmap(header, mappedBytes);
+    if (name[0]) shm_unlink(name);
+    header = nullptr;
+    mappedBytes = 0;
+    name[0] = '\0';
+}
+
+SharedRingReader::SharedRingReader() : header(nullptr), mappedBytes(0) {}
+
+SharedRingReader::~SharedRingReader() {
+    Close();
+}
+
+bool SharedRingReader::Open(const char* name) {
+    TRACE_ZONE("Open shared ring");
+    Close();
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) return false;
+
+    struct stat st;
+    void* mapping = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && size_t(st.st_size) >= HEADER_BYTES) {
+        mapping = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (mapping == MAP_FAILED) return false;
+
+    // a producer still setting up has no magic yet; the caller retries
+    const SharedRingHeader* h = static_cast<const SharedRingHeader*>(mapping);
+    bool ok = memcmp(h->magic, "PENDSHM1", 8) == 0;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    ok = ok && h->version == SHARED_RING_VERSION && h->slots > 0 && (h->slots & (h->slots - 1)) == 0 &&
+         h->members > 0 && h->slotBytes == SlotBytes(size_t(h->members)) &&
+         HEADER_BYTES + h->slots * h->slotBytes == uint64_t(st.st_size);
+    if (!ok) {
+        munmap(mapping, size_t(st.st_size));
+        return false;
+    }
+    header = h;
+    mappedBytes = size_t(st.st_size);
+    return true;
+}
+
+void SharedRingReader::Attach(const SharedRing& ring) {
+    Close();
+    header = ring.header;
+}
+
+void SharedRingReader::Close() {
+    if (!header) return;
+    if (mappedBytes) munmap(const_cast<SharedRingHeader*>(header), mappedBytes);
+    header = nullptr;
+    mappedBytes = 0;
+}
+
+bool SharedRingReader::Acquire(uint64_t n, SharedView& view) const {
+    const char* slots = reinterpret_cast<const char*>(header) + HEADER_BYTES;
+    const SharedSlot* slot = reinterpret_cast<const SharedSlot*>(slots + (n & (header->slots - 1)) * header->slotBytes);
+    if (slot->sequence.load(std::memory_order_acquire) != 2 * n + 2) return false;
+
+    size_t members = size_t(header->members);
+    const float* columns = reinterpret_cast<const float*>(slot + 1);
+    view.snapshot = n;
+    view.step = slot->step;
+    view.time = slot->time;
+    view.params = slot->params;
+    view.members = members;
+    view.theta1 = columns;
+    view.theta2 = columns + members;
+    view.omega1 = columns + 2 * members;
+    view.omega2 = columns + 3 * members;
+    view.slot = slot;
+    return true;
+}
+
+bool SharedRingReader::Validate(const SharedView& view) const {
+    // every read through the view happens before the second sequence load
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return view.slot->sequence.load(std::memory_order_relaxed) == 2 * view.snapshot + 2;
+}
@@ -0,0 +1,355 @@
+#include <telemetry.h>
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef __linux__
+#include <cerrno>
+#include <climits>
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "trace.h"
+
+static const int STAGED_COLUMNS = 5;   // theta1, theta2, omega1, omega2, energy
+
+TelemetryServer::TelemetryServer()
+    : stopping(false), listenFd(-1), epollFd(-1), members(0), dt(0.0f), cursor(0), stageSteps(0) {}
+
+TelemetryServer::~TelemetryServer() {
+    Stop();
+}
+
+void TelemetryServer::Publish(const Ensemble& e, uint64_t step, double time, const PendulumParams& p) {
+    if (IsRunning()) ring.Publish(e, step, time, p);
+}
+
+void TelemetryServer::Publish(const PendulumState& s, uint64_t step, double time, const PendulumParams& p) {
+    if (IsRunning()) ring.Publish(s, step, time, p);
+}
+
+#ifdef __linux__
+
+bool TelemetryServer::Start(const char* socketPath, size_t memberCount, float stepDt) {
+    Stop();
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (strlen(socketPath) >= sizeof(addr.sun_path) || memberCount > UINT32_MAX) return false;
+    strcpy(addr.sun_path, socketPath);
+    if (!ring.Create(nullptr, memberCount, 0, stepDt)) return false;
+    reader.Attach(ring);
+
+    // a socket file left by a crashed run would make bind fail
+    unlink(socketPath);
+    listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.ptr = nullptr;   // the listening socket
+    bool ok = listenFd >= 0 && epollFd >= 0 && bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+    path = socketPath;
+    ok = ok && listen(listenFd, SOMAXCONN) == 0 && epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event) == 0;
+    if (!ok) {
+        Stop();
+        return false;
+    }
+
+    members = memberCount;
+    dt = stepDt;
+    cursor = 0;
+    stageSteps = std::min<size_t>(std::max<size_t>(STAGE_BYTES / (STAGED_COLUMNS * members * sizeof(float)), 1), 64);
+    stageMemory.assign(stageSteps * STAGED_COLUMNS * members, 0.0f);
+    staged.resize(stageSteps);
+    for (size_t i = 0; i < stageSteps; i++) staged[i].columns = stageMemory.data() + i * STAGED_COLUMNS * members;
+
+    stopping.store(false);
+    thread = std::thread(&TelemetryServer::ServerLoop, this);
+    return true;
+}
+
+void TelemetryServer::Stop() {
+    if (thread.joinable()) {
+        stopping.store(true, std::memory_order_release);
+        thread.join();
+    }
+    while (!clients.empty()) Disconnect(clients.back());
+    if (listenFd >= 0) close(listenFd);
+    if (epollFd >= 0) close(epollFd);
+    listenFd = epollFd = -1;
+    if (!path.empty()) unlink(path.c_str());
+    path.clear();
+    reader.Close();
+    ring.Close();
+}
+
+void TelemetryServer::ServerLoop() {
+    TRACE_THREAD_NAME("telemetry");
+    epoll_event events[64];
+    while (!stopping.load(std::memory_order_acquire)) {
+        // Publish never signals, so with subscribers the ring is polled
+        // every millisecond; without, only the sockets need watching
+        int ready = epoll_wait(epollFd, events, 64, clients.empty() ? 50 : 1);
+        for (int i = 0; i < ready; i++) {
+            Subscriber* s = static_cast<Subscriber*>(events[i].data.ptr);
+            if (!s) {
+                Accept();
+                continue;
+            }
+            bool alive = !(events[i].events & (EPOLLHUP | EPOLLERR));
+            if (alive && (events[i].events & EPOLLIN)) alive = Receive(s);
+            if (alive && (events[i].events & EPOLLOUT)) alive = Flush(s);
+            if (!alive) Disconnect(s);
+        }
+
+        // drain the ring a stage at a time before waiting again
+        size_t count;
+        while ((count = Stage()) > 0 && !stopping.load(std::memory_order_relaxed)) {
+            TRACE_ZONE("Telemetry send");
+            for (size_t i = clients.size(); i-- > 0; ) {
+                if (!Send(clients[i], count)) Disconnect(clients[i]);
+            }
+        }
+    }
+}
+
+void TelemetryServer::Accept() {
+    while (true) {
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return;
+
+        Subscriber* s = new Subscriber();
+        s->fd = fd;
+        s->filter = {};
+        s->members = 0;
+        s->dropped = 0;
+        s->inboxBytes = 0;
+        s->backlogSent = 0;
+        s->writable = false;
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.ptr = s;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+            close(fd);
+            delete s;
+            continue;
+        }
+        clients.push_back(s);
+        subscribers.store(clients.size(), std::memory_order_relaxed);
+        if (onSubscribersChanged) onSubscribersChanged();
+
+        TelemetryHello hello = {};
+        memcpy(hello.magic, "PENDTLM1", 8);
+        hello.version = TELEMETRY_VERSION;
+        hello.members = uint32_t(members);
+        hello.dt = dt;
+        iovec part = { &hello, sizeof(hello) };
+        Queue(s, &part, 1, 0);
+        if (!Flush(s)) Disconnect(s);
+    }
+}
+
+void TelemetryServer::Disconnect(Subscriber* s) {
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, s->fd, nullptr);
+    close(s->fd);
+    clients.erase(std::find(clients.begin(), clients.end(), s));
+    subscribers.store(clients.size(), std::memory_order_relaxed);
+    if (onSubscribersChanged) onSubscribersChanged();
+    delete s;
+}
+
+bool TelemetryServer::Receive(Subscriber* s) {
+    while (true) {
+        ssize_t got = recv(s->fd, s->inbox + s->inboxBytes, sizeof(s->inbox) - s->inboxBytes, 0);
+        if (got == 0) return false;
+        if (got < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        s->inboxBytes += size_t(got);
+        if (s->inboxBytes < sizeof(s->inbox)) continue;
+
+        TelemetrySubscribe& f = s->filter;
+        memcpy(&f, s->inbox, sizeof(f));
+        s->inboxBytes = 0;
+        f.fields &= TELEMETRY_ALL;
+        f.every = std::max<uint32_t>(f.every, 1);
+        f.stride = std::max<uint32_t>(f.stride, 1);
+        uint32_t available = f.first < members ? uint32_t((members - 1 - f.first) / f.stride + 1) : 0;
+        s->members = f.count ? std::min(f.count, available) : available;
+        requests.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// copies new steps out of the ring before the producer can lap them
+size_t TelemetryServer::Stage() {
+    uint64_t published = reader.Published();
+    if (clients.empty()) {
+        cursor = published;
+        return 0;
+    }
+    uint64_t slots = reader.header->slots;
+    if (published - cursor > slots) {
+        stepsLost.fetch_add(published - slots - cursor, std::memory_order_relaxed);
+        cursor = published - slots;
+    }
+
+    bool energy = false;
+    for (Subscriber* s : clients) energy |= (s->filter.fields & TELEMETRY_ENERGY) != 0;
+
+    size_t count = 0;
+    for (; count < stageSteps && cursor < published; cursor++) {
+        SharedView view;
+        Staged& st = staged[count];
+        // the four columns sit back to back in a slot
+        bool ok = reader.Acquire(cursor, view);
+        if (ok) {
+            memcpy(st.columns, view.theta1, 4 * members * sizeof(float));
+            st.step = view.step;
+            st.time = view.time;
+            st.params = view.params;
+            ok = reader.Validate(view);
+        }
+        if (!ok) {
+            stepsLost.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        if (energy) {
+            const float* c = st.columns;
+            for (size_t m = 0; m < members; m++) {
+                PendulumState state{ c[m], c[members + m], c[2 * members + m], c[3 * members + m] };
+                st.columns[4 * members + m] = Energy(state, st.params);
+            }
+        }
+        count++;
+    }
+    return count;
+}
+
+bool TelemetryServer::Send(Subscriber* s, size_t count) {
+    const TelemetrySubscribe& f = s->filter;
+    if (!f.fields) return true;
+    size_t columns = 0;
+    for (int c = 0; c < STAGED_COLUMNS; c++) columns += (f.fields >> c) & 1;
+    bool params = (f.fields & TELEMETRY_PARAMS) != 0;
+    uint32_t frameBytes = uint32_t(sizeof(TelemetryFrame) + columns * s->members * sizeof(float) +
+                                   (params ? sizeof(PendulumParams) : 0));
+    bool contiguous = f.stride == 1;
+
+    s->headers.resize(count);
+    if (!contiguous) s->packed.resize(count * columns * s->members);
+    iov.clear();
+    size_t frames = 0;
+    for (size_t k = 0; k < count; k++) {
+        const Staged& st = staged[k];
+        if (st.step % f.every != 0) continue;
+        if (s->backlog.size() - s->backlogSent > BACKLOG_BYTES) {
+            s->dropped++;
+            framesDropped.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        TelemetryFrame& header = s->headers[frames];
+        header = { frameBytes, f.fields, st.step, st.time, s->members, s->dropped };
+        s->dropped = 0;
+        iov.push_back({ &header, sizeof(header) });
+        size_t column = 0;
+        for (int c = 0; c < STAGED_COLUMNS; c++) {
+            if (!((f.fields >> c) & 1)) continue;
+            const float* src = st.columns + c * members + f.first;
+            if (contiguous) {
+                iov.push_back({ const_cast<float*>(src), s->members * sizeof(float) });
+            } else {
+                float* dst = s->packed.data() + (frames * columns + column) * s->members;
+                for (uint32_t m = 0; m < s->members; m++) dst[m] = src[size_t(m) * f.stride];
+                iov.push_back({ dst, s->members * sizeof(float) });
+            }
+            column++;
+        }
+        if (params) iov.push_back({ const_cast<PendulumParams*>(&st.params), sizeof(PendulumParams) });
+        frames++;
+    }
+    if (frames == 0) return true;
+    framesSent.fetch_add(frames, std::memory_order_relaxed);
+
+    // anything already waiting goes first
+    if (s->backlogSent < s->backlog.size()) {
+        Queue(s, iov.data(), iov.size(), 0);
+        return true;
+    }
+
+    // writev by way of sendmsg, which can say MSG_NOSIGNAL for a reader
+    // that hung up; one call per IOV_MAX pieces, usually one in all
+    size_t done = 0;
+    while (done < iov.size()) {
+        size_t end = std::min<size_t>(iov.size(), done + IOV_MAX);
+        msghdr message = {};
+        message.msg_iov = iov.data() + done;
+        message.msg_iovlen = end - done;
+        ssize_t sent = sendmsg(s->fd, &message, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) return false;
+            sent = 0;
+        }
+        bytesSent.fetch_add(uint64_t(sent), std::memory_order_relaxed);
+        size_t left = size_t(sent);
+        while (done < end && left >= iov[done].iov_len) {
+            left -= iov[done].iov_len;
+            done++;
+        }
+        if (done < end) {
+            // the socket is full: keep the rest until it drains
+            Queue(s, iov.data() + done, iov.size() - done, left);
+            WatchWritable(s, true);
+            return true;
+        }
+    }
+    return true;
+}
+
+bool TelemetryServer::Flush(Subscriber* s) {
+    while (s->backlogSent < s->backlog.size()) {
+        ssize_t sent = send(s->fd, s->backlog.data() + s->backlogSent, s->backlog.size() - s->backlogSent,
+                            MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) return false;
+            WatchWritable(s, true);
+            return true;
+        }
+        bytesSent.fetch_add(uint64_t(sent), std::memory_order_relaxed);
+        s->backlogSent += size_t(sent);
+    }
+    s->backlog.clear();
+    s->backlogSent = 0;
+    WatchWritable(s, false);
+    return true;
+}
+
+void TelemetryServer::Queue(Subscriber* s, const iovec* parts, size_t count, size_t skip) {
+    for (size_t i = 0; i < count; i++) {
+        const char* base = static_cast<const char*>(parts[i].iov_base);
+        s->backlog.insert(s->backlog.end(), base + skip, base + parts[i].iov_len);
+        skip = 0;
+    }
+}
+
+void TelemetryServer::WatchWritable(Subscriber* s, bool writable) {
+    if (s->writable == writable) return;
+    epoll_event event = {};
+    event.events = EPOLLIN | (writable ? uint32_t(EPOLLOUT) : 0u);
+    event.data.ptr = s;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, s->fd, &event);
+    s->writable = writable;
+}
+
+#else
+
+bool TelemetryServer::Start(const char*, size_t, float) {
+    return false;
+}
+
+void TelemetryServer::Stop() {}
+
+#endif
@@ -0,0 +1,40 @@
+#include <texture.h>
+
+Texture::Texture(int width, int height, GLint internalFormat, GLenum format, GLenum type)
+    : width(width), height(height), format(format), type(type) {
+    // Generate the texture and allocate storage
+    glGenTextures(1, &ID);
+    glBindTexture(GL_TEXTURE_2D, ID);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, nullptr);
+
+    // Linear filtering, no wrapping at the edges
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void Texture::Update(const void* data) {
+    // Replace the whole image; rows are tightly packed
+    glBindTexture(GL_TEXTURE_2D, ID);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format, type, data);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void Texture::Bind(GLuint unit) {
+    // Bind the texture to the given texture unit
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, ID);
+}
+
+void Texture::Unbind() {
+    // Unbind the texture
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void Texture::Delete() {
+    // Delete the texture
+    glDeleteTextures(1, &ID);
+}
@@ -0,0 +1,115 @@
+#include <trace.h>
+
+#if PENDSIM_TRACE
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace trace {
+
+struct Event {
+    const char* name;
+    uint64_t start;
+    uint64_t end;
+};
+
+// Events live in fixed-size chunks so a growing buffer never moves events a
+// reader might be looking at. Only the owning thread writes; count is
+// published with release so Flush sees complete events only.
+static const int CHUNK_EVENTS = 1 << 16;
+static const int MAX_CHUNKS = 64;     // ~4M events per thread, then drop
+
+struct ThreadBuffer {
+    int tid;
+    std::atomic<const char*> name{nullptr};
+    std::atomic<Event*> chunks[MAX_CHUNKS] = {};
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> dropped{0};   // past MAX_CHUNKS or out of memory
+};
+
+static std::mutex registryMutex;
+static std::vector<ThreadBuffer*> registry;   // buffers are never freed
+
+static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+static ThreadBuffer* LocalBuffer() {
+    thread_local ThreadBuffer* buffer = nullptr;
+    if (!buffer) {
+        buffer = new ThreadBuffer();
+        std::lock_guard<std::mutex> lock(registryMutex);
+        buffer->tid = int(registry.size());
+        registry.push_back(buffer);
+    }
+    return buffer;
+}
+
+uint64_t Now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void Record(const char* name, uint64_t start, uint64_t end) {
+    ThreadBuffer* buffer = LocalBuffer();
+    uint64_t n = buffer->count.load(std::memory_order_relaxed);
+    uint64_t chunk = n / CHUNK_EVENTS;
+    Event* events = chunk < MAX_CHUNKS ? buffer->chunks[chunk].load(std::memory_order_relaxed) : nullptr;
+    if (!events && chunk < MAX_CHUNKS) {
+        events = new (std::nothrow) Event[CHUNK_EVENTS];
+        if (events) buffer->chunks[chunk].store(events, std::memory_order_release);
+    }
+    if (!events) {
+        buffer->dropped.store(buffer->dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+    }
+    events[n % CHUNK_EVENTS] = Event{ name, start, end };
+    buffer->count.store(n + 1, std::memory_order_release);
+}
+
+void SetThreadName(const char* name) {
+    LocalBuffer()->name.store(name, std::memory_order_release);
+}
+
+bool Flush(const char* path) {
+    FILE* out = fopen(path, "w");
+    if (!out) return false;
+
+    std::vector<ThreadBuffer*> buffers;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        buffers = registry;
+    }
+
+    fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    bool first = true;
+    uint64_t dropped = 0;
+    for (ThreadBuffer* buffer : buffers) {
+        dropped += buffer->dropped.load(std::memory_order_relaxed);
+        const char* name = buffer->name.load(std::memory_order_acquire);
+        if (name) {
+            fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                    first ? "" : ",\n", buffer->tid, name);
+            first = false;
+        }
+
+        uint64_t n = buffer->count.load(std::memory_order_acquire);
+        for (uint64_t i = 0; i < n; i++) {
+            const Event& e = buffer->chunks[i / CHUNK_EVENTS].load(std::memory_order_acquire)[i % CHUNK_EVENTS];
+            // Chrome trace timestamps are microseconds
+            fprintf(out, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                    first ? "" : ",\n", e.name, buffer->tid, e.start * 1e-3, (e.end - e.start) * 1e-3);
+            first = false;
+        }
+    }
+    // a truncated trace says so, in the file and on the console
+    fprintf(out, "\n],\"otherData\":{\"droppedEvents\":%llu}}\n", (unsigned long long)dropped);
+    if (dropped) fprintf(stderr, "trace: %llu events dropped, %s is incomplete\n", (unsigned long long)dropped, path);
+
+    return fclose(out) == 0;
+}
+
+}
+
+#endif
@@ -0,0 +1,157 @@
+#include <trajectoryFormat.h>
+
+#include <cstring>
+
+static uint32_t Bits(float f) {
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    return u;
+}
+
+static float Float(uint32_t u) {
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+static int BitWidth(uint32_t x) {
+    int n = 0;
+    while (x) {
+        x >>= 1;
+        n++;
+    }
+    return n;
+}
+
+// a wasted bit or two in the previous width is cheaper than a new header
+static const int MAX_WIDTH_WASTE = 5;
+
+// polynomial extrapolation of as much history as the chunk has; unsigned
+// arithmetic wraps, and the decoder wraps the same way
+static uint32_t Predict(const SeriesState& s, int step) {
+    const uint32_t* p = s.prev;
+    switch (step) {
+        case 0: return 0;
+        case 1: return p[0];
+        case 2: return 2 * p[0] - p[1];
+        case 3: return 3 * p[0] - 3 * p[1] + p[2];
+        default: return 4 * p[0] - 6 * p[1] + 4 * p[2] - p[3];
+    }
+}
+
+static void Push(SeriesState& s, uint32_t v) {
+    s.prev[3] = s.prev[2];
+    s.prev[2] = s.prev[1];
+    s.prev[1] = s.prev[0];
+    s.prev[0] = v;
+}
+
+static void ResetSeries(std::vector<SeriesState>& series, size_t members) {
+    series.assign(members, SeriesState{ { 0, 0, 0, 0 }, 0 });
+}
+
+void ColumnEncoder::Begin(size_t members) {
+    words.clear();
+    acc = 0;
+    bits = 0;
+    ResetSeries(series, members);
+}
+
+// n <= 32
+void ColumnEncoder::Put(uint64_t value, int n) {
+    if (bits + n < 64) {
+        acc = (acc << n) | value;
+        bits += n;
+        return;
+    }
+    int first = 64 - bits;
+    int rest = n - first;
+    words.push_back((acc << first) | (value >> rest));
+    acc = rest ? value & ((uint64_t(1) << rest) - 1) : 0;
+    bits = rest;
+}
+
+void ColumnEncoder::Encode(const float* values, int step) {
+    for (size_t m = 0; m < series.size(); m++) {
+        SeriesState& s = series[m];
+        uint32_t v = Bits(values[m]);
+        uint32_t delta = v - Predict(s, step);
+        uint32_t zigzag = (delta << 1) ^ uint32_t(-int32_t(delta >> 31));
+
+        if (zigzag == 0) {
+            Put(0, 1);
+        } else {
+            int width = BitWidth(zigzag);
+            if (width <= s.width && s.width - width <= MAX_WIDTH_WASTE) {
+                Put(2, 2);
+                Put(zigzag, s.width);
+            } else {
+                Put(3, 2);
+                Put(uint64_t(width - 1), 5);
+                Put(zigzag, width);
+                s.width = uint8_t(width);
+            }
+        }
+        Push(s, v);
+    }
+}
+
+size_t ColumnEncoder::Finish() {
+    if (bits > 0) {
+        words.push_back(acc << (64 - bits));
+        acc = 0;
+        bits = 0;
+    }
+    return words.size() * sizeof(uint64_t);
+}
+
+void ColumnDecoder::Begin(const void* data, size_t bytes, size_t members) {
+    words = static_cast<const uint64_t*>(data);
+    wordCount = bytes / sizeof(uint64_t);
+    next = 0;
+    current = 0;
+    available = 0;
+    overrun = false;
+    ResetSeries(series, members);
+}
+
+// n <= 32
+uint32_t ColumnDecoder::Get(int n) {
+    if (available >= n) {
+        available -= n;
+        return uint32_t((current >> available) & ((uint64_t(1) << n) - 1));
+    }
+
+    int rest = n - available;
+    uint64_t high = available ? (current & ((uint64_t(1) << available) - 1)) << rest : 0;
+    if (next == wordCount) {
+        overrun = true;
+        available = 0;
+        return 0;
+    }
+    current = words[next++];
+    available = 64 - rest;
+    return uint32_t(high | (current >> available));
+}
+
+void ColumnDecoder::Decode(float* values, int step) {
+    for (size_t m = 0; m < series.size(); m++) {
+        SeriesState& s = series[m];
+        uint32_t zigzag = 0;
+
+        if (Get(1)) {
+            if (Get(1) == 0) {
+                if (s.width == 0) overrun = true;
+                zigzag = Get(s.width);
+            } else {
+                s.width = uint8_t(Get(5) + 1);
+                zigzag = Get(s.width);
+            }
+        }
+
+        uint32_t delta = (zigzag >> 1) ^ uint32_t(-int32_t(zigzag & 1));
+        uint32_t v = Predict(s, step) + delta;
+        values[m] = Float(v);
+        Push(s, v);
+    }
+}
@@ -0,0 +1,231 @@
+#include <trajectoryReader.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+static const size_t NO_CHUNK = size_t(-1);
+
+TrajectoryReader::TrajectoryReader()
+    : steps(0), indexed(false), data(nullptr), size(0), chunksEnd(0), access(Access::Random), cachedChunk(NO_CHUNK) {
+    memset(&header, 0, sizeof(header));
+}
+
+TrajectoryReader::~TrajectoryReader() {
+    Close();
+}
+
+bool TrajectoryReader::Open(const char* path) {
+    Close();
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(RecordingHeader)) {
+        close(fd);
+        return false;
+    }
+
+    // the mapping keeps the file alive after the descriptor is closed
+    size = size_t(st.st_size);
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) return false;
+    data = static_cast<const unsigned char*>(mapped);
+
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, "PENDREC1", 8) != 0 || header.version != TRAJECTORY_VERSION || header.members == 0 ||
+        header.chunkSteps == 0) {
+        Close();
+        return false;
+    }
+
+    if (!BuildIndex()) {
+        Close();
+        return false;
+    }
+    Advise(Access::Random);
+    return true;
+}
+
+void TrajectoryReader::Close() {
+    if (data) munmap(const_cast<unsigned char*>(data), size);
+    data = nullptr;
+    size = 0;
+    chunksEnd = 0;
+    steps = 0;
+    index.clear();
+    cachedChunk = NO_CHUNK;
+    for (std::vector<float>& column : decoded) {
+        column.clear();
+        column.shrink_to_fit();
+    }
+}
+
+// The footer index of a closed recording is read after checking that it
+// fits the file and describes chunks in order, each no longer than
+// chunkSteps; a footer that doesn't is corruption and fails the open. A
+// recording that was never closed (still running, or crashed) has no
+// footer, so the chunk headers are walked instead, stopping at the first
+// incomplete chunk.
+bool TrajectoryReader::BuildIndex() {
+    index.clear();
+
+    IndexFooter footer;
+    if (size >= sizeof(RecordingHeader) + sizeof(footer)) {
+        memcpy(&footer, data + size - sizeof(footer), sizeof(footer));
+        if (memcmp(footer.magic, "PENDIDX1", 8) == 0) {
+            // every chunk takes at least a header, which bounds the count
+            uint64_t room = size - sizeof(RecordingHeader) - sizeof(footer);
+            if (footer.chunks > room / (sizeof(ChunkHeader) + sizeof(ChunkIndexEntry))) return false;
+            uint64_t indexBytes = footer.chunks * sizeof(ChunkIndexEntry);
+            if (footer.indexOffset < sizeof(RecordingHeader) || footer.indexOffset != size - sizeof(footer) - indexBytes) {
+                return false;
+            }
+            index.resize(footer.chunks);
+            memcpy(index.data(), data + footer.indexOffset, indexBytes);
+
+            uint64_t minOffset = sizeof(RecordingHeader);
+            for (size_t i = 0; i < index.size(); i++) {
+                const ChunkIndexEntry& entry = index[i];
+                uint64_t previous = i == 0 ? 0 : index[i - 1].firstStep;
+                bool ordered = i == 0 ? entry.firstStep == 0
+                                      : entry.firstStep > previous && entry.firstStep - previous <= header.chunkSteps;
+                bool inside = entry.offset >= minOffset && entry.offset <= footer.indexOffset - sizeof(ChunkHeader);
+                if (!ordered || !inside) return false;
+                minOffset = entry.offset + sizeof(ChunkHeader);
+            }
+            uint64_t lastFirst = index.empty() ? 0 : index.back().firstStep;
+            bool stepsFit = index.empty() ? footer.steps == 0
+                                          : footer.steps > lastFirst && footer.steps - lastFirst <= header.chunkSteps;
+            if (!stepsFit) return false;
+            steps = footer.steps;
+            chunksEnd = footer.indexOffset;
+            indexed = true;
+            return true;
+        }
+    }
+
+    TRACE_ZONE("Rebuild index");
+    indexed = false;
+    steps = 0;
+    uint64_t offset = sizeof(RecordingHeader);
+    while (offset + sizeof(ChunkHeader) <= size) {
+        ChunkHeader chunk;
+        memcpy(&chunk, data + offset, sizeof(chunk));
+        if (memcmp(chunk.magic, "CHNK", 4) != 0 || chunk.firstStep != steps || chunk.steps == 0 ||
+            chunk.steps > header.chunkSteps) {
+            break;
+        }
+
+        uint64_t end = offset + sizeof(chunk);
+        bool fits = true;
+        for (uint64_t bytes : chunk.columnBytes) {
+            fits &= bytes <= size - end;
+            if (fits) end += bytes;
+        }
+        if (!fits) break;
+
+        index.push_back(ChunkIndexEntry{ chunk.firstStep, offset });
+        steps += chunk.steps;
+        offset = end;
+    }
+    chunksEnd = offset;
+    return true;
+}
+
+// the most a chunk's data may take: up to the next chunk, or the index
+uint64_t TrajectoryReader::ChunkEnd(size_t chunk) const {
+    return chunk + 1 < index.size() ? index[chunk + 1].offset : chunksEnd;
+}
+
+size_t TrajectoryReader::FindChunk(uint64_t step) const {
+    // last chunk starting at or before step
+    auto it = std::upper_bound(index.begin(), index.end(), step,
+                               [](uint64_t s, const ChunkIndexEntry& e) { return s < e.firstStep; });
+    return it == index.begin() ? NO_CHUNK : size_t(it - index.begin()) - 1;
+}
+
+// madvise wants page-aligned ranges
+void TrajectoryReader::AdviseRange(uint64_t begin, uint64_t end, int advice) {
+    uint64_t page = uint64_t(sysconf(_SC_PAGESIZE));
+    begin = begin / page * page;
+    end = std::min<uint64_t>(size, end);
+    if (end > begin) madvise(const_cast<unsigned char*>(data) + begin, end - begin, advice);
+}
+
+void TrajectoryReader::Advise(Access access) {
+    this->access = access;
+    if (data) AdviseRange(0, size, access == Access::Sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+}
+
+bool TrajectoryReader::Load(size_t chunk) {
+    if (chunk == cachedChunk) return true;
+    if (chunk >= index.size()) return false;
+    TRACE_ZONE("Decode chunk");
+
+    // the header must agree with the index: its steps, and columns that
+    // stay inside its slot of the file
+    const ChunkIndexEntry& entry = index[chunk];
+    uint64_t end = ChunkEnd(chunk);
+    ChunkHeader h;
+    memcpy(&h, data + entry.offset, sizeof(h));
+    uint64_t wantSteps = (chunk + 1 < index.size() ? index[chunk + 1].firstStep : steps) - entry.firstStep;
+    if (memcmp(h.magic, "CHNK", 4) != 0 || h.firstStep != entry.firstStep || h.steps != wantSteps) return false;
+    uint64_t columnsEnd = entry.offset + sizeof(h);
+    for (uint64_t bytes : h.columnBytes) {
+        if (bytes > end - columnsEnd) return false;
+        columnsEnd += bytes;
+    }
+    size_t members = header.members;
+
+    if (access == Access::Sequential) {
+        // the chunk we are leaving won't be read again soon; the next will
+        if (cachedChunk != NO_CHUNK) AdviseRange(index[cachedChunk].offset, ChunkEnd(cachedChunk), MADV_DONTNEED);
+        if (chunk + 1 < index.size()) AdviseRange(index[chunk + 1].offset, ChunkEnd(chunk + 1), MADV_WILLNEED);
+    }
+
+    uint64_t offset = entry.offset + sizeof(h);
+    bool ok = true;
+    for (int c = 0; c < TRAJECTORY_COLUMNS; c++) {
+        decoded[c].resize(size_t(h.steps) * members);
+        ColumnDecoder decoder;
+        decoder.Begin(data + offset, h.columnBytes[c], members);
+        for (uint32_t s = 0; s < h.steps; s++) decoder.Decode(&decoded[c][s * members], int(s));
+        ok &= !decoder.overrun;
+        offset += h.columnBytes[c];
+    }
+
+    cachedChunk = ok ? chunk : NO_CHUNK;
+    return ok;
+}
+
+bool TrajectoryReader::Read(uint64_t step, size_t member, PendulumState& s) {
+    if (!data || step >= steps || member >= header.members) return false;
+
+    size_t chunk = FindChunk(step);
+    if (!Load(chunk)) return false;
+
+    size_t i = size_t(step - index[chunk].firstStep) * header.members + member;
+    s = PendulumState{ decoded[0][i], decoded[1][i], decoded[2][i], decoded[3][i] };
+    return true;
+}
+
+bool TrajectoryReader::ReadStep(uint64_t step, float* theta1, float* theta2, float* omega1, float* omega2) {
+    if (!data || step >= steps) return false;
+
+    size_t chunk = FindChunk(step);
+    if (!Load(chunk)) return false;
+
+    size_t members = header.members;
+    size_t first = size_t(step - index[chunk].firstStep) * members;
+    float* out[TRAJECTORY_COLUMNS] = { theta1, theta2, omega1, omega2 };
+    for (int c = 0; c < TRAJECTORY_COLUMNS; c++) memcpy(out[c], &decoded[c][first], members * sizeof(float));
+    return true;
+}
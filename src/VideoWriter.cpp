@@ -0,0 +1,177 @@
+#include <videoWriter.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "trace.h"
+
+// empty polls before the writer sleeps
+static const int IDLE_YIELDS = 64;
+
+static const char FRAME_TAG[] = "FRAME\n";
+static const size_t FRAME_TAG_BYTES = sizeof(FRAME_TAG) - 1;
+
+// Integer BT.601 in 8.8 fixed point. The loops below have no branches or
+// clamps (the coefficients can't overflow a byte) so they auto-vectorize
+// to whatever -march allows, 16 to 64 pixels at a time.
+static void LumaRow(const uint8_t* rgba, uint8_t* y, int width) {
+    for (int x = 0; x < width; x++) {
+        int r = rgba[4 * x], g = rgba[4 * x + 1], b = rgba[4 * x + 2];
+        y[x] = uint8_t(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+    }
+}
+
+// one chroma row from two image rows; sums of four pixels keep a 10-bit
+// shift, and the offset keeps the sum positive so the shift is exact
+static void ChromaRow(const uint8_t* top, const uint8_t* bottom, uint8_t* u, uint8_t* v, int chromaWidth) {
+    for (int x = 0; x < chromaWidth; x++) {
+        const uint8_t* a = top + 8 * x;
+        const uint8_t* b = bottom + 8 * x;
+        int r = a[0] + a[4] + b[0] + b[4];
+        int g = a[1] + a[5] + b[1] + b[5];
+        int bl = a[2] + a[6] + b[2] + b[6];
+        u[x] = uint8_t((-38 * r - 74 * g + 112 * bl + (128 << 10) + 512) >> 10);
+        v[x] = uint8_t((112 * r - 94 * g - 18 * bl + (128 << 10) + 512) >> 10);
+    }
+}
+
+void RgbaToYuv420(const uint8_t* rgba, ptrdiff_t stride, int width, int height, uint8_t* y, uint8_t* u, uint8_t* v) {
+    int chromaWidth = width / 2;
+    for (int row = 0; row < height; row += 2) {
+        const uint8_t* top = rgba + row * stride;
+        const uint8_t* bottom = top + stride;
+        LumaRow(top, y + size_t(row) * width, width);
+        LumaRow(bottom, y + size_t(row + 1) * width, width);
+        size_t chroma = size_t(row / 2) * chromaWidth;
+        ChromaRow(top, bottom, u + chroma, v + chroma, chromaWidth);
+    }
+}
+
+VideoWriter::VideoWriter() : width(0), height(0), fps(0), file(nullptr), slots(0), frameBytes(0) {}
+
+VideoWriter::~VideoWriter() {
+    Close();
+}
+
+bool VideoWriter::Open(const char* path, int width, int height, int fps, size_t queueFrames) {
+    Close();
+    if (width <= 0 || height <= 0 || width % 2 || height % 2 || fps <= 0) return false;
+
+    file = fopen(path, "wb");
+    if (!file) return false;
+    // every write is a whole frame
+    setvbuf(file, nullptr, _IONBF, 0);
+
+    this->width = width;
+    this->height = height;
+    this->fps = fps;
+    frameBytes = size_t(width) * height * 4;
+    slots = std::max<size_t>(2, queueFrames);
+    ring.assign(slots * frameBytes, 0);
+    planes.resize(FRAME_TAG_BYTES + size_t(width) * height * 3 / 2);
+    memcpy(planes.data(), FRAME_TAG, FRAME_TAG_BYTES);
+
+    head = 0;
+    tail = 0;
+    closing = false;
+    offered = 0;
+    written = 0;
+    dropped = 0;
+    stalls = 0;
+    fileBytes = 0;
+    failed = false;
+
+    // 420jpeg: chroma sited between the four luma samples it averages
+    char header[128];
+    int n = snprintf(header, sizeof(header), "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height, fps);
+    if (fwrite(header, 1, size_t(n), file) == size_t(n)) fileBytes = uint64_t(n);
+    else failed = true;
+
+    writer = std::thread(&VideoWriter::WriterLoop, this);
+    return true;
+}
+
+bool VideoWriter::Push(const uint8_t* rgba, ptrdiff_t stride, bool wait) {
+    if (!file) return false;
+    offered.fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) == slots) {
+        if (!wait) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        stalls.fetch_add(1, std::memory_order_relaxed);
+        while (h - tail.load(std::memory_order_acquire) == slots) std::this_thread::yield();
+    }
+
+    // the slot is ours until head moves past it; stored top row first
+    uint8_t* dst = &ring[size_t(h % slots) * frameBytes];
+    size_t rowBytes = size_t(width) * 4;
+    if (stride == ptrdiff_t(rowBytes)) {
+        memcpy(dst, rgba, frameBytes);
+    } else {
+        for (int row = 0; row < height; row++) memcpy(dst + row * rowBytes, rgba + row * stride, rowBytes);
+    }
+    head.store(h + 1, std::memory_order_release);
+    return true;
+}
+
+void VideoWriter::WriteFrame(const uint8_t* rgba) {
+    uint8_t* y = planes.data() + FRAME_TAG_BYTES;
+    uint8_t* u = y + size_t(width) * height;
+    uint8_t* v = u + size_t(width) * height / 4;
+    {
+        TRACE_ZONE("Video convert");
+        RgbaToYuv420(rgba, ptrdiff_t(width) * 4, width, height, y, u, v);
+    }
+    TRACE_ZONE("Video write");
+    // after a failure keep draining so a waiting producer is released
+    if (failed) return;
+    if (fwrite(planes.data(), 1, planes.size(), file) == planes.size()) fileBytes.fetch_add(planes.size(), std::memory_order_relaxed);
+    else failed = true;
+}
+
+void VideoWriter::WriterLoop() {
+    TRACE_THREAD_NAME("video");
+
+    int idle = 0;
+    for (;;) {
+        uint64_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire)) {
+            if (closing.load(std::memory_order_acquire)) {
+                if (t == head.load(std::memory_order_acquire)) break;
+                continue;
+            }
+            // at most one frame per rendered frame: yield briefly, then sleep
+            if (++idle < IDLE_YIELDS) {
+                std::this_thread::yield();
+                continue;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        idle = 0;
+
+        WriteFrame(&ring[size_t(t % slots) * frameBytes]);
+        tail.store(t + 1, std::memory_order_release);
+        written.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+bool VideoWriter::Close() {
+    if (!file) return true;
+
+    closing.store(true, std::memory_order_release);
+    writer.join();
+
+    bool closed = fclose(file) == 0;
+    bool ok = closed && !failed;
+    file = nullptr;
+    ring.clear();
+    ring.shrink_to_fit();
+    planes.clear();
+    planes.shrink_to_fit();
+    return ok;
+}
@@ -0,0 +1,15 @@
+// pendsim-batch: batch mode without the app, for machines with no display
+// or GL libraries. Takes the same flags as pendsim --batch.
+
+#include <vector>
+
+#include "batch.h"
+
+int main(int argc, char** argv) {
+    // BatchMain reads its flags after a leading --batch
+    std::vector<char*> args(argv, argv + argc);
+    static char batchFlag[] = "--batch";
+    if (!IsBatchRun(argc, argv)) args.insert(args.begin() + 1, batchFlag);
+    args.push_back(nullptr);
+    return BatchMain(int(args.size()) - 1, args.data());
+}
@@ -5,6 +5,11 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
@@ -14,10 +19,31 @@
 #include "vbo.h"
 #include "ebo.h"
 #include "shaderClass.h"
+#include "texture.h"
+#include "densityMap.h"
+#include "fbo.h"
+#include "pendulum.h"
+#include "gpuTimer.h"
+#include "qualityGovernor.h"
+#include "profiler.h"
+#include "histogram.h"
+#include "physicsStats.h"
+#include "recorder.h"
+#include "trajectoryReader.h"
+#include "exporter.h"
+#include "batch.h"
+#include "scenario.h"
+#include "checkpoint.h"
+#include "sharedRing.h"
+#include "telemetry.h"
+#include "journal.h"
+#include "videoWriter.h"
+#include "frameCapture.h"
+#include "trace.h"
 
 float h = 0.005f;           // fixed timestep
 float accumulator = 0.0f;
-float prevTime = glfwGetTime();
+float prevTime = 0.0f;        // set once GLFW is up
 
 // mouse dragging vars -- outdated, but kept for reference
 // bool dragging = false;
@@ -29,15 +55,13 @@ int winHeight = 800;
 float mouseX_ndc = 0.0f;
 float mouseY_ndc = 0.0f;
 
-// Pendulum state variables
-float theta1 = 0;   
-float theta2 = 0;
-float angularVelocity = 0.0f;
-float angularVelocity2 = 0.0f;  // Initial velocity
+// Pendulum state: the integrator keeps the last two steps for interpolation
+Pendulum pendulum(PendulumState{ 0.0f, 0.0f, 0.0f, 0.0f });
+PendulumState& state = pendulum.curr;
 
 const float ROD_WIDTH = 0.005;
 const float CIRCLE_RADIUS = 0.02f;
-const float GRAVITY = 9.81f; // m/s^2
+float GRAVITY = 9.81f; // m/s^2
 
 float ROD_LENGTH = 0.3f;
 float ROD_LENGTH2 = 0.3f; // length of rod 2
@@ -45,9 +69,126 @@ float DAMPING = 0.992f; // Damping factor for pendulum motion
 float BOB_MASS = 0.1f;
 float BOB_MASS2 = 0.1f;
 
-// initial angles for reset
 bool paused = false;
-float theta1_init = theta1, theta2_init = theta2;
+
+// what Reset returns to: the --scenario file, or the startup defaults. The
+// app shows one pendulum, so an ensemble scenario contributes its member 0
+// and the first point of any sweep.
+Scenario scenario;
+
+// long exposure: every physics step splats bob 2 into a fixed-size histogram
+bool longExposure = false;
+float exposure = 4.0f;
+const int DENSITY_SIZE = 512;
+DensityMap densityMap(DENSITY_SIZE, DENSITY_SIZE);
+std::vector<float> splatBatch;   // bob 2 positions from this frame's steps
+
+// feedback trails: ping-pong between two textures, fading the previous frame
+bool trails = false;
+float trailDecay = 0.97f;
+Texture* trailTextures[2] = { nullptr, nullptr };
+FBO* trailFBOs[2] = { nullptr, nullptr };
+int trailSrc = 0;
+
+// adaptive quality: trade trails, tessellation and MSAA to hold a p99 budget
+bool adaptiveQuality = true;
+QualityGovernor governor(16.6f);
+QualitySettings quality = governor.Settings();
+int frameCount = 0;
+
+// in-app profiler: CPU zones around each stage, GPU queries around each pass
+bool showProfiler = false;
+Profiler profiler;
+const int ZONE_UI = profiler.AddZone("UI build");
+const int ZONE_PHYSICS = profiler.AddZone("Physics");
+const int ZONE_DRAW = profiler.AddZone("Draw submit");
+const int ZONE_SWAP = profiler.AddZone("Swap");
+const int ZONE_GPU_TRAILS = profiler.AddZone("GPU trails", true);
+const int ZONE_GPU_SCENE = profiler.AddZone("GPU scene", true);
+const int ZONE_GPU_IMGUI = profiler.AddZone("GPU ImGui", true);
+
+// render on demand: while paused, sleep until input or a wake-up arrives
+bool sleepWhenPaused = true;
+const double IDLE_TIMEOUT = 5.0;      // seconds between idle heartbeats
+const int IDLE_REDRAW_FRAMES = 3;     // ImGui needs a few frames to settle after input
+int redrawFrames = IDLE_REDRAW_FRAMES;
+std::atomic<bool> wakeRequested{false};
+
+// whole-run distributions, fixed size however long the app runs
+bool showFrameStats = false;
+Histogram frameHist("frame time", "us", 10000000);
+Histogram physicsHist("physics time", "us", 10000000);
+Histogram stepsHist("steps per frame", "steps", 100000);
+Histogram latencyHist("input to present", "us", 10000000);
+Histogram* const histograms[] = { &frameHist, &physicsHist, &stepsHist, &latencyHist };
+double inputTime = -1.0;    // first input since the last present, or -1
+
+// simulation throughput, fed by whatever steps physics
+PhysicsCounters physicsCounters;
+ThroughputMeter throughput;
+
+// full trajectory recording of the running pendulum
+bool recording = false;
+Recorder recorder;
+const char* RECORDING_PATH = "trajectory.pendrec";
+
+// text export for other tools; the writer thread never holds up physics
+// unless Block is chosen
+bool exporting = false;
+Exporter exporter;
+int exportFormat = int(Exporter::Format::Csv);
+int exportPolicy = int(Exporter::Backpressure::Drop);
+const char* EXPORT_PATHS[] = { "trajectory.csv", "trajectory.ndjson" };
+
+// physics steps and simulated time since startup, for live consumers
+uint64_t liveSteps = 0;
+double liveTime = 0.0;
+
+// live state for other processes on this host, read in place from shared
+// memory
+bool sharing = false;
+SharedRing sharedRing;
+const char* SHARED_NAME = "/pendsim";
+
+// the same over a Unix socket, filtered per subscriber
+bool serving = false;
+TelemetryServer telemetry;
+const char* TELEMETRY_PATH = "pendsim.sock";
+
+// every input the session gets, for exact replay with --batch --replay
+bool journaling = false;
+Journal journal;
+const char* JOURNAL_PATH = "session.pendjournal";
+
+// video of the scene without the UI. Offline capture advances physics by
+// exactly one video frame per rendered frame, with vsync off, so it runs as
+// fast as the GPU and the writer allow and never drops a frame. Real-time
+// capture follows the frame clock instead, skipping or repeating rendered
+// frames so the video plays at CAPTURE_FPS whatever the display rate
+bool capturing = false;
+bool captureOffline = false;
+VideoWriter video;
+const char* VIDEO_PATH = "capture.y4m";
+const int CAPTURE_FPS = 60;
+const int MAX_CAPTURE_REPEAT = CAPTURE_FPS;   // a longer stall is dropped, not filled
+double captureStart = 0.0;                    // frame clock when capture began
+uint64_t captureFrames = 0;                   // video frames due so far (real time)
+
+// playback of a finished recording; the live simulation pauses meanwhile
+bool playback = false;
+bool playing = false;
+TrajectoryReader player;
+double playStep = 0.0;      // fractional while playing in real time
+int playMember = 0;
+
+// the pendulum as a one-member ensemble, plus the long exposure
+const char* CHECKPOINT_PATH = "session.pendckpt";
+
+// safe to call from any thread, e.g. when background results land
+void RequestRedraw() {
+    wakeRequested.store(true, std::memory_order_relaxed);
+    glfwPostEmptyEvent();
+}
 
 // functions to pause on change : one for sliders, one for inputs
 inline bool PauseIf(bool changed, bool& paused) { paused |= changed; return changed; }
@@ -58,6 +199,54 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
     glViewport(0, 0, width, height);
 }
 
+// input callbacks only timestamp; ImGui chains to them after handling the event
+void MarkInput() {
+    if (inputTime < 0.0) inputTime = glfwGetTime();
+}
+void key_callback(GLFWwindow*, int, int, int, int) { MarkInput(); }
+void mouse_button_callback(GLFWwindow*, int, int, int) { MarkInput(); }
+void cursor_pos_callback(GLFWwindow*, double, double) { MarkInput(); }
+void scroll_callback(GLFWwindow*, double, double) { MarkInput(); }
+
+// percentiles of every frame histogram, in ms for the timings
+void DrawFrameStats(bool* open) {
+    if (ImGui::Begin("Frame stats", open, ImGuiWindowFlags_AlwaysAutoResize)) {
+        if (ImGui::BeginTable("histograms", 7, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit)) {
+            ImGui::TableSetupColumn("");
+            ImGui::TableSetupColumn("count");
+            ImGui::TableSetupColumn("p50");
+            ImGui::TableSetupColumn("p90");
+            ImGui::TableSetupColumn("p99");
+            ImGui::TableSetupColumn("p99.9");
+            ImGui::TableSetupColumn("max");
+            ImGui::TableHeadersRow();
+
+            const double PERCENTILES[] = { 0.50, 0.90, 0.99, 0.999 };
+            for (const Histogram* hist : histograms) {
+                double scale = hist == &stepsHist ? 1.0 : 0.001;
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn(); ImGui::Text("%s", hist->name);
+                ImGui::TableNextColumn(); ImGui::Text("%llu", (unsigned long long)hist->total);
+                for (double p : PERCENTILES) {
+                    ImGui::TableNextColumn(); ImGui::Text("%.2f", hist->Percentile(p) * scale);
+                }
+                ImGui::TableNextColumn(); ImGui::Text("%.2f", hist->Percentile(1.0) * scale);
+            }
+            ImGui::EndTable();
+        }
+        ImGui::TextDisabled("times in ms");
+
+        if (ImGui::Button("Reset")) {
+            for (Histogram* hist : histograms) hist->Reset();
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Write histograms.csv")) {
+            if (WriteHistogramsCsv("histograms.csv", histograms, IM_ARRAYSIZE(histograms))) printf("wrote histograms.csv\n");
+        }
+    }
+    ImGui::End();
+}
+
 // --- CREATING SHAPES ---
 GLuint rectIndices[] = {
     0, 1, 2,
@@ -102,8 +291,19 @@ GLuint CircleIndices[NUM_VERTICES + 2];
 VAO* circleVAO = nullptr;
 VBO* circleVBO = nullptr;
 EBO* circleEBO = nullptr;
-
-void SetupCircle() {
+int circleSegments = NUM_VERTICES;
+
+// segments must be at most NUM_VERTICES; rebuilds the buffers if called again
+void SetupCircle(int segments = NUM_VERTICES) {
+    if (circleVAO) {
+        circleVAO->Delete();
+        circleVBO->Delete();
+        circleEBO->Delete();
+        delete circleVAO;
+        delete circleVBO;
+        delete circleEBO;
+    }
+    circleSegments = segments;
     circleVAO = new VAO();
     
     // center vertex at (0, 0, 0)
@@ -111,26 +311,26 @@ void SetupCircle() {
     CircleVertices[1] = 0.0f;  
     CircleVertices[2] = 0.0f;  
 
-    for (int i = 0; i < NUM_VERTICES; ++i) {
-        float theta2 = (2.0 * M_PI * i) / NUM_VERTICES;
+    for (int i = 0; i < segments; ++i) {
+        float theta2 = (2.0 * M_PI * i) / segments;
         int idx = (i + 1) * 3;
         CircleVertices[idx] = cos(theta2) * CIRCLE_RADIUS;          // x
         CircleVertices[idx + 1] = sin(theta2) * CIRCLE_RADIUS;      // y
         CircleVertices[idx + 2] = 0.0f;                             // z
     }
 
-    int lastIdx = (NUM_VERTICES + 1) * 3;
+    int lastIdx = (segments + 1) * 3;
     CircleVertices[lastIdx] = CircleVertices[3];
     CircleVertices[lastIdx + 1] = CircleVertices[4];
     CircleVertices[lastIdx + 2] = CircleVertices[5];
 
     CircleIndices[0] = 0;
-    for (int i = 0; i <= NUM_VERTICES; i++) {
+    for (int i = 0; i <= segments; i++) {
         CircleIndices[i + 1] = i + 1;
     }
 
-    circleVBO = new VBO(CircleVertices, sizeof(CircleVertices));
-    circleEBO = new EBO(CircleIndices, sizeof(CircleIndices));
+    circleVBO = new VBO(CircleVertices, (segments + 2) * 3 * sizeof(GLfloat));
+    circleEBO = new EBO(CircleIndices, (segments + 2) * sizeof(GLuint));
     
     circleVAO->Bind();
     circleVBO->Bind();
@@ -146,52 +346,106 @@ void SetupCircle() {
 
 void DrawCircle() {
     circleVAO->Bind();
-    glDrawElements(GL_TRIANGLE_FAN, NUM_VERTICES + 2, GL_UNSIGNED_INT, 0);
+    glDrawElements(GL_TRIANGLE_FAN, circleSegments + 2, GL_UNSIGNED_INT, 0);
     circleVAO->Unbind();
 }
 
-// --- DONE WITH SHAPE SETUP ---
+// fullscreen quad for image passes (long exposure)
+GLfloat quadVertices[] = {
+    -1.0f, -1.0f, 0.0f,
+     1.0f, -1.0f, 0.0f,
+     1.0f,  1.0f, 0.0f,
+    -1.0f,  1.0f, 0.0f
+};
+VAO* quadVAO = nullptr;
+VBO* quadVBO = nullptr;
+EBO* quadEBO = nullptr;
+
+void SetupQuad() {
+    quadVAO = new VAO();
+    quadVBO = new VBO(quadVertices, sizeof(quadVertices));
+    quadEBO = new EBO(rectIndices, sizeof(rectIndices));
+    quadVAO->Bind();
+    quadVBO->Bind();
+    quadEBO->Bind();
 
-// --- PHYSICS FOR PENDULUM ---
-void UpdatePendulum(float dt) {
-    // intermediate calculations
-    float num1 = -GRAVITY * (2*BOB_MASS+ BOB_MASS2) * sin(theta1);
-    float num2 = -BOB_MASS2 * GRAVITY * sin(theta1 - 2*theta2);
-    float num3 = -2*sin(theta1 - theta2) * BOB_MASS2 *
-                (angularVelocity2*angularVelocity2*ROD_LENGTH2 + angularVelocity*angularVelocity*ROD_LENGTH*cos(theta1 - theta2));
-    float den1 = ROD_LENGTH * (2*BOB_MASS + BOB_MASS2 - BOB_MASS2*cos(2*theta1 - 2*theta2));
-
-    // angular accel for theta1
-    float theta1_ddot = (num1 + num2 + num3) / den1;
-
-    float num4 = 2*sin(theta1 - theta2) *
-                (angularVelocity*angularVelocity*ROD_LENGTH*(BOB_MASS + BOB_MASS2) +
-                GRAVITY*(BOB_MASS + BOB_MASS2)*cos(theta1) +
-                angularVelocity2*angularVelocity2*ROD_LENGTH2*BOB_MASS2*cos(theta1 - theta2));
-    float den2 = ROD_LENGTH2 * (2*BOB_MASS + BOB_MASS2 - BOB_MASS2*cos(2*theta1 - 2*theta2));
-    
-    // angular accel for theta2
-    float theta2_ddot = num4 / den2;
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    quadVAO->Unbind();
+    quadVBO->Unbind();
+    quadEBO->Unbind();
+}
 
+void DrawQuad() {
+    quadVAO->Bind();
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    quadVAO->Unbind();
+}
 
-    // update angular velocities
-    angularVelocity += theta1_ddot * dt;
-    angularVelocity2 += theta2_ddot * dt;
+// (re)create the trail targets at framebuffer size, cleared to black
+void SetupTrails(int width, int height) {
+    for (int i = 0; i < 2; i++) {
+        if (trailFBOs[i]) {
+            trailFBOs[i]->Delete();
+            trailTextures[i]->Delete();
+            delete trailFBOs[i];
+            delete trailTextures[i];
+        }
+        trailTextures[i] = new Texture(width, height, GL_R16F, GL_RED, GL_FLOAT);
+        trailFBOs[i] = new FBO();
+        trailFBOs[i]->AttachTexture(*trailTextures[i]);
 
-    // update angles
-    theta1 += angularVelocity * dt;
-    theta2 += angularVelocity2 * dt;
+        trailFBOs[i]->Bind();
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        trailFBOs[i]->Unbind();
+    }
+    trailSrc = 0;
+}
 
-    // normalize angles to be between 0 and 2*PI
-    theta1 = fmod(theta1, 2 * M_PI);
-    theta2 = fmod(theta2, 2 * M_PI);
+// --- DONE WITH SHAPE SETUP ---
 
+// --- PHYSICS FOR PENDULUM ---
+PendulumParams Params() {
+    return PendulumParams{ ROD_LENGTH, ROD_LENGTH2, BOB_MASS, BOB_MASS2, GRAVITY };
+}
+
+// position of the second bob in NDC, matching the transforms used to draw it
+void BobPosition2(float& x, float& y) {
+    x = ROD_LENGTH * sin(state.theta1) + ROD_LENGTH2 * sin(state.theta1 + state.theta2);
+    y = -ROD_LENGTH * cos(state.theta1) - ROD_LENGTH2 * cos(state.theta1 + state.theta2);
+}
+
+void ApplyScenario() {
+    PendulumParams p = scenario.Params(0);
+    ROD_LENGTH = p.rodLength;
+    ROD_LENGTH2 = p.rodLength2;
+    BOB_MASS = p.mass;
+    BOB_MASS2 = p.mass2;
+    GRAVITY = p.gravity;
+    h = scenario.dt;
+    pendulum.Set(scenario.Member(0));
+    accumulator = 0.0f;
 }
 
 // --- DONE WITH PHYSICS FOR PENDULUM ---
 
 
-int main(){
+int main(int argc, char** argv){
+    TRACE_THREAD_NAME("main");
+
+    // batch runs never touch the window system or OpenGL
+    if (IsBatchRun(argc, argv)) return BatchMain(argc, argv);
+
+    if (argc > 2 && strcmp(argv[1], "--scenario") == 0) {
+        char error[256];
+        if (!scenario.Load(argv[2], error, sizeof(error))) {
+            fprintf(stderr, "%s: %s\n", argv[2], error);
+            return 2;
+        }
+    }
+    ApplyScenario();
+
     // initialize GLFW
     glfwInit();
 
@@ -231,6 +485,11 @@ int main(){
     ImGui::CreateContext();
     ImGuiIO& io = ImGui::GetIO(); (void)io;
     ImGui::StyleColorsDark();
+    // installed first so the ImGui backend chains to them
+    glfwSetKeyCallback(window, key_callback);
+    glfwSetMouseButtonCallback(window, mouse_button_callback);
+    glfwSetCursorPosCallback(window, cursor_pos_callback);
+    glfwSetScrollCallback(window, scroll_callback);
     ImGui_ImplGlfw_InitForOpenGL(window, true);
     ImGui_ImplOpenGL3_Init("#version 330");
     
@@ -245,11 +504,52 @@ int main(){
     
     // Create shader program using ShaderClass
     Shader shaderProgram("shaders/default.vert", "shaders/default.frag");
+    Shader densityProgram("shaders/quad.vert", "shaders/density.frag");
+    Shader decayProgram("shaders/quad.vert", "shaders/decay.frag");
+    Shader trailProgram("shaders/quad.vert", "shaders/trail.frag");
     SetupRect();
     SetupCircle();
+    SetupQuad();
+
+    Texture densityTexture(DENSITY_SIZE, DENSITY_SIZE, GL_R32F, GL_RED, GL_FLOAT);
+    densityTexture.Update(densityMap.bins.data());
+    SetupTrails(winWidth, winHeight);
+    GpuTimer trailsTimer, sceneTimer, imguiTimer;
+    FrameCapture frameCapture;
+    auto StopCapture = [&]() {
+        frameCapture.Flush(video);
+        if (!video.Close()) printf("capture to %s failed\n", VIDEO_PATH);
+        capturing = false;
+        glfwSwapInterval(1);
+    };
+    bool densityDirty = false;
 
+    prevTime = glfwGetTime();
     while (!glfwWindowShouldClose(window)) {
+        // nothing is moving: block until input arrives or another thread wakes
+        // us. Real-time capture keeps drawing, as its video runs on regardless
+        bool slept = false;
+        if (sleepWhenPaused && paused && redrawFrames == 0 && !(capturing && !captureOffline)) {
+            double sleepStart = glfwGetTime();
+            glfwWaitEventsTimeout(IDLE_TIMEOUT);
+
+            // a heartbeat with no events or wake-ups doesn't need a redraw
+            bool woken = wakeRequested.exchange(false, std::memory_order_relaxed);
+            if (!woken && glfwGetTime() - sleepStart >= IDLE_TIMEOUT) continue;
+            redrawFrames = IDLE_REDRAW_FRAMES;
+            slept = true;
+        }
+        if (redrawFrames > 0) redrawFrames--;
+        double frameStart = glfwGetTime();
+        frameCount++;
+
+        // apply whatever the governor decided last frame
+        quality = adaptiveQuality ? governor.Settings() : QualityGovernor::Full();
+        if (quality.circleSegments != circleSegments) SetupCircle(quality.circleSegments);
+        if (quality.msaa) glEnable(GL_MULTISAMPLE); else glDisable(GL_MULTISAMPLE);
+
         // build ui
+        profiler.Begin(ZONE_UI);
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
@@ -295,92 +595,458 @@ int main(){
             }
 
             // use PauseIf for angle sliders
-            PauseIf(ImGui::SliderAngle("Angle 1", &theta1, -180.0f, 180.0f), paused);
+            PauseIf(ImGui::SliderAngle("Angle 1", &state.theta1, -180.0f, 180.0f), paused);
             ImGui::SameLine();
             
             ImGui::PushItemWidth(100);
             static float a1_deg = 0.f, a2_deg = 0.f;
-            a1_deg = theta1 * 180.0f / M_PI;
+            a1_deg = state.theta1 * 180.0f / M_PI;
             
             if (PauseOnCommit(ImGui::InputFloat("Angle 1 (deg)", &a1_deg, 1.0f, 5.0f, "%.1f"))) {
-                theta1 = a1_deg * M_PI / 180.0f;
-                angularVelocity = 0.0f;
+                state.theta1 = a1_deg * M_PI / 180.0f;
+                state.omega1 = 0.0f;
                 accumulator = 0.0f;
             }
             ImGui::PopItemWidth();
 
-            PauseIf(ImGui::SliderAngle("Angle 2", &theta2, -180.0f, 180.0f), paused);
+            PauseIf(ImGui::SliderAngle("Angle 2", &state.theta2, -180.0f, 180.0f), paused);
             ImGui::SameLine();
 
             ImGui::PushItemWidth(100);
-            a2_deg = theta2 * 180.0f / M_PI;
+            a2_deg = state.theta2 * 180.0f / M_PI;
             
             if (PauseOnCommit(ImGui::InputFloat("Angle 2 (deg)", &a2_deg, 1.0f, 5.0f, "%.1f"))) {
-                theta2 = a2_deg * M_PI / 180.0f; 
-                angularVelocity2 = 0.0f;
+                state.theta2 = a2_deg * M_PI / 180.0f; 
+                state.omega2 = 0.0f;
                 accumulator = 0.0f;
             }
             ImGui::PopItemWidth();
             ImGui::PopItemWidth();
 
             if (ImGui::Button("Reset")) {
-                theta1 = theta1_init; 
-                theta2 = theta2_init;
-                angularVelocity = 0; 
-                angularVelocity2 = 0;
-                accumulator = 0;
-                BOB_MASS2 = BOB_MASS = 1.0f;
-                ROD_LENGTH = ROD_LENGTH2 = 0.3f;
+                ApplyScenario();
                 DAMPING = 0.992f;
                 paused = true;
+                journal.Mark(JournalEvent::Reset);
             }
 
             ImGui::SameLine();
 
             if (ImGui::Button("Start")) {
                 paused = false;
-                angularVelocity = 0.0f;
-                angularVelocity2 = 0.0f;
+                state.omega1 = 0.0f;
+                state.omega2 = 0.0f;
+                pendulum.Set(state);
+                journal.Mark(JournalEvent::Start);
+            }
+
+            ImGui::Separator();
+            ImGui::Checkbox("Long exposure", &longExposure);
+            if (longExposure) {
+                ImGui::SameLine();
+                if (ImGui::Button("Clear")) {
+                    densityMap.Clear();
+                    densityTexture.Update(densityMap.bins.data());
+                }
+                ImGui::PushItemWidth(150);
+                ImGui::SliderFloat("Exposure", &exposure, 0.1f, 100.0f, "%.1f", ImGuiSliderFlags_Logarithmic);
+                ImGui::PopItemWidth();
+                ImGui::Text("%llu samples", (unsigned long long)densityMap.samples);
+            }
+
+            ImGui::Checkbox("Trails", &trails);
+            if (trails) {
+                ImGui::PushItemWidth(150);
+                ImGui::SliderFloat("Trail decay", &trailDecay, 0.80f, 0.999f, "%.3f");
+                ImGui::PopItemWidth();
+            }
+
+            ImGui::Checkbox("Sleep when paused", &sleepWhenPaused);
+
+            // recording truncates the file the player has mapped
+            ImGui::BeginDisabled(playback);
+            if (ImGui::Checkbox("Record", &recording)) {
+                if (recording) {
+                    recording = recorder.Open(RECORDING_PATH, 1, h, Params(), Integrator::SemiImplicitEuler);
+                    if (!recording) printf("could not open %s\n", RECORDING_PATH);
+                } else if (!recorder.Close()) {
+                    printf("recording to %s failed\n", RECORDING_PATH);
+                }
+            }
+            ImGui::EndDisabled();
+            if (recording) {
+                ImGui::SameLine();
+                uint64_t written = recorder.fileBytes.load(std::memory_order_relaxed);
+                ImGui::Text("%llu steps, %.1f KB (%.1fx)", (unsigned long long)recorder.steps.load(std::memory_order_relaxed),
+                            written / 1024.0, double(recorder.RawBytes()) / double(std::max<uint64_t>(written, 1)));
+            }
+
+            if (ImGui::Checkbox("Export", &exporting)) {
+                const char* path = EXPORT_PATHS[exportFormat];
+                if (exporting) {
+                    exporting = exporter.Open(path, 1, h, Exporter::Format(exportFormat), Exporter::Backpressure(exportPolicy));
+                    if (!exporting) printf("could not open %s\n", path);
+                } else if (!exporter.Close()) {
+                    printf("export to %s failed\n", path);
+                }
+            }
+            ImGui::SameLine();
+            ImGui::BeginDisabled(exporting);
+            ImGui::PushItemWidth(90);
+            ImGui::Combo("##format", &exportFormat, "CSV\0NDJSON\0");
+            ImGui::SameLine();
+            ImGui::Combo("##policy", &exportPolicy, "Block\0Drop\0Decimate\0");
+            ImGui::PopItemWidth();
+            ImGui::EndDisabled();
+            if (exporting) {
+                ImGui::Text("%llu steps, %llu skipped, keeping 1/%u", (unsigned long long)exporter.exported.load(std::memory_order_relaxed),
+                            (unsigned long long)(exporter.dropped.load(std::memory_order_relaxed) +
+                                                 exporter.decimated.load(std::memory_order_relaxed)),
+                            exporter.decimation.load(std::memory_order_relaxed));
+            }
+
+            if (ImGui::Checkbox("Share", &sharing)) {
+                if (sharing) {
+                    sharing = sharedRing.Create(SHARED_NAME, 1, 0, h);
+                    if (!sharing) printf("could not create shared memory %s\n", SHARED_NAME);
+                } else {
+                    sharedRing.Close();
+                }
+            }
+            if (sharing) {
+                ImGui::SameLine();
+                ImGui::Text("%s: %llu snapshots in %u slots", SHARED_NAME,
+                            (unsigned long long)sharedRing.header->published.load(std::memory_order_relaxed),
+                            sharedRing.header->slots);
+            }
+
+            if (ImGui::Checkbox("Telemetry", &serving)) {
+                if (serving) {
+                    // the subscriber count shown below changes while the app may be asleep
+                    telemetry.onSubscribersChanged = RequestRedraw;
+                    serving = telemetry.Start(TELEMETRY_PATH, 1, h);
+                    if (!serving) printf("could not listen on %s\n", TELEMETRY_PATH);
+                } else {
+                    telemetry.Stop();
+                }
+            }
+            if (serving) {
+                ImGui::SameLine();
+                ImGui::Text("%s: %llu subscribers, %.1f KB sent, %llu dropped", TELEMETRY_PATH,
+                            (unsigned long long)telemetry.subscribers.load(std::memory_order_relaxed),
+                            telemetry.bytesSent.load(std::memory_order_relaxed) / 1024.0,
+                            (unsigned long long)telemetry.framesDropped.load(std::memory_order_relaxed));
+            }
+
+            if (ImGui::Checkbox("Journal", &journaling)) {
+                if (journaling) {
+                    journaling = journal.Open(JOURNAL_PATH, JournalInputs{ state, Params(), h, DAMPING, paused });
+                    if (!journaling) printf("could not open %s\n", JOURNAL_PATH);
+                } else if (!journal.Close()) {
+                    printf("journal %s failed\n", JOURNAL_PATH);
+                }
+            }
+            if (journaling) {
+                ImGui::SameLine();
+                ImGui::Text("%s: %llu events over %llu steps", JOURNAL_PATH, (unsigned long long)journal.events,
+                            (unsigned long long)journal.steps);
+            }
+
+            if (ImGui::Checkbox("Capture", &capturing)) {
+                if (capturing) {
+                    // 4:2:0 needs even dimensions
+                    int captureWidth = winWidth & ~1, captureHeight = winHeight & ~1;
+                    capturing = video.Open(VIDEO_PATH, captureWidth, captureHeight, CAPTURE_FPS);
+                    if (capturing) {
+                        frameCapture.Resize(captureWidth, captureHeight);
+                        glfwSwapInterval(captureOffline ? 0 : 1);
+                        captureStart = frameStart;
+                        captureFrames = 0;
+                    } else {
+                        printf("could not open %s\n", VIDEO_PATH);
+                    }
+                } else {
+                    StopCapture();
+                }
+            }
+            ImGui::SameLine();
+            ImGui::BeginDisabled(capturing);
+            ImGui::Checkbox("Offline", &captureOffline);
+            ImGui::EndDisabled();
+            if (capturing) {
+                ImGui::Text("%s: %llu frames, %.1f MB, %llu dropped", VIDEO_PATH,
+                            (unsigned long long)video.written.load(std::memory_order_relaxed),
+                            video.fileBytes.load(std::memory_order_relaxed) / (1024.0 * 1024.0),
+                            (unsigned long long)video.dropped.load(std::memory_order_relaxed));
+            }
+
+            ImGui::BeginDisabled(recording);
+            if (ImGui::Checkbox("Playback", &playback)) {
+                if (playback) {
+                    playback = player.Open(RECORDING_PATH) && player.steps > 0;
+                    if (!playback) printf("could not read %s\n", RECORDING_PATH);
+                    paused = playback;
+                    playing = false;
+                    playStep = 0.0;
+                    playMember = 0;
+                } else {
+                    player.Close();
+                }
+            }
+            ImGui::EndDisabled();
+            if (playback) {
+                ImGui::SameLine();
+                if (ImGui::Button(playing ? "Stop" : "Play")) {
+                    playing = !playing;
+                    player.Advise(playing ? TrajectoryReader::Access::Sequential : TrajectoryReader::Access::Random);
+                }
+                uint64_t step = uint64_t(playStep);
+                uint64_t firstStep = 0, lastStep = player.steps - 1;
+                ImGui::PushItemWidth(250);
+                if (ImGui::SliderScalar("Step", ImGuiDataType_U64, &step, &firstStep, &lastStep)) {
+                    // scrubbing jumps around: no read-ahead
+                    if (playing) player.Advise(TrajectoryReader::Access::Random);
+                    playing = false;
+                    playStep = double(step);
+                }
+                if (player.header.members > 1) {
+                    ImGui::SliderInt("Member", &playMember, 0, int(player.header.members) - 1);
+                }
+                ImGui::PopItemWidth();
+                ImGui::Text("t = %.3f s of %.3f s%s", player.Time(step), player.Time(player.steps),
+                            player.indexed ? "" : " (unindexed)");
+            }
+
+            if (ImGui::Button("Checkpoint")) {
+                Ensemble saved(1);
+                saved.Set(0, state);
+                CheckpointState checkpoint;
+                checkpoint.dt = h;
+                checkpoint.params = Params();
+                if (!SaveCheckpoint(CHECKPOINT_PATH, saved, checkpoint, &densityMap)) printf("could not write %s\n", CHECKPOINT_PATH);
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Restore")) {
+                Ensemble saved(1);
+                CheckpointState checkpoint;
+                if (LoadCheckpoint(CHECKPOINT_PATH, saved, checkpoint, &densityMap)) {
+                    ROD_LENGTH = checkpoint.params.rodLength;
+                    ROD_LENGTH2 = checkpoint.params.rodLength2;
+                    BOB_MASS = checkpoint.params.mass;
+                    BOB_MASS2 = checkpoint.params.mass2;
+                    GRAVITY = checkpoint.params.gravity;
+                    h = checkpoint.dt;
+                    pendulum.Set(saved.Get(0));
+                    accumulator = 0.0f;
+                    paused = true;
+                    densityTexture.Update(densityMap.bins.data());
+                } else {
+                    printf("could not read %s\n", CHECKPOINT_PATH);
+                }
+            }
+
+            ImGui::Separator();
+            throughput.Update(physicsCounters, glfwGetTime());
+            ImGui::Text("%.3g member-steps/s, %.0f ns/step", throughput.memberStepsPerSecond, throughput.nsPerStep);
+            ImGui::Text("%.1f catch-up steps/frame", throughput.stepsPerFrame);
+            // falling behind real time means the accumulator can't keep up
+            bool behind = !paused && throughput.realtimeFactor < 0.98;
+            ImGui::TextColored(behind ? ImVec4(1.0f, 0.4f, 0.3f, 1.0f) : ImGui::GetStyleColorVec4(ImGuiCol_Text),
+                               "%.2fx real time%s", throughput.realtimeFactor, behind ? " (behind)" : "");
+            ImGui::Separator();
+
+            ImGui::Checkbox("Profiler", &showProfiler);
+            ImGui::SameLine();
+            ImGui::Checkbox("Frame stats", &showFrameStats);
+            ImGui::SameLine();
+            ImGui::Checkbox("Adaptive quality", &adaptiveQuality);
+            if (adaptiveQuality) {
+                ImGui::PushItemWidth(150);
+                ImGui::SliderFloat("Budget (ms)", &governor.targetMs, 4.0f, 33.3f, "%.1f");
+                ImGui::PopItemWidth();
+                ImGui::Text("p99 %.2f ms, level %d/%d", governor.P99(), governor.level, QualityGovernor::MAX_LEVEL);
+                ImGui::TextWrapped("Sacrificing: %s", governor.Sacrificing());
             }
         }
+        ImVec2 controlsSize = ImGui::GetWindowSize();
         ImGui::End();
 
+        if (showProfiler) {
+            // dock to the left of the controls box
+            ImGui::SetNextWindowPos(ImVec2(window_pos.x - controlsSize.x - 10, window_pos.y), ImGuiCond_Always, window_pivot);
+            ImGui::SetNextWindowBgAlpha(0.8f);
+            profiler.Draw("Profiler", &showProfiler);
+        }
+        if (showFrameStats) {
+            ImGui::SetNextWindowPos(ImVec2(10, 10), ImGuiCond_FirstUseEver);
+            ImGui::SetNextWindowBgAlpha(0.8f);
+            DrawFrameStats(&showFrameStats);
+        }
+        profiler.End(ZONE_UI);
+
+        // keep drawing while a widget is being dragged or typed into
+        if (ImGui::IsAnyItemActive() || wakeRequested.exchange(false, std::memory_order_relaxed)) {
+            redrawFrames = IDLE_REDRAW_FRAMES;
+        }
+
         // simulate pendulum
+        profiler.Begin(ZONE_PHYSICS);
         float currTime = glfwGetTime();
         float frameTime = currTime - prevTime;
+        if (capturing && captureOffline) frameTime = 1.0f / CAPTURE_FPS;
         prevTime = currTime;
+        int stepsThisFrame = 0;
 
         accumulator += frameTime;
-        float interpolatedAngle = theta1;
-        float interpolatedAngle2 = theta2;
+        float interpolatedAngle = state.theta1;
+        float interpolatedAngle2 = state.theta2;
+        PendulumParams params = Params();
+        if (journaling) journal.Sync(JournalInputs{ state, params, h, DAMPING, paused });
 
         if (!paused) {
+            auto stepStart = std::chrono::steady_clock::now();
             while (accumulator >= h) {
-                UpdatePendulum(h);
+                TRACE_ZONE("Substep");
+                pendulum.Step(params, h);
                 accumulator -= h;
+                stepsThisFrame++;
+                if (journaling) journal.Step(pendulum.curr);
+                if (recording) recorder.Record(pendulum.curr);
+                if (exporting) exporter.Push(pendulum.curr);
+                liveSteps++;
+                liveTime += h;
+                if (sharing) sharedRing.Publish(pendulum.curr, liveSteps, liveTime, params);
+                if (serving) telemetry.Publish(pendulum.curr, liveSteps, liveTime, params);
+
+                if (longExposure) {
+                    float x, y;
+                    BobPosition2(x, y);
+                    splatBatch.push_back(x);
+                    splatBatch.push_back(y);
+                }
+            }
+            auto stepNanos = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - stepStart);
+            physicsCounters.AddSteps(stepsThisFrame, uint64_t(stepNanos.count()));
+            physicsCounters.AddSimTime(double(h) * stepsThisFrame);
+            physicsCounters.AddFrame(stepsThisFrame);
+
+            // splat this frame's steps in one batch; upload at most once per frame
+            if (!splatBatch.empty()) {
+                densityMap.Splat(splatBatch.data(), splatBatch.size() / 2);
+                splatBatch.clear();
+                densityDirty = true;
+            }
+            if (densityDirty && frameCount % quality.densityUploadInterval == 0) {
+                densityTexture.Update(densityMap.bins.data());
+                densityDirty = false;
             }
 
+            // Sample between the last two steps for smoother rendering; this
+            // draws one step behind the physics but never overshoots
             float alpha = accumulator / h;
-            // Interpolate the angle for smoother rendering
-            interpolatedAngle = theta1 + alpha * angularVelocity * h;
-            interpolatedAngle2 = theta2 + alpha * angularVelocity2 * h;
+            PendulumState drawn = pendulum.Sample(params, alpha);
+            interpolatedAngle = drawn.theta1;
+            interpolatedAngle2 = drawn.theta2;
+        } else if (playback) {
+            // replay at the recorded rate; only the chunk in view is decoded
+            accumulator = 0.0f;
+            if (playing) {
+                playStep += frameTime / player.header.dt;
+                if (playStep >= double(player.steps)) {
+                    playStep = double(player.steps - 1);
+                    playing = false;
+                }
+                redrawFrames = IDLE_REDRAW_FRAMES;
+            }
+            PendulumState replayed;
+            if (player.Read(uint64_t(playStep), size_t(playMember), replayed)) {
+                interpolatedAngle = replayed.theta1;
+                interpolatedAngle2 = replayed.theta2;
+            }
         } else {
+            // the UI edits the current state directly while paused
             accumulator = 0.0f;
-            interpolatedAngle = theta1;
-            interpolatedAngle2 = theta2;
+            pendulum.Set(state);
+            interpolatedAngle = state.theta1;
+            interpolatedAngle2 = state.theta2;
         }
+        physicsHist.Record(uint64_t((glfwGetTime() - currTime) * 1e6));
+        profiler.End(ZONE_PHYSICS);
+
+        // an idle sleep isn't a slow frame
+        if (!slept) frameHist.Record(uint64_t(frameTime * 1e6));
+        if (!paused) stepsHist.Record(stepsThisFrame);
 
+        profiler.Begin(ZONE_DRAW);
+
+        glm::mat4 T1_noscale = glm::rotate(glm::mat4(1.0f), interpolatedAngle,  glm::vec3(0,0,1));
+        glm::mat4 T2_noscale = glm::translate(T1_noscale, glm::vec3(0.0f, -ROD_LENGTH, 0.0f));
+        T2_noscale = glm::rotate(T2_noscale, interpolatedAngle2, glm::vec3(0,0,1));
+        glm::mat4 T1_noscale_bob = glm::translate(T1_noscale, glm::vec3(0.0f, -ROD_LENGTH, 0.0f));
+        glm::mat4 Tbob = glm::translate(T2_noscale, glm::vec3(0.0f, -ROD_LENGTH2, 0.0f));
+
+        GLuint transformLoc = glGetUniformLocation(shaderProgram.ID, "transform");
+        trailsTimer.Begin();
+
+        if (trails) {
+            int trailWidth = std::max(1, int(winWidth * quality.trailScale));
+            int trailHeight = std::max(1, int(winHeight * quality.trailScale));
+            if (trailTextures[0]->width != trailWidth || trailTextures[0]->height != trailHeight) {
+                SetupTrails(trailWidth, trailHeight);
+            }
+
+            // fade last frame's trails into the other target, then stamp the bobs on top
+            int dst = 1 - trailSrc;
+            trailFBOs[dst]->Bind();
+            glViewport(0, 0, trailWidth, trailHeight);
+            decayProgram.Activate();
+            trailTextures[trailSrc]->Bind(0);
+            glUniform1i(glGetUniformLocation(decayProgram.ID, "previous"), 0);
+            glUniform1f(glGetUniformLocation(decayProgram.ID, "decay"), trailDecay);
+            DrawQuad();
+            trailTextures[trailSrc]->Unbind();
+
+            shaderProgram.Activate();
+            glUniformMatrix4fv(transformLoc, 1, GL_FALSE, glm::value_ptr(T1_noscale_bob));
+            DrawCircle();
+            glUniformMatrix4fv(transformLoc, 1, GL_FALSE, glm::value_ptr(Tbob));
+            DrawCircle();
+            trailFBOs[dst]->Unbind();
+            glViewport(0, 0, winWidth, winHeight);
+            trailSrc = dst;
+        }
+
+        trailsTimer.End();
+
+        sceneTimer.Begin();
         glClearColor(0.07f, 0.13f, 0.17f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
+
+        if (longExposure) {
+            densityProgram.Activate();
+            densityTexture.Bind(0);
+            glUniform1i(glGetUniformLocation(densityProgram.ID, "density"), 0);
+            glUniform1f(glGetUniformLocation(densityProgram.ID, "exposure"), exposure);
+            glUniform1f(glGetUniformLocation(densityProgram.ID, "peak"), densityMap.peak);
+            DrawQuad();
+            densityTexture.Unbind();
+        }
+
+        if (trails) {
+            // add the trails over the background
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_ONE, GL_ONE);
+            trailProgram.Activate();
+            trailTextures[trailSrc]->Bind(0);
+            glUniform1i(glGetUniformLocation(trailProgram.ID, "trail"), 0);
+            DrawQuad();
+            trailTextures[trailSrc]->Unbind();
+            glDisable(GL_BLEND);
+        }
+
         shaderProgram.Activate();
         
         // draw shapes: two rods and two circles (bobs)
-        GLuint transformLoc = glGetUniformLocation(shaderProgram.ID, "transform");
-        
-        glm::mat4 T1_noscale = glm::rotate(glm::mat4(1.0f), interpolatedAngle,  glm::vec3(0,0,1));
-        glm::mat4 T2_noscale = glm::translate(T1_noscale, glm::vec3(0.0f, -ROD_LENGTH, 0.0f));
-        T2_noscale = glm::rotate(T2_noscale, interpolatedAngle2, glm::vec3(0,0,1));
-
         glm::mat4 Rod1 = glm::rotate(glm::mat4(1.0f), interpolatedAngle, glm::vec3(0,0,1));
         Rod1 = glm::scale(Rod1, glm::vec3(1.0f, ROD_LENGTH, 1.0f));
         glUniformMatrix4fv(transformLoc, 1, GL_FALSE, glm::value_ptr(Rod1));
@@ -394,24 +1060,81 @@ int main(){
         glUniformMatrix4fv(transformLoc, 1, GL_FALSE, glm::value_ptr(Rod2));
         DrawRect();
 
-        glm::mat4 T1_noscale_bob = glm::translate(T1_noscale, glm::vec3(0.0f, -ROD_LENGTH, 0.0f));
         glUniformMatrix4fv(transformLoc, 1, GL_FALSE, glm::value_ptr(T1_noscale_bob));
         DrawCircle();  // first bob at end of rod1
 
-        glm::mat4 Tbob = glm::translate(T2_noscale, glm::vec3(0.0f, -ROD_LENGTH2, 0.0f));
         glUniformMatrix4fv(transformLoc, 1, GL_FALSE, glm::value_ptr(Tbob));
         DrawCircle();  // second bob at end of rod2
+        sceneTimer.End();
+
+        // the scene only, before the UI is drawn over it
+        if (capturing) {
+            if ((winWidth & ~1) != video.width || (winHeight & ~1) != video.height) {
+                printf("window resized: capture to %s stopped\n", VIDEO_PATH);
+                StopCapture();
+            } else if (captureOffline) {
+                TRACE_ZONE("Capture");
+                frameCapture.Read(video, true);
+            } else {
+                // every video frame whose time has come shows this one
+                uint64_t due = uint64_t((frameStart - captureStart) * CAPTURE_FPS) + 1;
+                if (due > captureFrames) {
+                    TRACE_ZONE("Capture");
+                    frameCapture.Read(video, false, int(std::min<uint64_t>(due - captureFrames, MAX_CAPTURE_REPEAT)));
+                    captureFrames = due;
+                }
+            }
+        }
 
         // render
+        imguiTimer.Begin();
         ImGui::Render();
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        imguiTimer.End();
+        profiler.End(ZONE_DRAW);
+
+        // GPU results are a frame old; feed them in as they arrive
+        profiler.Add(ZONE_GPU_TRAILS, float(trailsTimer.lastMs));
+        profiler.Add(ZONE_GPU_SCENE, float(sceneTimer.lastMs));
+        profiler.Add(ZONE_GPU_IMGUI, float(imguiTimer.lastMs));
+
+        // the wait inside the swap is vsync, not work
+        if (adaptiveQuality) {
+            float cpuMs = float((glfwGetTime() - frameStart) * 1000.0);
+            governor.Record(cpuMs, profiler.LatestGpuTotal());
+        }
         
         // swap buffers and poll events
+        profiler.Begin(ZONE_SWAP);
         glfwSwapBuffers(window);
+        profiler.End(ZONE_SWAP);
+        if (inputTime >= 0.0) {
+            latencyHist.Record(uint64_t((glfwGetTime() - inputTime) * 1e6));
+            inputTime = -1.0;
+        }
+        profiler.EndFrame();
         glfwPollEvents();
     }
+    if (recording && !recorder.Close()) printf("recording to %s failed\n", RECORDING_PATH);
+    if (journaling && !journal.Close()) printf("journal %s failed\n", JOURNAL_PATH);
+    if (capturing) StopCapture();
+    if (exporting && !exporter.Close()) printf("export to %s failed\n", EXPORT_PATHS[exportFormat]);
+    if (TRACE_FLUSH("trace.json")) printf("wrote trace.json\n");
+
     // Clean up resources
     shaderProgram.Delete();
+    densityProgram.Delete();
+    densityTexture.Delete();
+    decayProgram.Delete();
+    trailProgram.Delete();
+    trailsTimer.Delete();
+    sceneTimer.Delete();
+    imguiTimer.Delete();
+    frameCapture.Delete();
+    for (int i = 0; i < 2; i++) {
+        trailFBOs[i]->Delete();
+        trailTextures[i]->Delete();
+    }
     delete rectVAO;
     delete rectVBO;
     delete rectEBO;
@@ -0,0 +1,139 @@
+// Headless batch runs: a command line must produce exactly the states that
+// calling Advance directly does, in each output format, scenario runs must
+// cover every run and member, and bad command lines must be rejected.
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "batch.h"
+#include "check.h"
+#include "ensemble.h"
+#include "trajectoryReader.h"
+
+static int Run(std::vector<const char*> args) {
+    args.insert(args.begin(), { "pendsim", "--batch" });
+    return BatchMain(int(args.size()), const_cast<char**>(args.data()));
+}
+
+// the same run as the command lines below, done by hand
+static void Expected(Ensemble& e, int steps, Integrator integrator) {
+    PendulumParams p{ 0.3f, 0.25f, 0.1f, 0.2f, 9.81f };
+    const float DEG = float(M_PI) / 180.0f;
+    for (size_t m = 0; m < e.size; m++) {
+        float offset = float(m) / float(e.size - 1) - 0.5f;
+        e.Set(m, PendulumState{ 120.0f * DEG + offset * 20.0f * DEG, -30.0f * DEG, 0.0f, 0.0f });
+    }
+    AdvanceOptions options;
+    options.integrator = integrator;
+    Advance(e, p, 0.002f, steps, options);
+}
+
+static void TestFinalStates() {
+    CHECK(Run({ "--members", "5", "--spread", "20", "--angle1", "120", "--angle2", "-30", "--rod2", "0.25",
+                "--mass2", "0.2", "--dt", "0.002", "--duration", "1", "--integrator", "rk4",
+                "--output", "test_final.txt", "--quiet" }) == 0, "batch run failed");
+
+    Ensemble e(5);
+    Expected(e, 500, Integrator::RK4);
+
+    FILE* in = fopen("test_final.txt", "r");
+    CHECK(in != nullptr, "no final states written");
+    if (!in) return;
+    char line[256];
+    CHECK(fgets(line, sizeof(line), in) && strncmp(line, "member,", 7) == 0, "missing header");
+    int mismatches = 0, rows = 0;
+    size_t m;
+    float v[4], energy;
+    while (fscanf(in, "%zu,%f,%f,%f,%f,%f", &m, &v[0], &v[1], &v[2], &v[3], &energy) == 6) {
+        PendulumState s = e.Get(m);
+        float want[4] = { s.theta1, s.theta2, s.omega1, s.omega2 };
+        // %.9g round trips a float exactly
+        for (int c = 0; c < 4; c++) mismatches += v[c] != want[c];
+        rows++;
+    }
+    fclose(in);
+    remove("test_final.txt");
+    CHECK(rows == 5 && mismatches == 0, "%d rows, %d values differ from Advance", rows, mismatches);
+}
+
+static void TestRecording() {
+    CHECK(Run({ "--members", "5", "--spread", "20", "--angle1", "120", "--angle2", "-30", "--rod2", "0.25",
+                "--mass2", "0.2", "--dt", "0.002", "--duration", "1", "--every", "10", "--threads", "2",
+                "--output", "test_batch.pendrec", "--quiet" }) == 0, "batch run failed");
+
+    Ensemble e(5);
+    Expected(e, 500, Integrator::SemiImplicitEuler);
+
+    TrajectoryReader reader;
+    CHECK(reader.Open("test_batch.pendrec"), "could not read the recording");
+    CHECK(reader.steps == 50 && std::fabs(reader.header.dt - 0.02f) < 1e-7f,
+          "%llu steps of %g s, wanted 50 of 0.02", (unsigned long long)reader.steps, reader.header.dt);
+
+    int mismatches = 0;
+    for (size_t m = 0; m < e.size; m++) {
+        PendulumState got, want = e.Get(m);
+        mismatches += !reader.Read(reader.steps - 1, m, got) || memcmp(&got, &want, sizeof(got)) != 0;
+    }
+    CHECK(mismatches == 0, "%d final states differ from Advance", mismatches);
+    reader.Close();
+    remove("test_batch.pendrec");
+}
+
+// a sweep over a grid, in batches that don't divide the grid
+static void TestScenario() {
+    FILE* out = fopen("test_batch_scenario.txt", "w");
+    fprintf(out, "dt 0.01\nduration 0.5\nintegrator midpoint\nbatch 2\nrod2 0.2:0.4:2\n"
+                 "sampling grid\ntheta1 60:120:3\noutput test_scenario.csv\n");
+    fclose(out);
+    CHECK(Run({ "--scenario", "test_batch_scenario.txt", "--quiet" }) == 0, "scenario run failed");
+
+    FILE* in = fopen("test_scenario.csv", "r");
+    CHECK(in != nullptr, "no scenario output");
+    if (!in) return;
+    char line[512];
+    CHECK(fgets(line, sizeof(line), in) && strncmp(line, "run,member,rod2,theta1_0,", 25) == 0, "header: %s", line);
+
+    int rows = 0, mismatches = 0;
+    unsigned run, member;
+    float rod2, s0[4], s[4], energy;
+    while (fscanf(in, "%u,%u,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f", &run, &member, &rod2, &s0[0], &s0[1], &s0[2], &s0[3],
+                  &s[0], &s[1], &s[2], &s[3], &energy) == 12) {
+        PendulumParams p{ 0.3f, rod2, 0.1f, 0.1f, 9.81f };
+        PendulumState state{ s0[0], s0[1], s0[2], s0[3] };
+        for (int i = 0; i < 50; i++) StepPendulum(state, p, 0.01f, Integrator::Midpoint);
+        mismatches += std::fabs(state.theta1 - s[0]) > 1e-4f || std::fabs(state.omega2 - s[3]) > 1e-3f;
+        mismatches += std::fabs(s0[0] - (60.0f + 30.0f * member) * float(M_PI) / 180.0f) > 1e-6f;
+        mismatches += std::fabs(rod2 - (run ? 0.4f : 0.2f)) > 1e-6f;
+        rows++;
+    }
+    fclose(in);
+    remove("test_scenario.csv");
+    remove("test_batch_scenario.txt");
+    CHECK(rows == 6 && mismatches == 0, "%d rows, %d differ from stepping by hand", rows, mismatches);
+
+    CHECK(Run({ "--scenario", "no_such_scenario.txt" }) == 2, "missing scenario accepted");
+}
+
+static void TestBadArgs() {
+    CHECK(Run({ "--integrator", "leapfrog" }) == 2, "unknown integrator accepted");
+    CHECK(Run({ "--members", "0" }) == 2, "zero members accepted");
+    CHECK(Run({ "--members", "-5" }) == 2, "negative members accepted");
+    CHECK(Run({ "--members", "1e30" }) == 2, "out of range members accepted");
+    CHECK(Run({ "--members", "2.5" }) == 2, "fractional members accepted");
+    CHECK(Run({ "--members", "12abc" }) == 2, "malformed members accepted");
+    CHECK(Run({ "--dt" }) == 2, "missing value accepted");
+    CHECK(Run({ "--frobnicate", "1" }) == 2, "unknown flag accepted");
+    CHECK(Run({ "--duration", "0", "--quiet" }) == 0, "empty run failed");
+}
+
+int main() {
+    TestFinalStates();
+    TestRecording();
+    TestScenario();
+    TestBadArgs();
+
+    printf("%d of %d checks failed\n", failures, checks);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,220 @@
+// Checkpoints: a saved ensemble and density map must come back bit for bit,
+// a run resumed from a checkpoint must end exactly where an uninterrupted
+// run ends, for batch and scenario runs, and damaged files must be refused.
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "batch.h"
+#include "check.h"
+#include "checkpoint.h"
+#include "densityMap.h"
+#include "ensemble.h"
+
+static int Run(std::vector<const char*> args) {
+    args.insert(args.begin(), { "pendsim", "--batch" });
+    return BatchMain(int(args.size()), const_cast<char**>(args.data()));
+}
+
+static std::vector<char> ReadFile(const char* path) {
+    std::vector<char> data;
+    FILE* in = fopen(path, "rb");
+    if (!in) return data;
+    fseek(in, 0, SEEK_END);
+    data.resize(size_t(ftell(in)));
+    fseek(in, 0, SEEK_SET);
+    if (fread(data.data(), 1, data.size(), in) != data.size()) data.clear();
+    fclose(in);
+    return data;
+}
+
+static void WriteFile(const char* path, const char* data, size_t bytes) {
+    FILE* out = fopen(path, "wb");
+    fwrite(data, 1, bytes, out);
+    fclose(out);
+}
+
+static void TestRoundTrip() {
+    Ensemble e(1000);
+    for (size_t m = 0; m < e.size; m++) {
+        e.Set(m, PendulumState{ 0.001f * m, -0.5f, std::sin(float(m)), 1e-30f * m });
+    }
+    DensityMap density(64, 48);
+    for (size_t i = 0; i < density.bins.size(); i++) density.bins[i] = float(i % 17) * 0.25f;
+    density.peak = 4.0f;
+    density.samples = 123456789;
+
+    CheckpointState state;
+    state.step = 4242;
+    state.time = 4242 * 0.005;
+    state.dt = 0.005f;
+    state.integrator = Integrator::RK4;
+    state.params = PendulumParams{ 0.3f, 0.25f, 0.1f, 0.2f, 9.81f };
+    state.seed = 99;
+    CHECK(SaveCheckpoint("test.pendckpt", e, state, &density), "save failed");
+
+    std::vector<char> file = ReadFile("test.pendckpt");
+    CHECK(file.size() % CHECKPOINT_PAGE == 0, "file is %zu bytes, not whole pages", file.size());
+
+    Ensemble restored(1);
+    DensityMap restoredDensity(64, 48);
+    CheckpointState got;
+    CHECK(LoadCheckpoint("test.pendckpt", restored, got, &restoredDensity), "load failed");
+    CHECK(restored.size == e.size && restored.capacity == e.capacity && restored.mappedBytes > 0,
+          "restored %zu of %zu members", restored.size, restored.capacity);
+    bool same = restored.size == e.size;
+    for (size_t m = 0; same && m < e.capacity; m++) {
+        same = restored.theta1[m] == e.theta1[m] && restored.theta2[m] == e.theta2[m] &&
+               restored.omega1[m] == e.omega1[m] && memcmp(&restored.omega2[m], &e.omega2[m], sizeof(float)) == 0;
+    }
+    CHECK(same, "columns differ after restore");
+    CHECK(got.step == 4242 && got.dt == 0.005f && got.integrator == Integrator::RK4 && got.seed == 99 &&
+          got.params.mass2 == 0.2f, "state differs after restore");
+    CHECK(restoredDensity.bins == density.bins && restoredDensity.peak == 4.0f &&
+          restoredDensity.samples == 123456789, "density differs after restore");
+
+    // columns that can't be mapped on this host (not page aligned) are read
+    CheckpointHeader header;
+    memcpy(&header, file.data(), sizeof(header));
+    std::vector<char> unaligned(512 + header.columnsBytes, 0);
+    header.columnsOffset = 512;
+    header.densityWidth = 0;
+    header.densityHeight = 0;
+    header.densityBytes = 0;
+    memcpy(unaligned.data(), &header, sizeof(header));
+    memcpy(unaligned.data() + 512, file.data() + CHECKPOINT_PAGE, header.columnsBytes);
+    WriteFile("test_bad.pendckpt", unaligned.data(), unaligned.size());
+    Ensemble copied(1);
+    CHECK(LoadCheckpoint("test_bad.pendckpt", copied, got) && copied.size == e.size &&
+          memcmp(copied.theta1, e.theta1, header.columnsBytes) == 0, "unaligned columns not read");
+
+    // the restored ensemble is writable and advances like the original
+    AdvanceOptions options;
+    options.integrator = Integrator::RK4;
+    Advance(e, state.params, state.dt, 10, options);
+    Advance(restored, got.params, got.dt, 10, options);
+    same = true;
+    for (size_t m = 0; m < e.size; m++) {
+        PendulumState a = e.Get(m), b = restored.Get(m);
+        same = same && memcmp(&a, &b, sizeof(a)) == 0;
+    }
+    CHECK(same, "restored ensemble advances differently");
+
+    // a density map of another size is left alone
+    DensityMap other(32, 32);
+    CHECK(LoadCheckpoint("test.pendckpt", restored, got, &other) && other.samples == 0, "density loaded into wrong size");
+
+    // damage: a density size that disagrees with its dimensions, even with
+    // the bytes in the file, would overrun the map
+    memcpy(&header, file.data(), sizeof(header));
+    header.densityBytes += 4096;
+    std::vector<char> oversized = file;
+    memcpy(oversized.data(), &header, sizeof(header));
+    WriteFile("test_bad.pendckpt", oversized.data(), oversized.size());
+    DensityMap guarded(64, 48);
+    CHECK(!LoadCheckpoint("test_bad.pendckpt", restored, got, &guarded) && guarded.samples == 0,
+          "oversized density section accepted");
+
+    // damage: truncated columns, a bad magic, an empty file
+    WriteFile("test_bad.pendckpt", file.data(), CHECKPOINT_PAGE + 100);
+    CHECK(!LoadCheckpoint("test_bad.pendckpt", restored, got), "truncated checkpoint accepted");
+    file[0] = 'X';
+    WriteFile("test_bad.pendckpt", file.data(), file.size());
+    CHECK(!LoadCheckpoint("test_bad.pendckpt", restored, got), "bad magic accepted");
+    WriteFile("test_bad.pendckpt", file.data(), 0);
+    CHECK(!LoadCheckpoint("test_bad.pendckpt", restored, got), "empty file accepted");
+    CHECK(!LoadCheckpoint("no_such.pendckpt", restored, got), "missing file accepted");
+    CHECK(restored.size == e.size, "a failed load changed the ensemble");
+    remove("test_bad.pendckpt");
+    remove("test.pendckpt");
+}
+
+// a batch run checkpointed every 0.25 s, then resumed from the last one
+static void TestBatchResume() {
+    CHECK(Run({ "--members", "40", "--spread", "30", "--dt", "0.002", "--duration", "1", "--integrator", "rk4",
+                "--output", "test_full.txt", "--quiet" }) == 0, "uninterrupted run failed");
+    CHECK(Run({ "--members", "40", "--spread", "30", "--dt", "0.002", "--duration", "1", "--integrator", "rk4",
+                "--checkpoint", "test_batch.pendckpt", "--checkpoint-every", "0.25", "--quiet" }) == 0,
+          "checkpointed run failed");
+
+    Ensemble e(1);
+    CheckpointState state;
+    CHECK(LoadCheckpoint("test_batch.pendckpt", e, state) && state.step == 375 && e.size == 40,
+          "last checkpoint is at step %llu", (unsigned long long)state.step);
+
+    // members and integrator come from the checkpoint, not the command line
+    CHECK(Run({ "--members", "3", "--dt", "0.002", "--duration", "1", "--resume", "test_batch.pendckpt",
+                "--output", "test_resumed.txt", "--quiet" }) == 0, "resumed run failed");
+    std::vector<char> full = ReadFile("test_full.txt"), resumed = ReadFile("test_resumed.txt");
+    CHECK(!full.empty() && full == resumed, "resumed run ends elsewhere");
+
+    CHECK(Run({ "--checkpoint", "test.pendckpt", "--output", "test.pendrec" }) == 2, "checkpoint with a stream accepted");
+    CHECK(Run({ "--checkpoint", "test.pendckpt", "--checkpoint-every", "0" }) == 2, "zero interval accepted");
+    CHECK(Run({ "--resume", "no_such.pendckpt", "--quiet" }) == 1, "missing checkpoint accepted");
+    remove("test_full.txt");
+    remove("test_resumed.txt");
+    remove("test_batch.pendckpt");
+}
+
+// A scenario pre-empted mid-batch: the output written so far plus the
+// resumed run must equal the output of one uninterrupted run.
+static void TestScenarioResume() {
+    FILE* out = fopen("test_ckpt_scenario.txt", "w");
+    fprintf(out, "dt 0.01\nduration 1\nbatch 4\nrod2 0.2:0.4:2\nsampling cloud\nmembers 10\nseed 5\n"
+                 "theta1 120~5\noutput test_ckpt_scenario.csv\n");
+    fclose(out);
+    CHECK(Run({ "--scenario", "test_ckpt_scenario.txt", "--quiet" }) == 0, "scenario run failed");
+    std::vector<char> full = ReadFile("test_ckpt_scenario.csv");
+
+    // every 0.3 s counted across batches: the last checkpoint is 70 steps
+    // into the last batch of the last run
+    CHECK(Run({ "--scenario", "test_ckpt_scenario.txt", "--checkpoint", "test_scenario.pendckpt",
+                "--checkpoint-every", "0.3", "--quiet" }) == 0, "checkpointed scenario failed");
+    Ensemble e(1);
+    CheckpointState state;
+    CHECK(LoadCheckpoint("test_scenario.pendckpt", e, state) && state.run == 1 && state.firstMember == 8 &&
+          state.step == 70 && state.outputBytes > 0 && state.outputBytes < full.size(),
+          "checkpoint at run %llu member %llu step %llu", (unsigned long long)state.run,
+          (unsigned long long)state.firstMember, (unsigned long long)state.step);
+
+    // as if pre-empted: output stops somewhere after the checkpoint
+    WriteFile("test_ckpt_scenario.csv", full.data(), full.size() - 10);
+    CHECK(Run({ "--scenario", "test_ckpt_scenario.txt", "--resume", "test_scenario.pendckpt", "--quiet" }) == 0,
+          "resumed scenario failed");
+    CHECK(ReadFile("test_ckpt_scenario.csv") == full, "resumed scenario output differs");
+
+    // every 2 s, longer than a batch: checkpoints fall between batches, the
+    // last one at the start of the second batch of the last run
+    CHECK(Run({ "--scenario", "test_ckpt_scenario.txt", "--checkpoint", "test_scenario.pendckpt",
+                "--checkpoint-every", "2", "--quiet" }) == 0, "checkpointed scenario failed");
+    CHECK(LoadCheckpoint("test_scenario.pendckpt", e, state) && state.run == 1 && state.firstMember == 4 &&
+          state.step == 0 && state.outputBytes > 0 && state.outputBytes < full.size(),
+          "checkpoint at run %llu member %llu step %llu", (unsigned long long)state.run,
+          (unsigned long long)state.firstMember, (unsigned long long)state.step);
+    WriteFile("test_ckpt_scenario.csv", full.data(), full.size() - 10);
+    CHECK(Run({ "--scenario", "test_ckpt_scenario.txt", "--resume", "test_scenario.pendckpt", "--quiet" }) == 0,
+          "scenario resumed between batches failed");
+    CHECK(ReadFile("test_ckpt_scenario.csv") == full, "scenario resumed between batches differs");
+
+    // a checkpoint of another scenario is refused
+    out = fopen("test_ckpt_scenario.txt", "w");
+    fprintf(out, "dt 0.01\nduration 1\nbatch 4\nsampling cloud\nmembers 10\nseed 6\ntheta1 120~5\n");
+    fclose(out);
+    CHECK(Run({ "--scenario", "test_ckpt_scenario.txt", "--resume", "test_scenario.pendckpt", "--quiet" }) == 1,
+          "checkpoint of another seed accepted");
+
+    remove("test_ckpt_scenario.txt");
+    remove("test_ckpt_scenario.csv");
+    remove("test_scenario.pendckpt");
+}
+
+int main() {
+    TestRoundTrip();
+    TestBatchResume();
+    TestScenarioResume();
+
+    printf("%d of %d checks failed\n", failures, checks);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,328 @@
+// Differential tests: every optimized physics path against the scalar
+// reference (UpdatePendulum / StepPendulum), from randomized starting
+// states and parameters.
+//
+//   differential [SEED]
+//
+// Short horizons are compared member by member; chaos makes that
+// meaningless over long horizons, so there the ensembles are compared
+// statistically instead. Energy conservation is checked for the
+// integrators that are supposed to conserve it. Exits non-zero on any
+// failure and prints the seed so a failure can be reproduced.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "check.h"
+#include "ensemble.h"
+#include "pendulum.h"
+
+static const double TWO_PI = 6.283185307179586;
+
+// deterministic so a failing seed can be rerun
+struct Random {
+    unsigned long long x;
+    explicit Random(unsigned long long seed) : x(seed * 2862933555777941757ull + 3037000493ull) {}
+    float Uniform(float lo, float hi) {
+        x = x * 6364136223846793005ull + 1442695040888963407ull;
+        return lo + (hi - lo) * float(x >> 40) * (1.0f / 16777216.0f);
+    }
+};
+
+static PendulumParams RandomParams(Random& r) {
+    return PendulumParams{ r.Uniform(0.1f, 1.0f), r.Uniform(0.1f, 1.0f), r.Uniform(0.1f, 5.0f),
+                           r.Uniform(0.1f, 5.0f), r.Uniform(1.0f, 20.0f) };
+}
+
+// without extreme mass or length ratios, whose stiff modes would need a
+// far smaller step for any integrator to hold energy
+static PendulumParams ModerateParams(Random& r) {
+    float mass = r.Uniform(0.5f, 2.0f), rodLength = r.Uniform(0.2f, 0.6f);
+    return PendulumParams{ rodLength, rodLength * r.Uniform(0.7f, 1.4f), mass, mass * r.Uniform(0.5f, 2.0f),
+                           r.Uniform(5.0f, 15.0f) };
+}
+
+static PendulumState RandomState(Random& r, float maxAngle, float maxOmega) {
+    return PendulumState{ r.Uniform(-maxAngle, maxAngle), r.Uniform(-maxAngle, maxAngle),
+                          r.Uniform(-maxOmega, maxOmega), r.Uniform(-maxOmega, maxOmega) };
+}
+
+// kernels wrap angles differently, so compare them modulo 2*PI
+static double AngleError(float a, float b) {
+    return std::fabs(std::remainder(double(a) - double(b), TWO_PI));
+}
+
+static double WrapAngle(float a) {
+    return std::remainder(double(a), TWO_PI);
+}
+
+// energy scale of a configuration: the full swing of the potential
+static double EnergyScale(const PendulumParams& p) {
+    return (p.mass + p.mass2) * p.gravity * p.rodLength + p.mass2 * p.gravity * p.rodLength2;
+}
+
+struct Variant {
+    const char* name;
+    Kernel kernel;
+    int threads;
+};
+
+static const Variant VARIANTS[] = {
+    { "scalar", Kernel::Scalar, 1 },
+    { "simd", Kernel::Simd, 1 },
+    { "threaded", Kernel::Simd, 4 },
+};
+
+static void RunVariant(Ensemble& e, const PendulumParams& p, float dt, int steps, Integrator integrator,
+                       const Variant& v) {
+    AdvanceOptions options;
+    options.integrator = integrator;
+    options.kernel = v.kernel;
+    options.threads = v.threads;
+    Advance(e, p, dt, steps, options);
+}
+
+// UpdatePendulum is the original formula set; StepPendulum must match it
+// exactly, and the scalar ensemble kernel must match StepPendulum exactly
+static void TestReferenceIdentity(Random& r) {
+    for (int c = 0; c < 32; c++) {
+        PendulumParams p = RandomParams(r);
+        PendulumState a = RandomState(r, 3.1f, 2.0f);
+        PendulumState b = a;
+        for (int i = 0; i < 100; i++) {
+            UpdatePendulum(a, p, 0.005f);
+            StepPendulum(b, p, 0.005f, Integrator::SemiImplicitEuler);
+        }
+        CHECK(a.theta1 == b.theta1 && a.theta2 == b.theta2 && a.omega1 == b.omega1 && a.omega2 == b.omega2,
+              "StepPendulum(semi-implicit) differs from UpdatePendulum in case %d", c);
+    }
+
+    for (int i = 0; i < INTEGRATOR_COUNT; i++) {
+        Integrator integrator = Integrator(i);
+        PendulumParams p = RandomParams(r);
+        Ensemble e(37);
+        std::vector<PendulumState> reference;
+        for (size_t m = 0; m < e.size; m++) {
+            reference.push_back(RandomState(r, 3.1f, 2.0f));
+            e.Set(m, reference[m]);
+        }
+
+        RunVariant(e, p, 0.005f, 50, integrator, VARIANTS[0]);
+        int mismatches = 0;
+        for (size_t m = 0; m < e.size; m++) {
+            for (int s = 0; s < 50; s++) StepPendulum(reference[m], p, 0.005f, integrator);
+            PendulumState got = e.Get(m);
+            mismatches += got.theta1 != reference[m].theta1 || got.theta2 != reference[m].theta2 ||
+                          got.omega1 != reference[m].omega1 || got.omega2 != reference[m].omega2;
+        }
+        CHECK(mismatches == 0, "scalar kernel differs from StepPendulum for %d members (%s)", mismatches,
+              IntegratorName(integrator));
+    }
+}
+
+// a few dozen steps, before chaos amplifies rounding differences: every
+// member of every optimized kernel must stay close to the reference
+static void TestShortHorizon(Random& r) {
+    const float STEPS[] = { 0.001f, 0.005f, 0.01f };
+    const int HORIZON = 20;
+    const double ANGLE_TOLERANCE = 1e-4;
+    const double OMEGA_TOLERANCE = 1e-3;
+
+    for (int i = 0; i < INTEGRATOR_COUNT; i++) {
+        Integrator integrator = Integrator(i);
+        double worstAngle = 0.0, worstOmega = 0.0;
+
+        for (int c = 0; c < 16; c++) {
+            PendulumParams p = RandomParams(r);
+            float dt = STEPS[c % 3];
+
+            // an odd size so the last SIMD block is partly padding
+            Ensemble reference(53);
+            for (size_t m = 0; m < reference.size; m++) reference.Set(m, RandomState(r, 3.1f, 2.0f));
+            std::vector<PendulumState> start;
+            for (size_t m = 0; m < reference.size; m++) start.push_back(reference.Get(m));
+            RunVariant(reference, p, dt, HORIZON, integrator, VARIANTS[0]);
+
+            for (const Variant& v : VARIANTS) {
+                if (v.kernel == Kernel::Scalar) continue;
+                Ensemble e(start.size());
+                for (size_t m = 0; m < e.size; m++) e.Set(m, start[m]);
+                RunVariant(e, p, dt, HORIZON, integrator, v);
+
+                for (size_t m = 0; m < e.size; m++) {
+                    PendulumState want = reference.Get(m), got = e.Get(m);
+                    double angle = std::max(AngleError(got.theta1, want.theta1), AngleError(got.theta2, want.theta2));
+                    double omega = std::max(std::fabs(got.omega1 - want.omega1) / (1.0 + std::fabs(want.omega1)),
+                                            std::fabs(got.omega2 - want.omega2) / (1.0 + std::fabs(want.omega2)));
+                    worstAngle = std::max(worstAngle, angle);
+                    worstOmega = std::max(worstOmega, omega);
+                }
+            }
+        }
+
+        printf("short horizon  %-14s worst angle %.2e rad, worst omega %.2e (relative)\n",
+               IntegratorName(integrator), worstAngle, worstOmega);
+        CHECK(worstAngle <= ANGLE_TOLERANCE, "%s angle error %.3e", IntegratorName(integrator), worstAngle);
+        CHECK(worstOmega <= OMEGA_TOLERANCE, "%s omega error %.3e", IntegratorName(integrator), worstOmega);
+    }
+}
+
+// Threads only split the ensemble into slices; each member sees exactly
+// the same arithmetic, so threaded results must be bit-identical. The
+// threaded run goes in short calls, as the app advances, so the ensemble's
+// workers are reused and restarted when the thread count changes.
+static void TestThreadsBitwise(Random& r) {
+    PendulumParams p = RandomParams(r);
+    Ensemble single(1000), threaded(1000);
+    for (size_t m = 0; m < single.size; m++) {
+        PendulumState s = RandomState(r, 3.1f, 2.0f);
+        single.Set(m, s);
+        threaded.Set(m, s);
+    }
+    RunVariant(single, p, 0.005f, 500, Integrator::RK4, VARIANTS[1]);
+    Variant fewer = VARIANTS[2];
+    fewer.threads = 3;
+    for (int call = 0; call < 100; call++) RunVariant(threaded, p, 0.005f, 5, Integrator::RK4, call < 50 ? VARIANTS[2] : fewer);
+
+    int mismatches = 0;
+    for (size_t m = 0; m < single.size; m++) {
+        PendulumState a = single.Get(m), b = threaded.Get(m);
+        mismatches += a.theta1 != b.theta1 || a.theta2 != b.theta2 || a.omega1 != b.omega1 || a.omega2 != b.omega2;
+    }
+    CHECK(mismatches == 0, "threaded differs from single-threaded SIMD for %d members", mismatches);
+}
+
+struct EnsembleStats {
+    double meanEnergy;
+    std::vector<double> theta1Histogram;   // pooled over snapshots, normalized
+};
+
+// Long runs of a chaotic ensemble: individual trajectories decorrelate,
+// but the distribution over the ensemble must not depend on the kernel
+static EnsembleStats LongRun(const std::vector<PendulumState>& start, const PendulumParams& p, Integrator integrator,
+                             const Variant& v) {
+    const int BINS = 24, SNAPSHOTS = 40, STEPS_BETWEEN = 100;
+
+    Ensemble e(start.size());
+    for (size_t m = 0; m < e.size; m++) e.Set(m, start[m]);
+
+    EnsembleStats stats;
+    stats.theta1Histogram.assign(BINS, 0.0);
+    double energy = 0.0;
+    for (int snapshot = 0; snapshot < SNAPSHOTS; snapshot++) {
+        RunVariant(e, p, 0.002f, STEPS_BETWEEN, integrator, v);
+        for (size_t m = 0; m < e.size; m++) {
+            PendulumState s = e.Get(m);
+            energy += Energy(s, p);
+            int bin = int((WrapAngle(s.theta1) / TWO_PI + 0.5) * BINS);
+            stats.theta1Histogram[std::min(std::max(bin, 0), BINS - 1)] += 1.0;
+        }
+    }
+
+    double samples = double(SNAPSHOTS) * e.size;
+    stats.meanEnergy = energy / samples;
+    for (double& bin : stats.theta1Histogram) bin /= samples;
+    return stats;
+}
+
+static void TestLongHorizon(Random& r) {
+    const double TOTAL_VARIATION_TOLERANCE = 0.05;
+    const double ENERGY_TOLERANCE = 0.01;   // of the energy scale
+
+    PendulumParams p = RandomParams(r);
+    std::vector<PendulumState> start;
+    for (int m = 0; m < 2048; m++) start.push_back(RandomState(r, 3.1f, 1.0f));
+
+    for (Integrator integrator : { Integrator::SemiImplicitEuler, Integrator::RK4 }) {
+        EnsembleStats reference = LongRun(start, p, integrator, VARIANTS[0]);
+        for (const Variant& v : VARIANTS) {
+            if (v.kernel == Kernel::Scalar) continue;
+            EnsembleStats got = LongRun(start, p, integrator, v);
+
+            double totalVariation = 0.0;
+            for (size_t b = 0; b < got.theta1Histogram.size(); b++) {
+                totalVariation += 0.5 * std::fabs(got.theta1Histogram[b] - reference.theta1Histogram[b]);
+            }
+            double energy = std::fabs(got.meanEnergy - reference.meanEnergy) / EnergyScale(p);
+
+            printf("long horizon   %-14s %-9s theta1 TV distance %.4f, mean energy %.2e\n",
+                   IntegratorName(integrator), v.name, totalVariation, energy);
+            CHECK(totalVariation <= TOTAL_VARIATION_TOLERANCE, "%s/%s theta1 distribution TV %.4f",
+                  v.name, IntegratorName(integrator), totalVariation);
+            CHECK(energy <= ENERGY_TOLERANCE, "%s/%s mean energy off by %.3e", v.name, IntegratorName(integrator),
+                  energy);
+        }
+    }
+}
+
+// Midpoint and RK4 should hold energy at small steps. Semi-implicit
+// Euler is not symplectic in these (theta, omega) coordinates and drifts
+// by O(dt), so it is only held to what the reference does. No optimized
+// kernel may drift noticeably more than the reference on the same cases.
+static void TestEnergy(Random& r) {
+    struct Bound {
+        Integrator integrator;
+        double tolerance;   // max drift as a fraction of the energy scale, < 0 for none
+    };
+    const Bound BOUNDS[] = {
+        { Integrator::SemiImplicitEuler, -1.0 },
+        { Integrator::Midpoint, 1e-3 },
+        { Integrator::RK4, 1e-4 },
+    };
+    const int CASES = 8;
+
+    std::vector<PendulumParams> params;
+    std::vector<PendulumState> starts;
+    for (int c = 0; c < CASES; c++) {
+        params.push_back(ModerateParams(r));
+        for (int m = 0; m < 64; m++) starts.push_back(RandomState(r, 1.5f, 1.0f));
+    }
+
+    for (const Bound& bound : BOUNDS) {
+        double reference = 0.0;
+        for (const Variant& v : VARIANTS) {
+            double worst = 0.0;
+            for (int c = 0; c < CASES; c++) {
+                const PendulumParams& p = params[c];
+                Ensemble e(64);
+                for (size_t m = 0; m < e.size; m++) e.Set(m, starts[c * 64 + m]);
+
+                std::vector<double> initial;
+                for (size_t m = 0; m < e.size; m++) initial.push_back(Energy(e.Get(m), p));
+                RunVariant(e, p, 0.001f, 5000, bound.integrator, v);
+
+                for (size_t m = 0; m < e.size; m++) {
+                    double drift = std::fabs(Energy(e.Get(m), p) - initial[m]) / EnergyScale(p);
+                    worst = std::max(worst, drift);
+                }
+            }
+            if (v.kernel == Kernel::Scalar) reference = worst;
+
+            printf("energy         %-14s %-9s worst drift %.2e\n", IntegratorName(bound.integrator), v.name, worst);
+            if (bound.tolerance >= 0.0) {
+                CHECK(worst <= bound.tolerance, "%s/%s energy drift %.3e", v.name,
+                      IntegratorName(bound.integrator), worst);
+            }
+            CHECK(worst <= reference * 1.25 + 1e-4, "%s/%s energy drift %.3e vs reference %.3e", v.name,
+                  IntegratorName(bound.integrator), worst, reference);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    unsigned long long seed = argc > 1 ? strtoull(argv[1], nullptr, 10) : 20240601ull;
+    printf("seed %llu\n", seed);
+
+    Random r(seed);
+    TestReferenceIdentity(r);
+    TestShortHorizon(r);
+    TestThreadsBitwise(r);
+    TestLongHorizon(r);
+    TestEnergy(r);
+
+    printf("%d of %d checks failed\n", failures, checks);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,112 @@
+// Text export: every value written must read back to the same float, steps
+// must come out in order, and under Drop and Decimate every pushed step
+// must be accounted for as exported, dropped or decimated.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "ensemble.h"
+#include "exporter.h"
+
+static std::vector<std::string> ReadLines(const char* path) {
+    std::vector<std::string> lines;
+    FILE* in = fopen(path, "rb");
+    if (!in) return lines;
+    char line[1024];
+    while (fgets(line, sizeof(line), in)) {
+        lines.push_back(line);
+        if (!lines.back().empty() && lines.back().back() == '\n') lines.back().pop_back();
+    }
+    fclose(in);
+    return lines;
+}
+
+static bool SameBits(float a, float b) {
+    return memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+// pushes steps of a small ensemble and checks the text against them
+static void Export(const char* path, Exporter::Format format, Exporter::Backpressure policy, size_t queueSteps,
+                   int steps, bool lossless) {
+    const size_t members = 3;
+    const float dt = 0.005f;
+    PendulumParams p{ 0.3f, 0.3f, 1.0f, 1.0f, 9.81f };
+    Ensemble e(members);
+    for (size_t m = 0; m < members; m++) e.Set(m, PendulumState{ 1.0f + 0.7f * m, -0.5f, 0.1f * m, 0.0f });
+
+    Exporter exporter;
+    CHECK(exporter.Open(path, members, dt, format, policy, queueSteps), "could not open %s", path);
+
+    std::vector<float> expected;
+    AdvanceOptions options;
+    for (int s = 0; s < steps; s++) {
+        Advance(e, p, dt, 1, options);
+        exporter.Push(e);
+        for (size_t m = 0; m < members; m++) {
+            PendulumState st = e.Get(m);
+            expected.insert(expected.end(), { st.theta1, st.theta2, st.omega1, st.omega2 });
+        }
+    }
+    CHECK(exporter.Close(), "close failed");
+
+    uint64_t offered = exporter.offered, exported = exporter.exported;
+    uint64_t lost = exporter.dropped + exporter.decimated;
+    printf("%-22s %6llu offered %6llu exported %6llu lost %5llu stalls\n", path, (unsigned long long)offered,
+           (unsigned long long)exported, (unsigned long long)lost, (unsigned long long)exporter.stalls.load());
+    CHECK(offered == uint64_t(steps) && exported + lost == offered, "steps not accounted for");
+    if (lossless) CHECK(exported == offered, "lost %llu steps", (unsigned long long)lost);
+
+    std::vector<std::string> lines = ReadLines(path);
+    size_t first = 0;
+    if (format == Exporter::Format::Csv) {
+        CHECK(!lines.empty() && lines[0] == "step,time,member,theta1,theta2,omega1,omega2", "bad CSV header");
+        first = 1;
+    }
+    CHECK(lines.size() - first == exported * members, "%zu lines for %llu steps", lines.size() - first,
+          (unsigned long long)exported);
+
+    int mismatches = 0;
+    long long lastStep = -1;
+    for (size_t i = first; i < lines.size(); i++) {
+        unsigned long long step, member;
+        double time;
+        float v[4];
+        int n;
+        if (format == Exporter::Format::Csv) {
+            n = sscanf(lines[i].c_str(), "%llu,%lf,%llu,%f,%f,%f,%f", &step, &time, &member, &v[0], &v[1], &v[2], &v[3]);
+        } else {
+            n = sscanf(lines[i].c_str(),
+                       "{\"step\":%llu,\"time\":%lf,\"member\":%llu,\"theta1\":%f,\"theta2\":%f,\"omega1\":%f,\"omega2\":%f}",
+                       &step, &time, &member, &v[0], &v[1], &v[2], &v[3]);
+        }
+        if (n != 7 || step >= uint64_t(steps) || member >= members) {
+            mismatches++;
+            continue;
+        }
+        // steps increase, members in order within a step
+        if (member == 0) {
+            mismatches += (long long)step <= lastStep;
+            lastStep = (long long)step;
+        }
+        for (int c = 0; c < 4; c++) mismatches += !SameBits(v[c], expected[(step * members + member) * 4 + c]);
+    }
+    CHECK(mismatches == 0, "%d lines differ from what was pushed", mismatches);
+    remove(path);
+}
+
+int main() {
+    // a ring of a few steps makes the writer fall behind immediately
+    Export("test_block.csv", Exporter::Format::Csv, Exporter::Backpressure::Block, 4, 20000, true);
+    Export("test_block.ndjson", Exporter::Format::Ndjson, Exporter::Backpressure::Block, 4, 5000, true);
+    Export("test_drop.csv", Exporter::Format::Csv, Exporter::Backpressure::Drop, 4, 20000, false);
+    Export("test_decimate.ndjson", Exporter::Format::Ndjson, Exporter::Backpressure::Decimate, 4, 20000, false);
+    // the default ring absorbs a short burst without losing anything
+    Export("test_default.csv", Exporter::Format::Csv, Exporter::Backpressure::Drop, 0, 2000, true);
+
+    printf("%d of %d checks failed\n", failures, checks);
+    return failures ? 1 : 0;
+}
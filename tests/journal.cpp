@@ -0,0 +1,163 @@
+// Session journals: a scripted session that edits the pendulum the way the
+// app's UI does, between frames of varying length, must replay to the
+// bit-identical trajectory, with or without its footer, and a tampered
+// journal must be caught.
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "batch.h"
+#include "check.h"
+#include "journal.h"
+
+static const char* PATH = "test.pendjournal";
+
+static std::vector<char> ReadFile(const char* path) {
+    std::vector<char> data;
+    FILE* in = fopen(path, "rb");
+    if (!in) return data;
+    fseek(in, 0, SEEK_END);
+    data.resize(size_t(ftell(in)));
+    fseek(in, 0, SEEK_SET);
+    if (fread(data.data(), 1, data.size(), in) != data.size()) data.clear();
+    fclose(in);
+    return data;
+}
+
+static void WriteFile(const char* path, const char* data, size_t bytes) {
+    FILE* out = fopen(path, "wb");
+    fwrite(data, 1, bytes, out);
+    fclose(out);
+}
+
+// The app's frame loop in miniature: the UI edits globals, the journal
+// syncs, then physics takes however many steps the frame time allows.
+// Returns the state after every step.
+static std::vector<PendulumState> Session() {
+    Pendulum pendulum(PendulumState{ 2.0f, -0.5f, 0.0f, 0.0f });
+    PendulumState& state = pendulum.curr;
+    PendulumParams params{ 0.3f, 0.3f, 0.1f, 0.1f, 9.81f };
+    float h = 0.005f, damping = 0.992f;
+    bool paused = false;
+
+    Journal journal;
+    CHECK(journal.Open(PATH, JournalInputs{ state, params, h, damping, paused }), "could not open %s", PATH);
+    std::vector<PendulumState> trajectory;
+    unsigned seed = 12345;
+    auto Random = [&](unsigned range) {
+        seed = seed * 1103515245u + 12345u;
+        return (seed >> 16) % range;
+    };
+
+    for (int frame = 0; frame < 3000; frame++) {
+        // UI: a slider drag, a typed parameter, pause and start, reset
+        switch (Random(40)) {
+            case 0: state.theta1 += 0.01f * float(Random(100)); break;
+            case 1: state.theta2 = -state.theta2; state.omega2 = 0.0f; break;
+            case 2: params.rodLength2 = 0.1f + 0.01f * float(Random(30)); paused = true; break;
+            case 3: params.gravity = 1.0f + float(Random(20)); break;
+            case 4: damping = 0.95f; break;
+            case 5:
+                paused = !paused;
+                if (!paused) {
+                    state.omega1 = state.omega2 = 0.0f;
+                    pendulum.Set(state);
+                    journal.Mark(JournalEvent::Start);
+                }
+                break;
+            case 6: h = Random(2) ? 0.002f : 0.005f; break;
+            case 7:
+                pendulum.Set(PendulumState{ 2.0f, -0.5f, 0.0f, 0.0f });
+                params = PendulumParams{ 0.3f, 0.3f, 0.1f, 0.1f, 9.81f };
+                paused = true;
+                journal.Mark(JournalEvent::Reset);
+                break;
+            default: break;
+        }
+        journal.Sync(JournalInputs{ state, params, h, damping, paused });
+
+        if (!paused) {
+            int steps = int(Random(6));
+            for (int i = 0; i < steps; i++) {
+                pendulum.Step(params, h);
+                journal.Step(pendulum.curr);
+                trajectory.push_back(pendulum.curr);
+            }
+        } else {
+            pendulum.Set(state);
+        }
+    }
+    CHECK(journal.Close(), "close failed");
+    return trajectory;
+}
+
+static void TestReplay() {
+    std::vector<PendulumState> trajectory = Session();
+    std::vector<char> file = ReadFile(PATH);
+    CHECK(trajectory.size() > 1000, "session took only %zu steps", trajectory.size());
+    // events only: far smaller than the trajectory itself
+    CHECK(file.size() < trajectory.size() * sizeof(PendulumState) / 4, "journal is %zu bytes for %zu steps",
+          file.size(), trajectory.size());
+
+    JournalReplay replay;
+    CHECK(replay.Open(PATH) && replay.ended && replay.steps == trajectory.size(), "replay has %llu steps, wanted %zu",
+          (unsigned long long)replay.steps, trajectory.size());
+    size_t mismatches = 0;
+    for (size_t i = 0; replay.Step(); i++) {
+        mismatches += i >= trajectory.size() || memcmp(&replay.inputs.state, &trajectory[i], sizeof(PendulumState)) != 0;
+    }
+    CHECK(mismatches == 0 && replay.step == trajectory.size(), "%zu of %zu steps differ", mismatches, trajectory.size());
+    CHECK(replay.Verified(), "hash doesn't match the session");
+
+    // the batch entry point, writing the final state
+    const char* args[] = { "pendsim", "--batch", "--replay", PATH, "--output", "test_replay.txt", "--quiet" };
+    CHECK(BatchMain(7, const_cast<char**>(args)) == 0, "batch replay failed");
+    FILE* in = fopen("test_replay.txt", "r");
+    char line[256];
+    float v[4];
+    bool read = in && fgets(line, sizeof(line), in) && fscanf(in, "0,%f,%f,%f,%f", &v[0], &v[1], &v[2], &v[3]) == 4;
+    if (in) fclose(in);
+    CHECK(read && v[0] == trajectory.back().theta1 && v[3] == trajectory.back().omega2, "batch replay final state");
+    remove("test_replay.txt");
+
+    // one flipped bit in the starting state is noticed
+    JournalHeader header;
+    memcpy(&header, file.data(), sizeof(header));
+    header.state.theta1 = nextafterf(header.state.theta1, 4.0f);
+    memcpy(file.data(), &header, sizeof(header));
+    WriteFile(PATH, file.data(), file.size());
+    CHECK(BatchMain(7, const_cast<char**>(args)) == 1, "tampered journal verified");
+    remove("test_replay.txt");
+}
+
+static void TestCrash() {
+    // a crash loses the end record and footer, and maybe more
+    std::vector<PendulumState> trajectory = Session();
+    std::vector<char> file = ReadFile(PATH);
+    WriteFile(PATH, file.data(), file.size() - sizeof(JournalFooter) - 1);
+
+    JournalReplay replay;
+    CHECK(replay.Open(PATH) && !replay.ended, "truncated journal not opened as unfinished");
+    size_t mismatches = 0;
+    while (replay.Step()) {
+        size_t i = replay.step - 1;
+        mismatches += i >= trajectory.size() || memcmp(&replay.inputs.state, &trajectory[i], sizeof(PendulumState)) != 0;
+    }
+    CHECK(mismatches == 0 && replay.step > 0 && replay.step <= trajectory.size(),
+          "%zu steps differ replaying %llu steps of a crashed session", mismatches, (unsigned long long)replay.step);
+    CHECK(!replay.Verified(), "unfinished journal verified");
+
+    WriteFile(PATH, "PENDJNL0", 8);
+    CHECK(!replay.Open(PATH), "garbage accepted");
+    remove(PATH);
+}
+
+int main() {
+    TestReplay();
+    TestCrash();
+
+    printf("%d of %d checks failed\n", failures, checks);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,275 @@
+// Trajectory recording round trip: an ensemble is recorded step by step,
+// the file is decoded chunk by chunk, and every value must come back bit
+// for bit. Also checks that smooth trajectories actually compress, and
+// that TrajectoryReader seeks to the same values with or without the
+// index footer.
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "check.h"
+#include "ensemble.h"
+#include "recorder.h"
+#include "trajectoryFormat.h"
+#include "trajectoryReader.h"
+
+static std::vector<char> ReadFile(const char* path) {
+    std::vector<char> data;
+    FILE* in = fopen(path, "rb");
+    if (!in) return data;
+    fseek(in, 0, SEEK_END);
+    data.resize(size_t(ftell(in)));
+    fseek(in, 0, SEEK_SET);
+    if (fread(data.data(), 1, data.size(), in) != data.size()) data.clear();
+    fclose(in);
+    return data;
+}
+
+// seeks all over a recording through TrajectoryReader
+static void ReadBack(const char* path, size_t members, int steps, const std::vector<float>& expected, bool indexed) {
+    TrajectoryReader reader;
+    CHECK(reader.Open(path), "reader could not open %s", path);
+    CHECK(reader.indexed == indexed && reader.steps == uint64_t(steps) && reader.header.members == members,
+          "reader sees %llu steps, indexed %d", (unsigned long long)reader.steps, int(reader.indexed));
+
+    auto want = [&](uint64_t step, int column, size_t m) {
+        return expected[(step * TRAJECTORY_COLUMNS + column) * members + m];
+    };
+
+    // random seeks, backwards and across chunks
+    int mismatches = 0;
+    uint32_t seed = 12345;
+    for (int i = 0; i < 200; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        uint64_t step = (seed >> 8) % uint64_t(steps);
+        size_t m = (seed >> 4) % members;
+        PendulumState s;
+        if (!reader.Read(step, m, s)) {
+            mismatches++;
+            continue;
+        }
+        float got[TRAJECTORY_COLUMNS] = { s.theta1, s.theta2, s.omega1, s.omega2 };
+        for (int c = 0; c < TRAJECTORY_COLUMNS; c++) {
+            float w = want(step, c, m);
+            mismatches += memcmp(&got[c], &w, sizeof(float)) != 0;
+        }
+    }
+
+    // sequential playback of whole steps
+    reader.Advise(TrajectoryReader::Access::Sequential);
+    std::vector<float> columns(members * TRAJECTORY_COLUMNS);
+    float* c0 = columns.data();
+    for (int step = 0; step < steps; step++) {
+        if (!reader.ReadStep(step, c0, c0 + members, c0 + 2 * members, c0 + 3 * members)) {
+            mismatches++;
+            continue;
+        }
+        mismatches += memcmp(c0, &expected[size_t(step) * TRAJECTORY_COLUMNS * members],
+                             columns.size() * sizeof(float)) != 0;
+    }
+
+    PendulumState s;
+    CHECK(!reader.Read(steps, 0, s) && !reader.Read(0, members, s), "read past the end succeeded");
+    CHECK(mismatches == 0, "reader: %d values differ (indexed %d)", mismatches, int(indexed));
+}
+
+// records steps of an ensemble, keeping every snapshot for comparison
+static void RoundTrip(const char* path, size_t members, float dt, int steps, uint32_t chunkSteps, double minRatio) {
+    PendulumParams p{ 0.3f, 0.3f, 1.0f, 1.0f, 9.81f };
+    Ensemble e(members);
+    for (size_t m = 0; m < members; m++) {
+        e.Set(m, PendulumState{ 0.5f + 2.5f * m / members, -1.0f + 0.001f * m, 0.0f, 0.0f });
+    }
+
+    Recorder recorder;
+    CHECK(recorder.Open(path, members, dt, p, Integrator::RK4, chunkSteps), "could not open %s", path);
+
+    std::vector<float> expected;
+    AdvanceOptions options;
+    options.integrator = Integrator::RK4;
+    for (int s = 0; s < steps; s++) {
+        Advance(e, p, dt, 1, options);
+        recorder.Record(e);
+        for (const float* column : { e.theta1, e.theta2, e.omega1, e.omega2 }) {
+            expected.insert(expected.end(), column, column + members);
+        }
+    }
+    CHECK(recorder.Close(), "close failed");
+
+    std::vector<char> file = ReadFile(path);
+    CHECK(file.size() == recorder.fileBytes, "file is %zu bytes, recorder counted %llu", file.size(),
+          (unsigned long long)recorder.fileBytes.load());
+
+    RecordingHeader header;
+    memcpy(&header, file.data(), sizeof(header));
+    CHECK(memcmp(header.magic, "PENDREC1", 8) == 0 && header.members == members && header.version == TRAJECTORY_VERSION,
+          "bad recording header");
+
+    IndexFooter footer;
+    memcpy(&footer, file.data() + file.size() - sizeof(footer), sizeof(footer));
+    CHECK(memcmp(footer.magic, "PENDIDX1", 8) == 0 && footer.steps == uint64_t(steps), "bad index footer");
+
+    // walk the chunks and decode every column
+    size_t offset = sizeof(header);
+    uint64_t decodedSteps = 0;
+    int mismatches = 0;
+    bool corrupt = false;
+    std::vector<float> values(members);
+    while (offset + sizeof(ChunkHeader) <= footer.indexOffset) {
+        ChunkHeader chunk;
+        memcpy(&chunk, file.data() + offset, sizeof(chunk));
+        offset += sizeof(chunk);
+        CHECK(memcmp(chunk.magic, "CHNK", 4) == 0 && chunk.firstStep == decodedSteps, "bad chunk header at step %llu",
+              (unsigned long long)decodedSteps);
+
+        for (int c = 0; c < TRAJECTORY_COLUMNS; c++) {
+            ColumnDecoder decoder;
+            decoder.Begin(file.data() + offset, chunk.columnBytes[c], members);
+            for (uint32_t s = 0; s < chunk.steps; s++) {
+                decoder.Decode(values.data(), int(s));
+                const float* want = &expected[((chunk.firstStep + s) * TRAJECTORY_COLUMNS + c) * members];
+                for (size_t m = 0; m < members; m++) mismatches += memcmp(&values[m], &want[m], sizeof(float)) != 0;
+            }
+            corrupt |= decoder.overrun;
+            offset += chunk.columnBytes[c];
+        }
+        decodedSteps += chunk.steps;
+    }
+
+    double ratio = double(recorder.RawBytes()) / double(file.size());
+    printf("%-28s %6zu members %6d steps  ratio %.2f\n", path, members, steps, ratio);
+    CHECK(decodedSteps == uint64_t(steps), "decoded %llu of %d steps", (unsigned long long)decodedSteps, steps);
+    CHECK(mismatches == 0 && !corrupt, "%d values differ after decoding", mismatches);
+    CHECK(ratio >= minRatio, "compression ratio %.2f below %.2f", ratio, minRatio);
+
+    ReadBack(path, members, steps, expected, true);
+
+    // a recording that was never closed has no footer: drop it and the
+    // reader must find the same chunks from their headers
+    FILE* out = fopen(path, "wb");
+    fwrite(file.data(), 1, footer.indexOffset, out);
+    fclose(out);
+    ReadBack(path, members, steps, expected, false);
+    remove(path);
+}
+
+static void WriteFile(const char* path, const std::vector<char>& data) {
+    FILE* out = fopen(path, "wb");
+    fwrite(data.data(), 1, data.size(), out);
+    fclose(out);
+}
+
+// Damaged recordings must fail cleanly, never read outside the file.
+static void TestCorrupt() {
+    const char* path = "test_corrupt.pendrec";
+    const size_t MEMBERS = 8;
+    Ensemble e(MEMBERS);
+    for (size_t m = 0; m < MEMBERS; m++) e.Set(m, PendulumState{ 0.1f * m, 1.0f, 0.0f, 0.0f });
+    Recorder recorder;
+    CHECK(recorder.Open(path, MEMBERS, 0.005f, PendulumParams{ 0.3f, 0.3f, 1.0f, 1.0f, 9.81f }, Integrator::RK4, 8),
+          "could not open %s", path);
+    for (int s = 0; s < 50; s++) {
+        Advance(e, PendulumParams{ 0.3f, 0.3f, 1.0f, 1.0f, 9.81f }, 0.005f, 1, AdvanceOptions());
+        recorder.Record(e);
+    }
+    CHECK(recorder.Close(), "close failed");
+    const std::vector<char> good = ReadFile(path);
+    IndexFooter footer;
+    memcpy(&footer, good.data() + good.size() - sizeof(footer), sizeof(footer));
+    std::vector<ChunkIndexEntry> index(footer.chunks);
+    memcpy(index.data(), good.data() + footer.indexOffset, index.size() * sizeof(ChunkIndexEntry));
+    CHECK(footer.chunks == 7, "%llu chunks", (unsigned long long)footer.chunks);
+
+    auto WithFooter = [&](const IndexFooter& f) {
+        std::vector<char> file = good;
+        memcpy(file.data() + file.size() - sizeof(f), &f, sizeof(f));
+        return file;
+    };
+    auto WithEntry = [&](size_t i, const ChunkIndexEntry& entry) {
+        std::vector<char> file = good;
+        memcpy(file.data() + footer.indexOffset + i * sizeof(entry), &entry, sizeof(entry));
+        return file;
+    };
+    IndexFooter hugeCount = footer, wrapped = footer, farOffset = footer, tooManySteps = footer;
+    hugeCount.chunks = uint64_t(1) << 60;
+    wrapped.chunks = uint64_t(1) << 60;
+    wrapped.indexOffset = good.size() - sizeof(footer);
+    farOffset.indexOffset = good.size() * 2;
+    tooManySteps.steps = 1000;
+    ChunkIndexEntry pastEnd = index[3], backwards = index[3];
+    pastEnd.offset = good.size() + 4096;
+    backwards.firstStep = index[1].firstStep;
+
+    struct Case {
+        const char* what;
+        std::vector<char> file;
+    };
+    std::vector<Case> rejected = {
+        { "huge chunk count", WithFooter(hugeCount) },
+        { "chunk count that wraps the index size", WithFooter(wrapped) },
+        { "index offset past the end", WithFooter(farOffset) },
+        { "more steps than the chunks hold", WithFooter(tooManySteps) },
+        { "chunk offset past the end", WithEntry(3, pastEnd) },
+        { "chunks out of order", WithEntry(3, backwards) },
+    };
+    for (const Case& c : rejected) {
+        WriteFile(path, c.file);
+        TrajectoryReader reader;
+        CHECK(!reader.Open(path), "opened a recording with a %s", c.what);
+    }
+
+    // a chunk header claiming more data than its slot fails that chunk only
+    std::vector<char> file = good;
+    ChunkHeader h;
+    memcpy(&h, file.data() + index[2].offset, sizeof(h));
+    h.columnBytes[1] = uint64_t(1) << 62;
+    memcpy(file.data() + index[2].offset, &h, sizeof(h));
+    WriteFile(path, file);
+    TrajectoryReader reader;
+    PendulumState s;
+    CHECK(reader.Open(path) && reader.Read(3, 0, s) && !reader.Read(index[2].firstStep, 0, s) && reader.Read(49, 7, s),
+          "bad chunk header not isolated");
+
+    // so does one whose step count disagrees with the index
+    file = good;
+    memcpy(&h, file.data() + index[4].offset, sizeof(h));
+    h.steps = 4000;
+    memcpy(file.data() + index[4].offset, &h, sizeof(h));
+    WriteFile(path, file);
+    CHECK(reader.Open(path) && !reader.Read(index[4].firstStep + 5, 0, s) && reader.Read(0, 0, s), "bad chunk steps not caught");
+
+    // without a footer, chunk headers with absurd sizes end the rebuilt index
+    file.assign(good.begin(), good.begin() + footer.indexOffset);
+    memcpy(&h, file.data() + index[5].offset, sizeof(h));
+    h.columnBytes[3] = ~uint64_t(0) - 8;
+    memcpy(file.data() + index[5].offset, &h, sizeof(h));
+    WriteFile(path, file);
+    CHECK(reader.Open(path) && !reader.indexed && reader.steps == index[5].firstStep && reader.Read(reader.steps - 1, 7, s) &&
+          !reader.Read(reader.steps, 0, s), "rebuilt index has %llu steps", (unsigned long long)reader.steps);
+
+    // a header and nothing else: no steps, nothing to read
+    file.assign(good.begin(), good.begin() + sizeof(RecordingHeader));
+    WriteFile(path, file);
+    CHECK(reader.Open(path) && reader.steps == 0 && !reader.Read(0, 0, s), "empty recording");
+    remove(path);
+}
+
+int main() {
+    // Compression depends on the step: the finer it is, the better the
+    // extrapolation and the fewer bits each value needs.
+
+    // one pendulum, several full chunks and a partial one
+    RoundTrip("test_single.pendrec", 1, 0.001f, 5000, 1024, 3.5);
+    // an ensemble at the app's step, chunks that don't divide the step count
+    RoundTrip("test_ensemble.pendrec", 1000, 0.005f, 300, 64, 1.6);
+    // tiny chunks: mostly unpredicted first steps, still exact
+    RoundTrip("test_tiny.pendrec", 17, 0.005f, 100, 3, 0.0);
+
+    TestCorrupt();
+
+    printf("%d of %d checks failed\n", failures, checks);
+    return failures ? 1 : 0;
+}
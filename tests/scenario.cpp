@@ -0,0 +1,175 @@
+// Scenario files: parsing, error reporting, and the lazy expansion of
+// grids, clouds, Sobol points and parameter sweeps.
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "check.h"
+#include "scenario.h"
+
+static const float DEG = float(M_PI) / 180.0f;
+
+static bool Parse(Scenario& s, const char* text, char* error = nullptr) {
+    char buffer[256];
+    return s.Parse(text, strlen(text), error ? error : buffer, sizeof(buffer));
+}
+
+static void TestGridAndSweep() {
+    Scenario s;
+    const char* text =
+        "# a map of final angles\n"
+        "dt 0.002\n"
+        "duration 30   # seconds\n"
+        "integrator rk4\n"
+        "threads 4\n"
+        "rod2 0.1:0.5:5\n"
+        "mass2 0.2\n"
+        "sampling grid\n"
+        "theta1 -180:180:512\n"
+        "theta2   -90:90:3  \r\n"
+        "omega1 0.5\n"
+        "output maps/final.csv";
+    char error[256] = "";
+    CHECK(Parse(s, text, error), "parse failed: %s", error);
+    CHECK(s.dt == 0.002f && s.duration == 30.0 && s.integrator == Integrator::RK4 && s.threads == 4,
+          "run settings not read");
+    CHECK(strcmp(s.output, "maps/final.csv") == 0, "output is '%s'", s.output);
+    CHECK(s.Members() == 512 * 3 && s.Runs() == 5, "%llu members, %llu runs", (unsigned long long)s.Members(),
+          (unsigned long long)s.Runs());
+
+    // theta1 varies fastest
+    PendulumState first = s.Member(0), second = s.Member(1), last = s.Member(s.Members() - 1);
+    CHECK(std::fabs(first.theta1 + 180.0f * DEG) < 1e-6f && std::fabs(first.theta2 + 90.0f * DEG) < 1e-6f,
+          "first grid point (%g, %g)", first.theta1, first.theta2);
+    CHECK(std::fabs(second.theta1 - first.theta1 - 360.0f / 511.0f * DEG) < 1e-5f && second.theta2 == first.theta2,
+          "second grid point moved the wrong axis");
+    CHECK(std::fabs(last.theta1 - 180.0f * DEG) < 1e-5f && std::fabs(last.theta2 - 90.0f * DEG) < 1e-5f,
+          "last grid point (%g, %g)", last.theta1, last.theta2);
+    CHECK(first.omega1 == 0.5f && first.omega2 == 0.0f, "fixed values not applied");
+
+    PendulumParams p0 = s.Params(0), p4 = s.Params(4);
+    CHECK(p0.rodLength2 == 0.1f && std::fabs(p4.rodLength2 - 0.5f) < 1e-6f && p0.mass2 == 0.2f && p0.rodLength == 0.3f,
+          "sweep gives rod2 %g..%g", p0.rodLength2, p4.rodLength2);
+}
+
+static void TestCloud() {
+    Scenario s;
+    CHECK(Parse(s, "sampling cloud\nmembers 1e9\nseed 7\ntheta1 120~2\ntheta2 -10:10\nomega2 3\n"), "parse failed");
+    CHECK(s.Members() == 1000000000ull, "members %llu", (unsigned long long)s.Members());
+
+    // statistics of a prefix, and the far end computed without the rest
+    const int N = 20000;
+    double sum = 0.0, sum2 = 0.0;
+    float lo = 1e9f, hi = -1e9f;
+    for (int i = 0; i < N; i++) {
+        PendulumState m = s.Member(i);
+        sum += m.theta1;
+        sum2 += double(m.theta1) * m.theta1;
+        lo = std::min(lo, m.theta2);
+        hi = std::max(hi, m.theta2);
+        if (m.omega2 != 3.0f) failures++;
+    }
+    double mean = sum / N, sd = std::sqrt(sum2 / N - mean * mean);
+    CHECK(std::fabs(mean - 120.0 * DEG) < 0.002 && std::fabs(sd - 2.0 * DEG) < 0.002, "cloud mean %g sd %g", mean, sd);
+    CHECK(lo >= -10.0f * DEG && hi <= 10.0f * DEG && hi - lo > 19.0f * DEG, "uniform range [%g, %g]", lo, hi);
+
+    PendulumState far1 = s.Member(999999999), far2 = s.Member(999999999);
+    CHECK(memcmp(&far1, &far2, sizeof(far1)) == 0 && std::isfinite(far1.theta1), "members are not reproducible");
+
+    Scenario other;
+    Parse(other, "sampling cloud\nmembers 10\nseed 8\ntheta1 120~2\n");
+    CHECK(other.Member(3).theta1 != s.Member(3).theta1, "seed has no effect");
+}
+
+static void TestSobol() {
+    // 2^10 - 1 points: with the omitted origin they form a (0, 10, 2)-net,
+    // so every elementary interval of area 2^-10 holds at most one point.
+    // The unit box keeps the points exactly on their dyadic coordinates.
+    Scenario s;
+    CHECK(Parse(s, "sampling sobol\nmembers 1023\ntheta1 30\nomega1 0:1\nomega2 0:1\n"), "parse failed");
+    const int N = 1023;
+    std::vector<int> line(1024, 0), square(1024, 0), strip(1024, 0);
+    int outside = 0;
+    for (int i = 0; i < N; i++) {
+        PendulumState m = s.Member(i);
+        double u = m.omega1, v = m.omega2;
+        outside += u <= 0 || u >= 1 || v <= 0 || v >= 1 || m.theta1 != 30.0f * DEG;
+        line[int(u * 1024)]++;
+        square[int(u * 32) * 32 + int(v * 32)]++;
+        strip[int(u * 2) * 512 + int(v * 512)]++;
+    }
+    int crowded = 0;
+    for (int i = 0; i < 1024; i++) crowded += line[i] > 1 || square[i] > 1 || strip[i] > 1;
+    CHECK(outside == 0, "%d points outside the box", outside);
+    CHECK(crowded == 0, "%d elementary intervals hold more than one point", crowded);
+
+    // all four dimensions stay inside their boxes
+    Parse(s, "sampling sobol\nmembers 4096\ntheta1 0:360\ntheta2 -90:90\nomega1 -1:1\nomega2 -2:2\n");
+    outside = 0;
+    for (int i = 0; i < 4096; i++) {
+        PendulumState m = s.Member(i);
+        outside += m.theta1 < 0 || m.theta1 > 360.0f * DEG || std::fabs(m.theta2) > 90.0f * DEG ||
+                   std::fabs(m.omega1) > 1.0f || std::fabs(m.omega2) > 2.0f;
+    }
+    CHECK(outside == 0, "%d points outside the 4D box", outside);
+}
+
+static void TestErrors() {
+    struct Case {
+        const char* text;
+        const char* message;    // expected in the error
+    };
+    const Case cases[] = {
+        { "dt 0.01\nfoo 3\n", "line 2: unknown key 'foo'" },
+        { "dt -1\n", "line 1: bad value '-1'" },
+        { "integrator leapfrog\n", "bad value 'leapfrog'" },
+        { "theta1\n", "missing value for 'theta1'" },
+        { "theta1 0:90\n", "need sampling grid" },
+        { "sampling grid\ntheta1 0:90\n", "need a count" },
+        { "sampling grid\ntheta1 1~2\n", "needs sampling cloud" },
+        { "rod1 0.1:0.2\n", "swept parameters need a count" },
+        { "rod1 0.1~0.01\n", "bad value" },
+        { "sampling sobol\nmembers 5e9\ntheta1 0:1\n", "2^32" },
+        { "sampling tiles\n", "bad value 'tiles'" },
+        { "rod2 0\n", "line 1: bad value '0'" },
+        { "mass1 -0.1:0.5:3\n", "bad value" },
+        { "threads 0\n", "bad value '0'" },
+        { "rod1 1:2:4e9\nrod2 1:2:4e9\nmass1 1:2:4e9\n", "too many runs" },
+    };
+    for (const Case& c : cases) {
+        Scenario s;
+        char error[256] = "";
+        bool ok = Parse(s, c.text, error);
+        CHECK(!ok && strstr(error, c.message), "'%s' gave '%s', wanted '%s'", c.text, error, c.message);
+    }
+
+    // the defaults are the app's startup state
+    Scenario s;
+    CHECK(Parse(s, "") && s.Members() == 1 && s.Runs() == 1 && s.Params(0).mass == 0.1f && s.dt == 0.005f,
+          "empty scenario isn't the default");
+}
+
+static void TestLoad() {
+    const char* path = "test_scenario.txt";
+    FILE* out = fopen(path, "w");
+    fprintf(out, "sampling grid\ntheta1 0:10:11\n");
+    fclose(out);
+    Scenario s;
+    char error[256] = "";
+    CHECK(s.Load(path, error, sizeof(error)) && s.Members() == 11, "load failed: %s", error);
+    remove(path);
+    CHECK(!s.Load("no_such_scenario.txt", error, sizeof(error)) && strstr(error, "could not open"), "missing file");
+}
+
+int main() {
+    TestGridAndSweep();
+    TestCloud();
+    TestSobol();
+    TestErrors();
+    TestLoad();
+
+    printf("%d of %d checks failed\n", failures, checks);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,125 @@
+// Shared-memory ring: snapshots read in place must match what was
+// published, a lapped reader must be told so, and a reader in another
+// process racing the producer must never validate a torn snapshot.
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <sched.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "check.h"
+#include "ensemble.h"
+#include "sharedRing.h"
+
+static char name[64];
+
+static void TestPublishAndLap() {
+    SharedRing ring;
+    CHECK(ring.Create(name, 3, 3, 0.01f), "could not create %s", name);
+    CHECK(ring.header->slots == 4, "3 slots rounded to %u", ring.header->slots);
+
+    SharedRingReader reader;
+    CHECK(reader.Open(name), "could not open %s", name);
+    if (!reader.IsOpen()) return;
+    SharedView view;
+    CHECK(reader.Published() == 0 && !reader.Acquire(0, view), "snapshot before any was published");
+
+    Ensemble e(3);
+    for (size_t m = 0; m < 3; m++) e.Set(m, PendulumState{ float(m), 10.0f + m, 20.0f + m, 30.0f + m });
+    PendulumParams p{ 0.3f, 0.25f, 0.1f, 0.2f, 9.81f };
+    ring.Publish(e, 7, 0.07, p);
+    CHECK(reader.Published() == 1 && reader.Acquire(0, view), "first snapshot not readable");
+    CHECK(view.step == 7 && view.time == 0.07 && view.params.mass2 == 0.2f && view.members == 3, "snapshot header");
+    CHECK(view.theta1[2] == 2.0f && view.theta2[0] == 10.0f && view.omega1[1] == 21.0f && view.omega2[2] == 32.0f,
+          "columns read back wrong");
+    CHECK(reader.Validate(view), "untouched view failed validation");
+
+    // four more snapshots reuse slot 0
+    for (int i = 1; i <= 4; i++) ring.Publish(e, 7 + i, 0.07 + i * 0.01, p);
+    CHECK(!reader.Validate(view), "overwritten view still validates");
+    CHECK(!reader.Acquire(0, view) && reader.Acquire(4, view) && view.step == 11, "lapped snapshot acquired");
+
+    // a single pendulum can't go into a three-member ring
+    ring.Publish(PendulumState{ 1.0f, 2.0f, 3.0f, 4.0f }, 12, 0.12, p);
+    CHECK(reader.Published() == 5, "wrong-sized snapshot published");
+
+    ring.Close();
+    CHECK(reader.Closed(), "reader not told the producer closed");
+    SharedRingReader late;
+    CHECK(!late.Open(name), "closed ring still opens by name");
+}
+
+// Every value of snapshot n is n, so a torn read shows as a mix. The
+// reader chases the newest snapshot while the producer laps it.
+static int ChaseNewest(int ready) {
+    SharedRingReader reader;
+    bool opened = reader.Open(name);
+    if (write(ready, "x", 1) != 1 || !opened) return 2;
+
+    uint64_t validated = 0, torn = 0;
+    while (true) {
+        bool closed = reader.Closed();
+        uint64_t published = reader.Published();
+        SharedView view;
+        if (published && reader.Acquire(published - 1, view)) {
+            bool mixed = false;
+            float want = float(view.snapshot);
+            for (size_t m = 0; m < view.members; m++) {
+                mixed |= view.theta1[m] != want || view.omega2[m] != want;
+            }
+            mixed |= view.step != view.snapshot;
+            if (reader.Validate(view)) {
+                validated++;
+                torn += mixed;
+            }
+        }
+        if (closed) break;
+        sched_yield();
+    }
+    printf("reader: %llu snapshots validated, %llu torn\n", (unsigned long long)validated, (unsigned long long)torn);
+    fflush(stdout);
+    return validated > 0 && torn == 0 ? 0 : 1;
+}
+
+static void TestOtherProcess() {
+    const size_t MEMBERS = 4096;
+    const int SNAPSHOTS = 20000;
+    SharedRing ring;
+    CHECK(ring.Create(name, MEMBERS, 8, 0.01f), "could not create %s", name);
+    if (!ring.IsOpen()) return;
+
+    int pipes[2];
+    CHECK(pipe(pipes) == 0, "no pipe");
+    fflush(stdout);
+    pid_t child = fork();
+    if (child == 0) _exit(ChaseNewest(pipes[1]));
+    char byte;
+    CHECK(read(pipes[0], &byte, 1) == 1, "reader never started");
+
+    Ensemble e(MEMBERS);
+    PendulumParams p{ 0.3f, 0.3f, 0.1f, 0.1f, 9.81f };
+    for (int n = 0; n < SNAPSHOTS; n++) {
+        e.Fill(PendulumState{ float(n), float(n), float(n), float(n) });
+        ring.Publish(e, uint64_t(n), n * 0.01, p);
+        if (n % 64 == 0) sched_yield();
+    }
+    ring.Close();
+
+    int status = 0;
+    waitpid(child, &status, 0);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0, "reader process failed (status %d)", status);
+    close(pipes[0]);
+    close(pipes[1]);
+}
+
+int main() {
+    snprintf(name, sizeof(name), "/pendsim_test_%d", int(getpid()));
+    TestPublishAndLap();
+    TestOtherProcess();
+
+    printf("%d of %d checks failed\n", failures, checks);
+    return failures ? 1 : 0;
+}
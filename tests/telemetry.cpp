@@ -0,0 +1,229 @@
+// Telemetry socket: each subscriber gets exactly the fields, steps and
+// members it asked for, hundreds of subscribers are served at once, and a
+// subscriber that stops reading loses frames (and is told so) instead of
+// holding anything up.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "check.h"
+#include "ensemble.h"
+#include "telemetry.h"
+
+static const char* PATH = "test_telemetry.sock";
+static const PendulumParams PARAMS{ 0.3f, 0.25f, 0.1f, 0.2f, 9.81f };
+
+static int Connect() {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, PATH);
+    timeval timeout = { 5, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static bool ReadAll(int fd, void* data, size_t bytes) {
+    char* p = static_cast<char*>(data);
+    while (bytes > 0) {
+        ssize_t got = recv(fd, p, bytes, 0);
+        if (got <= 0) return false;
+        p += got;
+        bytes -= size_t(got);
+    }
+    return true;
+}
+
+static int Subscribe(uint32_t members, TelemetrySubscribe request) {
+    int fd = Connect();
+    TelemetryHello hello;
+    if (fd < 0 || !ReadAll(fd, &hello, sizeof(hello)) || memcmp(hello.magic, "PENDTLM1", 8) != 0 ||
+        hello.members != members || send(fd, &request, sizeof(request), 0) != ssize_t(sizeof(request))) {
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static bool WaitFor(const std::atomic<uint64_t>& counter, uint64_t value) {
+    for (int i = 0; i < 5000 && counter.load() != value; i++) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    return counter.load() == value;
+}
+
+// member m at step n
+static PendulumState Value(size_t m, uint64_t n) {
+    return PendulumState{ 0.01f * n, -0.001f * m, 1.0f + m, float(n) };
+}
+
+static void TestFilters() {
+    const size_t MEMBERS = 10;
+    TelemetryServer server;
+    CHECK(server.Start(PATH, MEMBERS, 0.01f), "could not start on %s", PATH);
+
+    int all = Subscribe(MEMBERS, { TELEMETRY_ALL, 1, 0, 0, 1 });
+    int strided = Subscribe(MEMBERS, { TELEMETRY_THETA1 | TELEMETRY_ENERGY, 10, 1, 3, 3 });
+    int tail = Subscribe(MEMBERS, { TELEMETRY_OMEGA2, 5, 8, 0, 0 });
+    CHECK(all >= 0 && strided >= 0 && tail >= 0, "could not subscribe");
+    CHECK(WaitFor(server.requests, 3) && server.subscribers == 3, "subscriptions not handled");
+
+    Ensemble e(MEMBERS);
+    for (uint64_t n = 1; n <= 100; n++) {
+        for (size_t m = 0; m < MEMBERS; m++) e.Set(m, Value(m, n));
+        server.Publish(e, n, n * 0.01, PARAMS);
+    }
+
+    // everything, every step
+    int bad = 0;
+    for (uint64_t n = 1; n <= 100; n++) {
+        TelemetryFrame frame;
+        float columns[5][MEMBERS];
+        PendulumParams params;
+        bool ok = ReadAll(all, &frame, sizeof(frame)) && ReadAll(all, columns, sizeof(columns)) &&
+                  ReadAll(all, &params, sizeof(params));
+        ok = ok && frame.step == n && frame.members == MEMBERS && frame.fields == TELEMETRY_ALL && frame.dropped == 0 &&
+             frame.bytes == sizeof(frame) + sizeof(columns) + sizeof(params) && params.mass2 == PARAMS.mass2;
+        for (size_t m = 0; ok && m < MEMBERS; m++) {
+            PendulumState s = Value(m, n);
+            ok = columns[0][m] == s.theta1 && columns[1][m] == s.theta2 && columns[2][m] == s.omega1 &&
+                 columns[3][m] == s.omega2 && columns[4][m] == Energy(s, PARAMS);
+        }
+        bad += !ok;
+    }
+    CHECK(bad == 0, "%d of 100 full frames wrong", bad);
+
+    // members 1, 4, 7 on every tenth step
+    bad = 0;
+    for (uint64_t n = 10; n <= 100; n += 10) {
+        TelemetryFrame frame;
+        float theta1[3], energy[3];
+        bool ok = ReadAll(strided, &frame, sizeof(frame)) && ReadAll(strided, theta1, sizeof(theta1)) &&
+                  ReadAll(strided, energy, sizeof(energy));
+        ok = ok && frame.step == n && frame.members == 3;
+        for (size_t i = 0; ok && i < 3; i++) {
+            PendulumState s = Value(1 + 3 * i, n);
+            ok = theta1[i] == s.theta1 && energy[i] == Energy(s, PARAMS);
+        }
+        bad += !ok;
+    }
+    CHECK(bad == 0, "%d of 10 strided frames wrong", bad);
+
+    // members 8 and 9 on every fifth step
+    bad = 0;
+    for (uint64_t n = 5; n <= 100; n += 5) {
+        TelemetryFrame frame;
+        float omega2[2];
+        bool ok = ReadAll(tail, &frame, sizeof(frame)) && ReadAll(tail, omega2, sizeof(omega2));
+        bad += !(ok && frame.step == n && frame.members == 2 && omega2[0] == float(n) && omega2[1] == float(n));
+    }
+    CHECK(bad == 0, "%d of 20 tail frames wrong", bad);
+
+    // nothing more is sent, and stopping hangs up on everyone
+    server.Stop();
+    char byte;
+    CHECK(recv(all, &byte, 1, 0) == 0 && recv(strided, &byte, 1, 0) == 0 && recv(tail, &byte, 1, 0) == 0,
+          "extra data or no hang-up");
+    CHECK(access(PATH, F_OK) != 0, "socket file left behind");
+    close(all);
+    close(strided);
+    close(tail);
+}
+
+static std::atomic<uint64_t> subscriberChanges{0};
+static void CountSubscriberChange() { subscriberChanges++; }
+
+static void TestManySubscribers() {
+    const int CLIENTS = 200;
+    TelemetryServer server;
+    server.onSubscribersChanged = CountSubscriberChange;
+    CHECK(server.Start(PATH, 4, 0.01f), "could not start on %s", PATH);
+    std::vector<int> fds;
+    for (int i = 0; i < CLIENTS; i++) fds.push_back(Subscribe(4, { TELEMETRY_THETA2, 1, 0, 0, 1 }));
+    CHECK(std::count(fds.begin(), fds.end(), -1) == 0, "could not subscribe everyone");
+    CHECK(WaitFor(server.requests, CLIENTS) && server.subscribers == CLIENTS, "%llu subscribers",
+          (unsigned long long)server.subscribers.load());
+
+    Ensemble e(4);
+    for (uint64_t n = 0; n < 50; n++) {
+        for (size_t m = 0; m < 4; m++) e.Set(m, Value(m, n));
+        server.Publish(e, n, n * 0.01, PARAMS);
+    }
+    int bad = 0;
+    for (int fd : fds) {
+        for (uint64_t n = 0; n < 50; n++) {
+            TelemetryFrame frame;
+            float theta2[4];
+            bad += !(ReadAll(fd, &frame, sizeof(frame)) && ReadAll(fd, theta2, sizeof(theta2)) && frame.step == n &&
+                     theta2[3] == Value(3, n).theta2);
+        }
+    }
+    CHECK(bad == 0, "%d frames wrong across %d subscribers", bad, CLIENTS);
+
+    for (int i = 0; i < CLIENTS / 2; i++) close(fds[i]);
+    CHECK(WaitFor(server.subscribers, CLIENTS / 2), "hung-up subscribers still counted");
+    CHECK(WaitFor(subscriberChanges, CLIENTS + CLIENTS / 2), "%llu subscriber changes reported",
+          (unsigned long long)subscriberChanges.load());
+    server.Stop();
+    for (int i = CLIENTS / 2; i < CLIENTS; i++) close(fds[i]);
+}
+
+// A subscriber that doesn't read backs up to BACKLOG_BYTES and then loses
+// frames; once it reads again the next frame says how many.
+static void TestSlowSubscriber() {
+    const size_t MEMBERS = 100000;
+    const uint64_t STEPS = 100;
+    TelemetryServer server;
+    CHECK(server.Start(PATH, MEMBERS, 0.01f), "could not start on %s", PATH);
+    int fd = Subscribe(MEMBERS, { TELEMETRY_THETA1, 1, 0, 0, 1 });
+    CHECK(fd >= 0 && WaitFor(server.requests, 1), "could not subscribe");
+
+    Ensemble e(MEMBERS);
+    for (uint64_t n = 0; n < STEPS; n++) {
+        e.Fill(Value(0, n));
+        server.Publish(e, n, n * 0.01, PARAMS);
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    for (int i = 0; i < 5000 && server.framesSent + server.framesDropped + server.stepsLost < STEPS; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    uint64_t sent = server.framesSent, dropped = server.framesDropped;
+    CHECK(dropped > 0 && sent + dropped + server.stepsLost == STEPS, "%llu sent, %llu dropped, %llu lost",
+          (unsigned long long)sent, (unsigned long long)dropped, (unsigned long long)server.stepsLost.load());
+
+    // everything queued arrives intact, then the next frame reports the gap
+    int bad = 0;
+    std::vector<float> theta1(MEMBERS);
+    TelemetryFrame frame;
+    for (uint64_t i = 0; i < sent; i++) {
+        bool ok = ReadAll(fd, &frame, sizeof(frame)) && ReadAll(fd, theta1.data(), MEMBERS * sizeof(float));
+        bad += !(ok && frame.dropped == 0 && theta1[MEMBERS - 1] == Value(0, frame.step).theta1);
+    }
+    CHECK(bad == 0, "%d of %llu queued frames wrong", bad, (unsigned long long)sent);
+    e.Fill(Value(0, STEPS));
+    server.Publish(e, STEPS, STEPS * 0.01, PARAMS);
+    CHECK(ReadAll(fd, &frame, sizeof(frame)) && frame.step == STEPS && frame.dropped == dropped,
+          "frame after the gap: step %llu, %u dropped", (unsigned long long)frame.step, frame.dropped);
+    server.Stop();
+    close(fd);
+}
+
+int main() {
+    TestFilters();
+    TestManySubscribers();
+    TestSlowSubscriber();
+
+    printf("%d of %d checks failed\n", failures, checks);
+    return failures ? 1 : 0;
+}
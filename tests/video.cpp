@@ -0,0 +1,142 @@
+// Video capture: RGBA converts to YUV 4:2:0 within a code value of the
+// BT.601 formulas, bottom-up images come out the right way up, and the
+// writer thread produces a well-formed Y4M file with every frame in order.
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "videoWriter.h"
+
+static const char* PATH = "test_video.y4m";
+
+// pixel (x, y) of frame f, something different in every channel
+static void Pixel(int x, int y, int f, uint8_t* p) {
+    p[0] = uint8_t(x * 7 + f * 31);
+    p[1] = uint8_t(y * 13 + x);
+    p[2] = uint8_t((x ^ y) * 5 + f);
+    p[3] = 255;
+}
+
+static std::vector<uint8_t> Image(int width, int height, int f) {
+    std::vector<uint8_t> rgba(size_t(width) * height * 4);
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++) Pixel(x, y, f, &rgba[(size_t(y) * width + x) * 4]);
+    return rgba;
+}
+
+static int Luma(double r, double g, double b) {
+    return int(std::lround(16.0 + 219.0 * (0.299 * r + 0.587 * g + 0.114 * b) / 255.0));
+}
+
+static void TestConvert() {
+    // solid colours land on their textbook values
+    struct { uint8_t r, g, b, y, u, v; } colours[] = {
+        { 0, 0, 0, 16, 128, 128 },
+        { 255, 255, 255, 235, 128, 128 },
+        { 255, 0, 0, 81, 90, 240 },
+        { 0, 0, 255, 41, 240, 110 },
+    };
+    for (const auto& c : colours) {
+        uint8_t rgba[4 * 4];
+        for (int i = 0; i < 4; i++) {
+            rgba[4 * i] = c.r;
+            rgba[4 * i + 1] = c.g;
+            rgba[4 * i + 2] = c.b;
+            rgba[4 * i + 3] = 255;
+        }
+        uint8_t y[4], u, v;
+        RgbaToYuv420(rgba, 8, 2, 2, y, &u, &v);
+        CHECK(std::abs(y[0] - c.y) <= 1 && std::abs(u - c.u) <= 1 && std::abs(v - c.v) <= 1,
+              "(%d,%d,%d) gave %d,%d,%d, wanted %d,%d,%d", c.r, c.g, c.b, y[0], u, v, c.y, c.u, c.v);
+    }
+
+    // a width that isn't a multiple of any vector length, against floats
+    const int W = 70, H = 6;
+    std::vector<uint8_t> rgba = Image(W, H, 3);
+    std::vector<uint8_t> y(W * H), u(W * H / 4), v(W * H / 4);
+    RgbaToYuv420(rgba.data(), W * 4, W, H, y.data(), u.data(), v.data());
+    int bad = 0;
+    for (int row = 0; row < H; row++) {
+        for (int x = 0; x < W; x++) {
+            const uint8_t* p = &rgba[(size_t(row) * W + x) * 4];
+            bad += std::abs(y[row * W + x] - Luma(p[0], p[1], p[2])) > 1;
+        }
+    }
+    for (int row = 0; row < H / 2; row++) {
+        for (int x = 0; x < W / 2; x++) {
+            double r = 0, g = 0, b = 0;
+            for (int i = 0; i < 4; i++) {
+                const uint8_t* p = &rgba[(size_t(2 * row + i / 2) * W + 2 * x + i % 2) * 4];
+                r += p[0] / 4.0;
+                g += p[1] / 4.0;
+                b += p[2] / 4.0;
+            }
+            int wantU = int(std::lround(128.0 + 224.0 * (-0.168736 * r - 0.331264 * g + 0.5 * b) / 255.0));
+            int wantV = int(std::lround(128.0 + 224.0 * (0.5 * r - 0.418688 * g - 0.081312 * b) / 255.0));
+            bad += std::abs(u[row * W / 2 + x] - wantU) > 1 || std::abs(v[row * W / 2 + x] - wantV) > 1;
+        }
+    }
+    CHECK(bad == 0, "%d samples off by more than one", bad);
+
+    // the same image stored bottom-up, read with a negative stride
+    std::vector<uint8_t> flipped(rgba.size());
+    for (int row = 0; row < H; row++) memcpy(&flipped[size_t(H - 1 - row) * W * 4], &rgba[size_t(row) * W * 4], W * 4);
+    std::vector<uint8_t> y2(W * H), u2(W * H / 4), v2(W * H / 4);
+    RgbaToYuv420(&flipped[size_t(H - 1) * W * 4], -W * 4, W, H, y2.data(), u2.data(), v2.data());
+    CHECK(y2 == y && u2 == u && v2 == v, "bottom-up image converted differently");
+}
+
+static void TestWriter() {
+    const int W = 64, H = 36, FRAMES = 40;
+    VideoWriter writer;
+    CHECK(!writer.Open(PATH, 63, 36, 30), "odd width accepted");
+    CHECK(writer.Open(PATH, W, H, 30, 2), "could not open %s", PATH);
+    std::vector<std::vector<uint8_t>> frames;
+    for (int f = 0; f < FRAMES; f++) {
+        frames.push_back(Image(W, H, f));
+        // every other frame bottom-up, as the capture hands them over
+        if (f % 2) {
+            std::vector<uint8_t> flipped(frames[f].size());
+            for (int row = 0; row < H; row++) memcpy(&flipped[size_t(H - 1 - row) * W * 4], &frames[f][size_t(row) * W * 4], W * 4);
+            CHECK(writer.Push(&flipped[size_t(H - 1) * W * 4], -W * 4, true), "push %d failed", f);
+        } else {
+            CHECK(writer.Push(frames[f].data(), W * 4, true), "push %d failed", f);
+        }
+    }
+    CHECK(writer.Close(), "close failed");
+    CHECK(writer.written == FRAMES && writer.dropped == 0, "%llu written, %llu dropped",
+          (unsigned long long)writer.written.load(), (unsigned long long)writer.dropped.load());
+
+    FILE* in = fopen(PATH, "rb");
+    char line[128] = {};
+    CHECK(in && fgets(line, sizeof(line), in) && std::string(line) == "YUV4MPEG2 W64 H36 F30:1 Ip A1:1 C420jpeg\n",
+          "header: %s", line);
+    size_t planeBytes = size_t(W) * H * 3 / 2;
+    std::vector<uint8_t> frame(planeBytes), y(W * H), u(W * H / 4), v(W * H / 4);
+    int bad = 0;
+    for (int f = 0; in && f < FRAMES; f++) {
+        char tag[6];
+        bool ok = fread(tag, 1, 6, in) == 6 && memcmp(tag, "FRAME\n", 6) == 0 && fread(frame.data(), 1, planeBytes, in) == planeBytes;
+        RgbaToYuv420(frames[f].data(), W * 4, W, H, y.data(), u.data(), v.data());
+        ok = ok && memcmp(frame.data(), y.data(), y.size()) == 0 && memcmp(frame.data() + y.size(), u.data(), u.size()) == 0 &&
+             memcmp(frame.data() + y.size() + u.size(), v.data(), v.size()) == 0;
+        bad += !ok;
+    }
+    CHECK(bad == 0, "%d of %d frames wrong", bad, FRAMES);
+    CHECK(in && fgetc(in) == EOF, "trailing data");
+    CHECK(in && uint64_t(ftell(in)) == writer.fileBytes, "%llu bytes counted", (unsigned long long)writer.fileBytes.load());
+    if (in) fclose(in);
+    remove(PATH);
+}
+
+int main() {
+    TestConvert();
+    TestWriter();
+
+    printf("%d of %d checks failed\n", failures, checks);
+    return failures ? 1 : 0;
+}